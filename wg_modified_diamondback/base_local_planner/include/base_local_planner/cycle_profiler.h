@@ -0,0 +1,190 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2008, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#ifndef TRAJECTORY_ROLLOUT_CYCLE_PROFILER_H_
+#define TRAJECTORY_ROLLOUT_CYCLE_PROFILER_H_
+
+#include <vector>
+#include <string>
+#include <ros/time.h>
+#include <diagnostic_msgs/DiagnosticStatus.h>
+
+namespace base_local_planner {
+  /**
+   * @class CycleProfiler
+   * @brief Keeps track of where the time of each control cycle goes. The time of every phase of a cycle is added to a
+   * histogram, along with per-cycle counts such as the number of samples, until the statistics are reported and reset.
+   * Recording a cycle doesn't allocate any memory.
+   */
+  class CycleProfiler {
+    public:
+      /**
+       * @brief  Constructs a profiler without any phases or counts
+       * @param budget The time a cycle is allowed to take in seconds, cycles that take longer are counted as slow
+       */
+      CycleProfiler(double budget = 0.05);
+
+      /**
+       * @brief  Add a phase to time, all phases have to be added before the first cycle
+       * @param name The name the phase is reported under
+       * @return The index to pass to startPhase and addPhaseTime
+       */
+      unsigned int addPhase(const std::string& name);
+
+      /**
+       * @brief  Add a count to keep track of, all counts have to be added before the first cycle
+       * @param name The name the count is reported under
+       * @return The index to pass to setCount
+       */
+      unsigned int addCount(const std::string& name);
+
+      /**
+       * @brief  Set the time a cycle is allowed to take
+       * @param budget The budget in seconds
+       */
+      void setBudget(double budget);
+
+      /**
+       * @brief  Start timing a new cycle
+       */
+      void startCycle();
+
+      /**
+       * @brief  Start timing a phase of the current cycle, ending the phase that was being timed
+       * @param phase The index of the phase, a phase that is started several times in a cycle adds up its times
+       */
+      void startPhase(unsigned int phase);
+
+      /**
+       * @brief  End the phase that is being timed, if any
+       */
+      void endPhase();
+
+      /**
+       * @brief  Add time that was measured elsewhere to a phase of the current cycle
+       * @param phase The index of the phase
+       * @param seconds The time to add
+       */
+      void addPhaseTime(unsigned int phase, double seconds);
+
+      /**
+       * @brief  Set a count for the current cycle
+       * @param count The index of the count
+       * @param value The value of the count
+       */
+      void setCount(unsigned int count, unsigned int value);
+
+      /**
+       * @brief  End the current cycle and add it to the statistics
+       * @return True if the cycle took longer than the budget
+       */
+      bool endCycle();
+
+      /**
+       * @brief  Describe where the time of the last cycle went, for logging slow cycles
+       * @return The time of the cycle and of each of its phases in milliseconds, followed by the counts
+       */
+      std::string getCycleSummary() const;
+
+      /**
+       * @brief  Fill a diagnostic status with the statistics of the cycles since the last reset
+       * @param status Will be set to the level, message, and values of the statistics; the name and hardware id are left alone
+       */
+      void getStatus(diagnostic_msgs::DiagnosticStatus& status) const;
+
+      /**
+       * @brief  Forget the statistics of the cycles recorded so far
+       */
+      void reset();
+
+      /**
+       * @brief  The number of cycles recorded since the last reset
+       */
+      unsigned int getNumCycles() const { return num_cycles_; }
+
+      /**
+       * @brief  The number of cycles since the last reset that took longer than the budget
+       */
+      unsigned int getNumSlowCycles() const { return num_slow_cycles_; }
+
+      /**
+       * @brief  The histogram of a phase, bucket i counts the cycles with a phase time up to getBucketLimit(i)
+       * @param phase The index of the phase
+       */
+      const std::vector<unsigned int>& getHistogram(unsigned int phase) const { return phases_[phase].histogram; }
+
+      /**
+       * @brief  The upper limit of a histogram bucket in seconds, the last bucket has no limit
+       * @param bucket The index of the bucket
+       */
+      static double getBucketLimit(unsigned int bucket);
+
+      static const unsigned int NUM_BUCKETS = 11; ///< @brief The number of buckets in each histogram
+
+    private:
+      /**
+       * @brief The time spent in one phase of the cycles
+       */
+      struct PhaseStats {
+        std::string name;
+        double cycle_time; ///< @brief The time of the phase in the current cycle
+        double total_time, max_time;
+        std::vector<unsigned int> histogram;
+      };
+
+      /**
+       * @brief One count of the cycles
+       */
+      struct CountStats {
+        std::string name;
+        unsigned int cycle_value; ///< @brief The value of the count in the current cycle
+        double total;
+        unsigned int max;
+      };
+
+      /**
+       * @brief  Add a time to the statistics of a phase
+       */
+      static void addTime(PhaseStats& stats, double seconds);
+
+      double budget_; ///< @brief The time a cycle is allowed to take in seconds
+      PhaseStats cycle_; ///< @brief The time of the whole cycle
+      std::vector<PhaseStats> phases_; ///< @brief The times of the phases of the cycle
+      std::vector<CountStats> counts_; ///< @brief The counts of the cycle
+      ros::WallTime cycle_start_; ///< @brief When the current cycle started
+      ros::WallTime phase_start_; ///< @brief When the phase being timed started
+      int current_phase_; ///< @brief The phase being timed, -1 if there is none
+      unsigned int num_cycles_, num_slow_cycles_;
+  };
+};
+#endif
@@ -0,0 +1,118 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2008, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#ifndef TRAJECTORY_ROLLOUT_GRID_WAVEFRONT_H_
+#define TRAJECTORY_ROLLOUT_GRID_WAVEFRONT_H_
+
+#include <vector>
+#include <climits>
+
+namespace base_local_planner {
+  /**
+   * @class GridWavefront
+   * @brief Computes 4-connected grid distances from a set of source cells, the same distances a breadth first search
+   * over the cells gives. The obstacles are laid out once in a copy of the grid with a one cell border around it, and
+   * each distance field is expanded one wavefront at a time over a plain array of cell indices, so the search needs no
+   * bounds checks, no division to find the column of a cell and a single load to tell whether a neighbor is free,
+   * blocked or already reached. Several fields over the same obstacles share the obstacle grid.
+   */
+  class GridWavefront {
+    public:
+      /**
+       * @brief  Constructs an empty wavefront
+       */
+      GridWavefront();
+
+      /**
+       * @brief  Set the grid the distances are computed on
+       * @param states One byte of flags for each cell, row by row, which must stay valid while distances are computed
+       * @param size_x The width of the grid
+       * @param size_y The height of the grid
+       * @param blocked The flag of the cells the distances don't propagate through
+       */
+      void setCells(const unsigned char* states, unsigned int size_x, unsigned int size_y, unsigned char blocked);
+
+      /**
+       * @brief  Compute distance fields from the source cells of each, the sources are at distance 0 and expand even if
+       * they are blocked, a blocked cell next to a reached cell gets blocked_dist and the cells that aren't reached get
+       * unreached_dist
+       * @param sources The flag of the source cells of each field in the states given to setCells
+       * @param dists The distance of each cell for each field, all of them are written
+       * @param num_fields The number of fields
+       * @param blocked_dist The distance of a blocked cell next to a reached cell
+       * @param unreached_dist The distance of a cell that isn't reached
+       */
+      void computeDistances(const unsigned char* sources, unsigned int* const* dists, unsigned int num_fields,
+          unsigned int blocked_dist, unsigned int unreached_dist);
+
+    private:
+      /**
+       * @brief  Expand the distances from the sources over the work grid, one wavefront at a time
+       * @param tail The number of sources at the front of the queue
+       * @param blocked_dist The distance of a blocked cell next to a reached cell
+       */
+      void expand(unsigned int tail, unsigned int blocked_dist);
+
+      /**
+       * @brief  Used to reach a neighbor of a cell of the current wavefront
+       * @param index The index of the neighbor in the work grid
+       * @param dist The distance of the next wavefront
+       * @param blocked_dist The distance of a blocked cell next to a reached cell
+       * @param cells The work grid
+       * @param queue The queue of wavefronts
+       * @param tail The end of the queue
+       */
+      static inline void reachCell(unsigned int index, unsigned int dist, unsigned int blocked_dist, unsigned int* cells,
+          unsigned int* queue, unsigned int& tail){
+        unsigned int value = cells[index];
+        if(value == FREE){
+          cells[index] = dist;
+          queue[tail++] = index;
+        }
+        else if(value == BLOCKED)
+          cells[index] = blocked_dist;
+      }
+
+      static const unsigned int FREE = UINT_MAX; ///< @brief A cell of the work grid the distances haven't reached yet
+      static const unsigned int BLOCKED = UINT_MAX - 1; ///< @brief A blocked cell of the work grid no distance was given to yet
+      static const unsigned int BORDER = UINT_MAX - 2; ///< @brief A cell of the border around the work grid, never reached
+
+      unsigned int size_x_, size_y_; ///< @brief The dimensions of the grid
+      unsigned int stride_; ///< @brief The width of the work grid, which has an extra cell on each side
+      const unsigned char* states_; ///< @brief The states of the cells, from setCells
+      std::vector<unsigned int> obstacles_; ///< @brief The work grid before any distance is computed, FREE or BLOCKED inside the border
+      std::vector<unsigned int> cells_; ///< @brief The work grid a distance is expanded over
+      std::vector<unsigned int> queue_; ///< @brief The cells in the order they were reached, which never holds a cell twice
+  };
+};
+#endif
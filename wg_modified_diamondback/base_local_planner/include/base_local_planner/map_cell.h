@@ -1,73 +0,0 @@
-/*********************************************************************
- * Software License Agreement (BSD License)
- *
- *  Copyright (c) 2008, Willow Garage, Inc.
- *  All rights reserved.
- *
- *  Redistribution and use in source and binary forms, with or without
- *  modification, are permitted provided that the following conditions
- *  are met:
- *
- *   * Redistributions of source code must retain the above copyright
- *     notice, this list of conditions and the following disclaimer.
- *   * Redistributions in binary form must reproduce the above
- *     copyright notice, this list of conditions and the following
- *     disclaimer in the documentation and/or other materials provided
- *     with the distribution.
- *   * Neither the name of the Willow Garage nor the names of its
- *     contributors may be used to endorse or promote products derived
- *     from this software without specific prior written permission.
- *
- *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
- *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
- *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
- *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
- *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
- *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
- *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
- *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
- *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
- *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
- *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
- *  POSSIBILITY OF SUCH DAMAGE.
- *********************************************************************/
-#ifndef TRAJECTORY_ROLLOUT_MAP_CELL_H_
-#define TRAJECTORY_ROLLOUT_MAP_CELL_H_
-
-#include <base_local_planner/trajectory_inc.h>
-
-namespace base_local_planner {
-  /**
-   * @class MapCell
-   * @brief Stores path distance and goal distance information used for scoring trajectories
-   */
-  class MapCell{
-    public:
-      /**
-       * @brief  Default constructor
-       */
-      MapCell();
-
-      /**
-       * @brief  Copy constructor
-       * @param mc The MapCell to be copied
-       */
-      MapCell(const MapCell& mc);
-
-      unsigned int cx, cy; ///< @brief Cell index in the grid map
-
-      double path_dist; ///< @brief Distance to planner's path
-
-      double goal_dist; ///< @brief Distance to local goal
-
-      double occ_dist; ///< @brief Distance to obstacles
-
-      int occ_state; ///< @brief Occupancy state (-1 = free, 0 = unknown, 1 = occupied)
-
-      bool path_mark, goal_mark; ///< @brief Marks fir computing path/goal distances
-
-      bool within_robot; ///< @brief Mark for cells within the robot footprint
-  };
-};
-
-#endif
@@ -36,18 +36,21 @@
 
 #include <vector>
 #include <iostream>
+#include <climits>
 #include <base_local_planner/trajectory_inc.h>
 #include <ros/console.h>
 #include <ros/ros.h>
 
-#include <base_local_planner/map_cell.h>
 #include <costmap_2d/costmap_2d.h>
 #include <geometry_msgs/PoseStamped.h>
+#include <base_local_planner/Position2DInt.h>
+#include <base_local_planner/grid_wavefront.h>
 
 namespace base_local_planner{
   /**
    * @class MapGrid
-   * @brief A grid of MapCell cells that is used to propagate path and goal distances for the trajectory controller.
+   * @brief A grid of cells that is used to propagate path and goal distances for the trajectory controller. Each
+   * property of the cells is kept in its own array, indexed the same way as the costmap.
    */
   class MapGrid{
     public:
@@ -67,34 +70,48 @@ namespace base_local_planner{
        * @brief  Creates a map of size_x by size_y with the desired scale and origin
        * @param size_x The width of the map 
        * @param size_y The height of the map 
-       * @param scale The resolution of each MapCell
+       * @param scale The resolution of each cell
        * @param x The x coordinate of the origin of the map
        * @param y The y coordinate of the origin of the map
        */
       MapGrid(unsigned int size_x, unsigned int size_y, double scale, double x, double y);
 
       /**
-       * @brief  Returns a map cell accessed by (col, row)
+       * @brief  Returns the distance of a cell to the path
        * @param x The x coordinate of the cell 
        * @param y The y coordinate of the cell 
-       * @return A reference to the desired cell
+       * @return The distance in cells, the number of cells in the grid for an obstacle next to a reached cell, or DBL_MAX if the distance didn't reach the cell
        */
-      inline MapCell& operator() (unsigned int x, unsigned int y){
-        return map_[size_x_ * y + x];
+      inline double getPathDist(unsigned int x, unsigned int y) const {
+        return distValue(path_dist_[size_x_ * y + x]);
       }
 
       /**
-       * @brief  Returns a map cell accessed by (col, row)
+       * @brief  Returns the distance of a cell to the local goal
        * @param x The x coordinate of the cell 
        * @param y The y coordinate of the cell 
-       * @return A copy of the desired cell
+       * @return The distance in cells, the number of cells in the grid for an obstacle next to a reached cell, or DBL_MAX if the distance didn't reach the cell
        */
-      inline MapCell operator() (unsigned int x, unsigned int y) const {
-        return map_[size_x_ * y + x];
+      inline double getGoalDist(unsigned int x, unsigned int y) const {
+        return distValue(goal_dist_[size_x_ * y + x]);
       }
 
-      inline MapCell& getCell(unsigned int x, unsigned int y){
-        return map_[size_x_ * y + x];
+      /**
+       * @brief  Returns whether a cell is within the footprint of the robot
+       * @param x The x coordinate of the cell 
+       * @param y The y coordinate of the cell 
+       * @return True if the cell is marked as within the robot
+       */
+      inline bool isWithinRobot(unsigned int x, unsigned int y) const {
+        return within_robot_[size_x_ * y + x] != 0;
+      }
+
+      /**
+       * @brief  Returns the number of cells in the grid, which is also the distance given to obstacles
+       * @return The number of cells in the grid
+       */
+      inline unsigned int size() const {
+        return size_x_ * size_y_;
       }
 
       /**
@@ -115,7 +132,7 @@ namespace base_local_planner{
       MapGrid& operator= (const MapGrid& mg);
 
       /**
-       * @brief reset path distance fields for all cells
+       * @brief reset path distance fields for all cells, the next call to updatePathCells will compute the distances from scratch
        */
       void resetPathDist();
 
@@ -134,7 +151,7 @@ namespace base_local_planner{
       void commonInit();
 
       /**
-       * @brief  Returns a 1D index into the MapCell array for a 2D index
+       * @brief  Returns a 1D index into the cell arrays for a 2D index
        * @param x The desired x coordinate
        * @param y The desired y coordinate
        * @return The associated 1D index 
@@ -142,78 +159,229 @@ namespace base_local_planner{
       size_t getIndex(int x, int y);
 
       /**
-       * @brief  Used to update the distance of a cell in path distance computation
-       * @param  current_cell The cell we're currently in 
-       * @param  check_cell The cell to be updated
+       * @brief  Compute the distance from each cell in the local map grid to the planned path
+       * @param dist_queue The indices of the initial cells on the path, whose path_dist_ is already 0, the search
+       * uses it as its queue
+       * @param costmap The costmap to compute the distances in
        */
-      inline void updatePathCell(MapCell* current_cell, MapCell* check_cell, 
-          std::queue<MapCell*>& dist_queue, const costmap_2d::Costmap2D& costmap){
-        //mark the cell as visisted
-        check_cell->path_mark = true;
+      void computePathDistance(std::vector<unsigned int>& dist_queue, const costmap_2d::Costmap2D& costmap);
 
-        //if the cell is an obstacle set the max path distance
-        unsigned char cost = costmap.getCost(check_cell->cx, check_cell->cy);
-        if(!getCell(check_cell->cx, check_cell->cy).within_robot && (cost == costmap_2d::LETHAL_OBSTACLE || cost == costmap_2d::INSCRIBED_INFLATED_OBSTACLE || cost == costmap_2d::NO_INFORMATION)){
-          check_cell->path_dist = map_.size();
-          return;
-        }
+      /**
+       * @brief  Compute the distance from each cell in the local map grid to the local goal point
+       * @param dist_queue The index of the local goal cell, whose goal_dist_ is already 0, the search uses it as its queue
+       * @param costmap The costmap to compute the distances in
+       */
+      void computeGoalDistance(std::vector<unsigned int>& dist_queue, const costmap_2d::Costmap2D& costmap);
+
+      /**
+       * @brief Update what cells are considered path based on the global plan 
+       */
+      void setPathCells(const costmap_2d::Costmap2D& costmap, const std::vector<geometry_msgs::PoseStamped>& global_plan);
 
-        double new_path_dist = current_cell->path_dist + 1;
-        if(new_path_dist < check_cell->path_dist)
-          check_cell->path_dist = new_path_dist;
+      /**
+       * @brief  Update the path and goal distances for the global plan, gives the same distances as resetPathDist, marking
+       * the cells within the robot and setPathCells, but only repairs the distances from the last update where the plan,
+       * the costmap, the footprint of the robot or the origin of the grid changed
+       * @param costmap The costmap to compute the distances in
+       * @param global_plan The plan to compute the distances for
+       * @param footprint_cells The cells within the footprint of the robot, which are never treated as obstacles
+       */
+      void updatePathCells(const costmap_2d::Costmap2D& costmap, const std::vector<geometry_msgs::PoseStamped>& global_plan,
+          const std::vector<base_local_planner::Position2DInt>& footprint_cells);
+
+      /**
+       * @brief Flags describing what a cell is to the distance computations
+       */
+      enum CellState {
+        CELL_BLOCKED = 1, ///< @brief The distances don't propagate through the cell
+        CELL_PATH = 2, ///< @brief The cell is on the path
+        CELL_GOAL = 4, ///< @brief The cell is the local goal
+        CELL_UNKNOWN = 8 ///< @brief The cell wasn't on the grid at the last update
+      };
+
+      static const unsigned int UNREACHED_DIST = UINT_MAX; ///< @brief The distance of a cell the distance computation didn't reach
+
+      unsigned int size_x_, size_y_; ///< @brief The dimensions of the grid
+      std::vector<unsigned int> path_dist_; ///< @brief Distance of each cell to the planner's path
+      std::vector<unsigned int> goal_dist_; ///< @brief Distance of each cell to the local goal
+      std::vector<unsigned char> within_robot_; ///< @brief Mark for cells within the robot footprint
+
+      double scale; ///< @brief grid scale in meters/cell
 
-        dist_queue.push(check_cell);
+      double goal_x_, goal_y_; /**< @brief The goal distance was last computed from */
+
+      double origin_x, origin_y; ///< @brief lower left corner of grid in world space
+
+    private:
+      /**
+       * @brief  Convert a stored distance to the distance handed out by the grid
+       * @param dist The stored distance
+       * @return The distance, or DBL_MAX if it is UNREACHED_DIST
+       */
+      static inline double distValue(unsigned int dist){
+        return dist == UNREACHED_DIST ? DBL_MAX : dist;
       }
 
       /**
-       * @brief  Used to update the distance of a cell in goal distance computation
-       * @param  current_cell The cell we're currently in 
-       * @param  check_cell The cell to be updated
+       * @brief  Find the cells the distances don't propagate through, the obstacles in the costmap that aren't within the robot
+       * @param costmap The costmap to compute the distances in
+       * @param states Will be filled with CELL_BLOCKED or 0 for each cell
+       */
+      void getObstacleStates(const costmap_2d::Costmap2D& costmap, std::vector<unsigned char>& states);
+
+      /**
+       * @brief  Find the state of each cell for the distance computations, and the local goal
+       * @param costmap The costmap to compute the distances in
+       * @param global_plan The plan to compute the distances for
+       * @param states Will be filled with a combination of CellState flags for each cell
+       * @return The index of the local goal, or -1 if the plan isn't on the grid
        */
-      inline void updateGoalCell(MapCell* current_cell, MapCell* check_cell, 
-          std::queue<MapCell*>& dist_queue, const costmap_2d::Costmap2D& costmap ){
-        ///mark the cell as visited
-        check_cell->goal_mark = true;
+      int getCellStates(const costmap_2d::Costmap2D& costmap, const std::vector<geometry_msgs::PoseStamped>& global_plan,
+          std::vector<unsigned char>& states);
 
-        //if the cell is an obstacle set the max goal distance
-        unsigned char cost = costmap.getCost(check_cell->cx, check_cell->cy);
-        if(!getCell(check_cell->cx, check_cell->cy).within_robot && (cost == costmap_2d::LETHAL_OBSTACLE || cost == costmap_2d::INSCRIBED_INFLATED_OBSTACLE || cost == costmap_2d::NO_INFORMATION)){
-          check_cell->goal_dist = map_.size();
+      /**
+       * @brief  Breadth first search outwards from the cells in the queue over the cells that aren't blocked in cell_state_
+       * @param dist The distance to compute, already set for the cells in the queue and UNREACHED_DIST for the cells to search
+       * @param dist_queue The cells to start from, used as the queue of the search
+       */
+      void searchDistance(std::vector<unsigned int>& dist, std::vector<unsigned int>& dist_queue);
+
+      /**
+       * @brief  Used to update the distance of a cell during a breadth first search
+       * @param index The index of the cell to update
+       * @param new_dist The distance of the cell, if the distance propagates through it
+       * @param dist The distance being computed
+       * @param dist_queue The queue of the search
+       */
+      inline void updateCell(unsigned int index, unsigned int new_dist, unsigned int* dist, std::vector<unsigned int>& dist_queue){
+        if(dist[index] != UNREACHED_DIST)
           return;
-        }
 
-        double new_goal_dist = current_cell->goal_dist + 1;
-        if(new_goal_dist < check_cell->goal_dist)
-          check_cell->goal_dist = new_goal_dist;
+        //if the cell is an obstacle set the max distance
+        if(cell_state_[index] & CELL_BLOCKED){
+          dist[index] = size();
+          return;
+        }
 
-        dist_queue.push(check_cell);
+        dist[index] = new_dist;
+        dist_queue.push_back(index);
       }
 
       /**
-       * @brief  Compute the distance from each cell in the local map grid to the planned path
-       * @param dist_queue A queue of the initial cells on the path 
+       * @brief  Move the distances and states of the cells along with the origin of the grid
+       * @param dx The number of cells the origin moved in x
+       * @param dy The number of cells the origin moved in y
        */
-      void computePathDistance(std::queue<MapCell*>& dist_queue, const costmap_2d::Costmap2D& costmap);
+      void shiftCells(int dx, int dy);
 
       /**
-       * @brief  Compute the distance from each cell in the local map grid to the local goal point
-       * @param goal_queue A queue containing the local goal cell 
+       * @brief  Move the values of one of the cell arrays along with the origin of the grid
+       * @param values The values to move
+       * @param dx The number of cells the origin moved in x
+       * @param dy The number of cells the origin moved in y
+       * @param fill The value of the cells that come onto the grid
        */
-      void computeGoalDistance(std::queue<MapCell*>& dist_queue, const costmap_2d::Costmap2D& costmap);
+      template<class T>
+      void shiftValues(std::vector<T>& values, int dx, int dy, T fill);
 
       /**
-       * @brief Update what cells are considered path based on the global plan 
+       * @brief  Repair a distance field where the states of the cells changed since the last update
+       * @param dist The distance to repair
+       * @param source The state flag of the cells the distance is measured from
+       * @param shifted Whether the grid moved since the last update
        */
-      void setPathCells(const costmap_2d::Costmap2D& costmap, const std::vector<geometry_msgs::PoseStamped>& global_plan);
+      void repairDistance(std::vector<unsigned int>& dist, unsigned char source, bool shifted);
 
-      unsigned int size_x_, size_y_; ///< @brief The dimensions of the grid
-      std::vector<MapCell> map_; ///< @brief Storage for the MapCells
+      /**
+       * @brief  Compute distance fields from scratch from the sources in cell_state_, expanding them together
+       * @param sources CELL_PATH to compute path_dist_, CELL_GOAL to compute goal_dist_, or both
+       */
+      void searchSources(unsigned char sources);
 
-      double scale; ///< @brief grid scale in meters/cell
+      /**
+       * @brief  Add a cell to the bucket queue used to repair distances
+       * @param index The index of the cell
+       * @param dist The distance of the cell, used as its priority
+       */
+      inline void pushCell(unsigned int index, unsigned int dist){
+        if(dist >= dist_buckets_.size())
+          dist_buckets_.resize(dist + 1);
+        dist_buckets_[dist].push_back(index);
+      }
 
-      double goal_x_, goal_y_; /**< @brief The goal distance was last computed from */
+      /**
+       * @brief  Add a cell to the bucket queue, if the distance propagates through it and reached it
+       * @param index The index of the cell
+       * @param dist The distance being repaired
+       * @param source The state flag of the cells the distance is measured from
+       */
+      inline void pushReachedCell(unsigned int index, const std::vector<unsigned int>& dist, unsigned char source){
+        if(openCell(cell_state_[index], source) && dist[index] != UNREACHED_DIST)
+          pushCell(index, dist[index]);
+      }
 
-      double origin_x, origin_y; ///< @brief lower left corner of grid in world space
+      /**
+       * @brief  Check if a distance propagates through a cell
+       * @param state The CellState flags of the cell
+       * @param source The state flag of the cells the distance is measured from
+       * @return True if the distance propagates through the cell
+       */
+      inline bool openCell(unsigned char state, unsigned char source) const {
+        return !(state & CELL_UNKNOWN) && (!(state & CELL_BLOCKED) || (state & source));
+      }
+
+      /**
+       * @brief  Give a cell the distance doesn't propagate through the maximum distance if the distance reached a
+       * neighbor of it, like the breadth first search does
+       * @param index The index of the cell
+       * @param dist The distance being computed
+       * @param source The state flag of the cells the distance is measured from
+       */
+      inline void finishCell(unsigned int index, std::vector<unsigned int>& dist, unsigned char source){
+        if(openCell(cell_state_[index], source))
+          return;
+        unsigned int neighbors[4];
+        unsigned int n = getNeighbors(index, neighbors);
+        dist[index] = UNREACHED_DIST;
+        for(unsigned int j = 0; j < n; ++j){
+          if(openCell(cell_state_[neighbors[j]], source) && dist[neighbors[j]] != UNREACHED_DIST){
+            dist[index] = size();
+            break;
+          }
+        }
+      }
+
+      /**
+       * @brief  Get the 4-connected neighbors of a cell
+       * @param index The index of the cell
+       * @param neighbors Filled with the indices of the neighbors
+       * @return The number of neighbors
+       */
+      inline unsigned int getNeighbors(unsigned int index, unsigned int* neighbors) const {
+        unsigned int n = 0;
+        unsigned int x = index % size_x_;
+        if(x > 0)
+          neighbors[n++] = index - 1;
+        if(x < size_x_ - 1)
+          neighbors[n++] = index + 1;
+        if(index >= size_x_)
+          neighbors[n++] = index - size_x_;
+        if(index + size_x_ < size())
+          neighbors[n++] = index + size_x_;
+        return n;
+      }
+
+      bool incremental_valid_; ///< @brief Whether the distances and cell states are left from the last call to updatePathCells
+      double last_resolution_; ///< @brief The resolution of the costmap at the last update
+      int last_goal_; ///< @brief The index of the local goal at the last update, or -1 if there wasn't one
+      std::vector<unsigned char> last_state_; ///< @brief The states of the cells at the last update
+      std::vector<unsigned char> cell_state_; ///< @brief The states of the cells for the current update
+      std::vector<base_local_planner::Position2DInt> robot_cells_; ///< @brief The cells marked as within the robot at the last update
+      std::vector<unsigned int> changed_cells_; ///< @brief The cells whose state changed since the last update
+      std::vector<unsigned int> invalid_cells_; ///< @brief The cells whose distance was thrown away during a repair
+      std::vector<unsigned int> lowered_cells_; ///< @brief The cells that were given a shorter distance during a repair
+      std::vector<std::vector<unsigned int> > dist_buckets_; ///< @brief A bucket queue of cells by distance, used during a repair
+      GridWavefront wavefront_; ///< @brief Computes distance fields from scratch
   };
 };
 
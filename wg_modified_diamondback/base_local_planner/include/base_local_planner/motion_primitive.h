@@ -0,0 +1,107 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2008, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#ifndef TRAJECTORY_ROLLOUT_MOTION_PRIMITIVE_H_
+#define TRAJECTORY_ROLLOUT_MOTION_PRIMITIVE_H_
+
+#include <vector>
+
+namespace base_local_planner {
+  /**
+   * @class MotionPrimitive
+   * @brief Holds the poses of a trajectory relative to the pose of the robot at its start, so that it can be reused from anywhere
+   */
+  class MotionPrimitive {
+    public:
+      /**
+       * @brief  Default constructor
+       */
+      MotionPrimitive();
+
+      /**
+       * @brief  Constructs a motion primitive
+       * @param xv The x velocity used to seed the trajectory 
+       * @param yv The y velocity used to seed the trajectory 
+       * @param thetav The theta velocity used to seed the trajectory 
+       */
+      MotionPrimitive(double xv, double yv, double thetav);
+
+      double xv_, yv_, thetav_; ///< @brief The x, y, and theta velocities of the trajectory
+
+      /**
+       * @brief  Add a pose to the end of the primitive
+       * @param x The x position, in the frame of the robot at the start of the trajectory
+       * @param y The y position, in the frame of the robot at the start of the trajectory
+       * @param th The orientation, relative to the orientation of the robot at the start of the trajectory
+       */
+      void addPoint(double x, double y, double th);
+
+      /**
+       * @brief  Get a pose of the primitive placed at a robot pose
+       * @param index The index of the pose to get
+       * @param x The x position of the robot at the start of the trajectory
+       * @param y The y position of the robot at the start of the trajectory
+       * @param th The orientation of the robot at the start of the trajectory
+       * @param cos_th The cosine of th
+       * @param sin_th The sine of th
+       * @param x_i Will be set to the x position of the pose
+       * @param y_i Will be set to the y position of the pose
+       * @param th_i Will be set to the orientation of the pose
+       * @param cos_th_i Will be set to the cosine of th_i
+       * @param sin_th_i Will be set to the sine of th_i
+       */
+      inline void getPose(unsigned int index, double x, double y, double th, double cos_th, double sin_th,
+          double& x_i, double& y_i, double& th_i, double& cos_th_i, double& sin_th_i) const {
+        x_i = x + cos_th * x_pts_[index] - sin_th * y_pts_[index];
+        y_i = y + sin_th * x_pts_[index] + cos_th * y_pts_[index];
+        th_i = th + th_pts_[index];
+        cos_th_i = cos_th * cos_pts_[index] - sin_th * sin_pts_[index];
+        sin_th_i = sin_th * cos_pts_[index] + cos_th * sin_pts_[index];
+      }
+
+      /**
+       * @brief  Return the number of poses in the primitive
+       * @return The number of poses in the primitive
+       */
+      unsigned int getPointsSize() const;
+
+    private:
+      std::vector<double> x_pts_; ///< @brief The x positions of the poses
+      std::vector<double> y_pts_; ///< @brief The y positions of the poses
+      std::vector<double> th_pts_; ///< @brief The relative orientations of the poses
+      std::vector<double> cos_pts_; ///< @brief The cosines of the relative orientations
+      std::vector<double> sin_pts_; ///< @brief The sines of the relative orientations
+
+  };
+};
+#endif
@@ -0,0 +1,94 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2008, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#ifndef TRAJECTORY_ROLLOUT_SWEPT_FOOTPRINT_H_
+#define TRAJECTORY_ROLLOUT_SWEPT_FOOTPRINT_H_
+
+#include <vector>
+#include <geometry_msgs/Point.h>
+#include <costmap_2d/costmap_2d.h>
+
+namespace base_local_planner {
+  /**
+   * @class SweptFootprint
+   * @brief Collects the cells covered by the footprints along a trajectory, so that each cell is only scored once.
+   * Cells are marked in a stamp buffer the size of the costmap, which is reused from one trajectory to the next, so
+   * checking a trajectory doesn't allocate any memory. A SweptFootprint must only be used by one thread at a time.
+   */
+  class SweptFootprint {
+    public:
+      /**
+       * @brief  Constructs a swept footprint
+       * @param costmap The costmap the footprints are checked against
+       */
+      SweptFootprint(const costmap_2d::Costmap2D& costmap);
+
+      /**
+       * @brief  Forget the cells of the previous trajectory, to start on a new one
+       */
+      void clear();
+
+      /**
+       * @brief  Add the footprint of the robot at a pose to the swept cells, scoring the cells that weren't covered yet
+       * the same way CostmapModel does
+       * @param x The x position of the robot in world coordinates
+       * @param y The y position of the robot in world coordinates
+       * @param cos_th The cosine of the orientation of the robot
+       * @param sin_th The sine of the orientation of the robot
+       * @param footprint_spec The footprint of the robot, in the frame of the robot
+       * @return The highest cost of the newly covered cells, or a negative value if the footprint hits an obstacle or leaves the map
+       */
+      double footprintCost(double x, double y, double cos_th, double sin_th,
+          const std::vector<geometry_msgs::Point>& footprint_spec);
+
+    private:
+      /**
+       * @brief  Rasterizes a line in the costmap grid, scoring the cells that weren't covered yet
+       * @param x0 The x position of the first cell in grid coordinates
+       * @param x1 The x position of the second cell in grid coordinates
+       * @param y0 The y position of the first cell in grid coordinates
+       * @param y1 The y position of the second cell in grid coordinates
+       * @return The highest cost of the newly covered cells on the line, or a negative value if the line hits an obstacle
+       */
+      double lineCost(int x0, int x1, int y0, int y1);
+
+      const costmap_2d::Costmap2D& costmap_; ///< @brief The costmap the footprints are checked against
+      const unsigned char* char_map_; ///< @brief The costs of the costmap, fetched when the swept cells are cleared
+      unsigned int size_x_; ///< @brief The width of the costmap, fetched when the swept cells are cleared
+      std::vector<unsigned int> stamps_; ///< @brief The trajectory each cell was last covered by
+      unsigned int stamp_; ///< @brief The stamp of the current trajectory
+      std::vector<unsigned int> corner_x_; ///< @brief The x cells of the corners of the footprint being checked
+      std::vector<unsigned int> corner_y_; ///< @brief The y cells of the corners of the footprint being checked
+  };
+};
+#endif
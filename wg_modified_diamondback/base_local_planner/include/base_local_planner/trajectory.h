@@ -39,7 +39,9 @@
 namespace base_local_planner {
   /**
    * @class Trajectory
-   * @brief Holds a trajectory generated by an x, y, and theta velocity
+   * @brief Holds a trajectory generated by an x, y, and theta velocity. The x, y, and theta of each point are stored
+   * next to each other in one buffer, which resetPoints keeps, so a trajectory that is reused doesn't allocate memory
+   * once its buffer is large enough.
    */
   class Trajectory {
     public:
@@ -68,7 +70,7 @@ namespace base_local_planner {
        * @param y Will be set to the y position of the point
        * @param th Will be set to the theta position of the point
        */
-      void getPoint(unsigned int index, double& x, double& y, double& th);
+      void getPoint(unsigned int index, double& x, double& y, double& th) const;
 
       /**
        * @brief  Set a point within the trajectory
@@ -93,23 +95,34 @@ namespace base_local_planner {
        * @param y Will be set to the y position of the point
        * @param th Will be set to the theta position of the point
        */
-      void getEndpoint(double& x, double& y, double& th);
+      void getEndpoint(double& x, double& y, double& th) const;
 
       /**
-       * @brief  Clear the trajectory's points
+       * @brief  Clear the trajectory's points, keeping the memory they were stored in
        */
       void resetPoints();
 
+      /**
+       * @brief  Make room for a number of points, so that adding them doesn't allocate memory
+       * @param num_pts The number of points
+       */
+      void reservePoints(unsigned int num_pts);
+
       /**
        * @brief  Return the number of points in the trajectory
        * @return The number of points in the trajectory
        */
-      unsigned int getPointsSize();
+      unsigned int getPointsSize() const;
+
+      /**
+       * @brief  Get the points of the trajectory, valid until points are added or set
+       * @return The x, y, and theta of each point, one point after the other
+       */
+      const double* getPoints() const;
 
     private:
-      std::vector<double> x_pts_; ///< @brief The x points in the trajectory
-      std::vector<double> y_pts_; ///< @brief The y points in the trajectory 
-      std::vector<double> th_pts_; ///< @brief The theta points in the trajectory
+      std::vector<double> pts_; ///< @brief The x, y, and theta of each point, followed by room for more points
+      unsigned int num_pts_; ///< @brief The number of points in the trajectory
 
   };
 };
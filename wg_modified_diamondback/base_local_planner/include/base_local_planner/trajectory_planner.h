@@ -43,7 +43,6 @@
 #include <angles/angles.h>
 
 //for creating a local cost grid
-#include <base_local_planner/map_cell.h>
 #include <base_local_planner/map_grid.h>
 
 //for obstacle data access
@@ -51,6 +50,8 @@
 #include <base_local_planner/world_model.h>
 
 #include <base_local_planner/trajectory.h>
+#include <base_local_planner/motion_primitive.h>
+#include <base_local_planner/swept_footprint.h>
 
 //we'll take in a path as a vector of poses
 #include <geometry_msgs/PoseStamped.h>
@@ -60,9 +61,18 @@
 //for computing path distance
 #include <queue>
 
+//for looking up motion primitives
+#include <map>
+
 //for some datatypes
 #include <tf/transform_datatypes.h>
 
+//for scoring trajectories in parallel
+#include <boost/thread.hpp>
+
+//for timing the parts of a planning cycle
+#include <ros/time.h>
+
 namespace base_local_planner {
   /**
    * @class TrajectoryPlanner
@@ -105,6 +115,15 @@ namespace base_local_planner {
        * @param simple_attractor Set this to true to allow simple attraction to a goal point instead of intelligent cost propagation
        * @param y_vels A vector of the y velocities the controller will explore
        * @param angular_sim_granularity The distance between simulation points for angular velocity should be small enough that the robot doesn't hit things
+       * @param rollout_threads The number of threads used to score trajectories, the world model must allow concurrent footprint checks when this is greater than 1
+       * @param motion_primitives Set this to true to plan from the current velocity rounded to a lattice, reusing the trajectories computed for it in earlier cycles
+       * @param primitive_vel_resolution The spacing of the lattice of current x and y velocities when using motion primitives
+       * @param primitive_rot_resolution The spacing of the lattice of current rotational velocities when using motion primitives
+       * @param max_primitive_sets The number of current velocities to keep motion primitives for
+       * @param swept_footprint Set this to true to check footprints against the costmap directly, scoring each cell a trajectory covers only once,
+       * this bypasses the world model and gives the same results as a CostmapModel, so it is ignored for any other world model
+       * @param bound_trajectories Set this to true to score the most promising samples first and drop the others as soon as they can't beat 
+       * the best one, this picks the same trajectory as scoring all of them
        */
       TrajectoryPlanner(WorldModel& world_model, 
           const costmap_2d::Costmap2D& costmap, 
@@ -124,7 +143,11 @@ namespace base_local_planner {
           bool simple_attractor = false,
           std::vector<double> y_vels = std::vector<double>(0),
           double stop_time_buffer = 0.2,
-          double sim_period = 0.1, double angular_sim_granularity = 0.025);
+          double sim_period = 0.1, double angular_sim_granularity = 0.025,
+          int rollout_threads = 1,
+          bool motion_primitives = false, double primitive_vel_resolution = 0.05,
+          double primitive_rot_resolution = 0.1, int max_primitive_sets = 64,
+          bool swept_footprint = false, bool bound_trajectories = true);
 
       /**
        * @brief  Destructs a trajectory controller
@@ -136,9 +159,10 @@ namespace base_local_planner {
        * @param global_pose The current pose of the robot in world space 
        * @param global_vel The current velocity of the robot in world space
        * @param drive_velocities Will be set to velocities to send to the robot base
-       * @return The selected path or trajectory
+       * @return The selected path or trajectory, which belongs to the planner and is valid until the next call to
+       * findBestPath
        */
-      Trajectory findBestPath(tf::Stamped<tf::Pose> global_pose, tf::Stamped<tf::Pose> global_vel,
+      const Trajectory& findBestPath(tf::Stamped<tf::Pose> global_pose, tf::Stamped<tf::Pose> global_vel,
           tf::Stamped<tf::Pose>& drive_velocities);
 
       /**
@@ -155,6 +179,15 @@ namespace base_local_planner {
        */
       void getLocalGoal(double& x, double& y);
 
+      /**
+       * @brief  Accessor for how the last call to findBestPath spent its time
+       * @param grid_time Will be set to the seconds spent computing path and goal distances
+       * @param rollout_time Will be set to the seconds spent creating and scoring trajectories
+       * @param num_samples Will be set to the number of velocity samples laid out
+       * @param footprint_checks Will be set to the number of footprints checked for collisions
+       */
+      void getCycleStats(double& grid_time, double& rollout_time, unsigned int& num_samples, unsigned int& footprint_checks) const;
+
       /**
        * @brief  Generate and score a single trajectory
        * @param x The x position of the robot  
@@ -208,6 +241,15 @@ namespace base_local_planner {
       void updateFootprintAndRadii(std::vector<geometry_msgs::Point> footprint_spec, double inscribed_radius, double circumscribed_radius);
 
     private:
+      /**
+       * @brief What a trajectory needs to know to stop scoring itself once it can't beat the best one
+       */
+      struct CostBound {
+        double path_dist, goal_dist; ///< @brief The distances the trajectory will be scored with at its endpoint
+        double max_cost; ///< @brief The cost the trajectory has to come in under, negative for no bound
+        bool ties_lose; ///< @brief Whether the trajectory is also dropped when it can only match max_cost
+      };
+
       /**
        * @brief  Create the trajectories we wish to explore, score them, and return the best option
        * @param x The x position of the robot  
@@ -219,11 +261,56 @@ namespace base_local_planner {
        * @param acc_x The x acceleration limit of the robot
        * @param acc_y The y acceleration limit of the robot
        * @param acc_theta The theta acceleration limit of the robot
-       * @return 
+       * @return The best trajectory, one of the rollouts or traj_one
        */
-      Trajectory createTrajectories(double x, double y, double theta, double vx, double vy, double vtheta, 
+      const Trajectory& createTrajectories(double x, double y, double theta, double vx, double vy, double vtheta, 
           double acc_x, double acc_y, double acc_theta);
 
+      /**
+       * @brief  Add a velocity sample to the set of trajectories to score
+       * @param vx_samp The x velocity used to seed the trajectory
+       * @param vy_samp The y velocity used to seed the trajectory
+       * @param vtheta_samp The theta velocity used to seed the trajectory
+       */
+      void addRollout(double vx_samp, double vy_samp, double vtheta_samp);
+
+      /**
+       * @brief  Generate and score the trajectories of a range of samples, splitting them between the rollout threads. 
+       * Samples are scored in order of the cost of their endpoints, and a trajectory is dropped with a cost of -3 as soon as 
+       * it is known not to be picked over the best one.
+       * @param x The x position of the robot  
+       * @param y The y position of the robot  
+       * @param theta The orientation of the robot
+       * @param vx The x velocity of the robot
+       * @param vy The y velocity of the robot
+       * @param vtheta The theta velocity of the robot
+       * @param acc_x The x acceleration limit of the robot
+       * @param acc_y The y acceleration limit of the robot
+       * @param acc_theta The theta acceleration limit of the robot
+       * @param impossible_cost The cost value of a cell in the local map grid that is considered impassable
+       * @param begin The index of the first sample to score
+       * @param end One past the index of the last sample to score
+       * @param max_cost Trajectories that would cost more than this are dropped, negative to keep all of them
+       * @param find_min Set this to true if the lowest cost trajectory of the batch will be picked, with ties going to the earlier sample, 
+       * so that the bound can be tightened with each legal trajectory scored
+       */
+      void scoreRollouts(double x, double y, double theta, double vx, double vy, double vtheta,
+          double acc_x, double acc_y, double acc_theta, double impossible_cost, unsigned int begin, unsigned int end,
+          double max_cost = -1.0, bool find_min = false);
+
+      /**
+       * @brief  Score the share of the current samples that belongs to one rollout thread
+       * @param id The index of the thread, the calling thread is 0
+       * @param num_shares The number of threads the samples are split between
+       */
+      void scoreRolloutShare(unsigned int id, unsigned int num_shares);
+
+      /**
+       * @brief  The loop run by each of the rollout threads
+       * @param id The index of the thread
+       */
+      void rolloutThread(unsigned int id);
+
       /**
        * @brief  Generate and score a single trajectory
        * @param x The x position of the robot  
@@ -240,10 +327,71 @@ namespace base_local_planner {
        * @param acc_theta The theta acceleration limit of the robot
        * @param impossible_cost The cost value of a cell in the local map grid that is considered impassable
        * @param traj Will be set to the generated trajectory with its associated score 
+       * @param bound If not NULL, the trajectory is dropped with a cost of -3 as soon as it can't come in under the bound
+       * @param primitive If not NULL, the poses of the trajectory are taken from the primitive instead of being simulated
+       * @param swept If not NULL, the footprints are checked with it instead of the world model
+       * @param footprint_checks If not NULL, incremented for every footprint that gets checked
        */
       void generateTrajectory(double x, double y, double theta, double vx, double vy, 
           double vtheta, double vx_samp, double vy_samp, double vtheta_samp, double acc_x, double acc_y,
-          double acc_theta, double impossible_cost, Trajectory& traj);
+          double acc_theta, double impossible_cost, Trajectory& traj, const CostBound* bound = NULL,
+          const MotionPrimitive* primitive = NULL, SweptFootprint* swept = NULL, unsigned int* footprint_checks = NULL);
+
+      /**
+       * @brief  Get the swept footprint a thread checks its trajectories with
+       * @param id The id of the thread, 0 for the calling thread
+       * @return The swept footprint, or NULL if footprints are checked with the world model
+       */
+      SweptFootprint* getSweptFootprint(unsigned int id);
+
+      /**
+       * @brief  Compute the path and goal distance of the last point of a trajectory without checking it for collisions
+       * @param x The x position of the robot  
+       * @param y The y position of the robot  
+       * @param theta The orientation of the robot
+       * @param vx The x velocity of the robot
+       * @param vy The y velocity of the robot
+       * @param vtheta The theta velocity of the robot
+       * @param vx_samp The x velocity used to seed the trajectory
+       * @param vy_samp The y velocity used to seed the trajectory
+       * @param vtheta_samp The theta velocity used to seed the trajectory
+       * @param acc_x The x acceleration limit of the robot
+       * @param acc_y The y acceleration limit of the robot
+       * @param acc_theta The theta acceleration limit of the robot
+       * @param path_dist Will be set to the path distance that generateTrajectory would score the trajectory with
+       * @param goal_dist Will be set to the goal distance that generateTrajectory would score the trajectory with
+       * @param primitive If not NULL, the trajectory follows the primitive
+       * @return False if the trajectory leaves the map
+       */
+      bool getEndpointDistances(double x, double y, double theta, double vx, double vy, 
+          double vtheta, double vx_samp, double vy_samp, double vtheta_samp, double acc_x, double acc_y,
+          double acc_theta, double& path_dist, double& goal_dist, const MotionPrimitive* primitive = NULL);
+
+      /**
+       * @brief  Round the current velocity to the lattice of motion primitives and pick the primitives for it
+       * @param vx The x velocity of the robot, will be rounded
+       * @param vy The y velocity of the robot, will be rounded
+       * @param vtheta The theta velocity of the robot, will be rounded
+       */
+      void selectPrimitiveSet(double& vx, double& vy, double& vtheta);
+
+      /**
+       * @brief  Get the motion primitive for a velocity sample from the current velocity picked by selectPrimitiveSet, computing it if needed
+       * @param vx_samp The x velocity used to seed the trajectory
+       * @param vy_samp The y velocity used to seed the trajectory
+       * @param vtheta_samp The theta velocity used to seed the trajectory
+       * @return The primitive, or NULL if motion primitives are disabled
+       */
+      const MotionPrimitive* getPrimitive(double vx_samp, double vy_samp, double vtheta_samp);
+
+      /**
+       * @brief  Compute the number of simulation steps for a trajectory
+       * @param vx_samp The x velocity used to seed the trajectory
+       * @param vy_samp The y velocity used to seed the trajectory
+       * @param vtheta_samp The theta velocity used to seed the trajectory
+       * @return The number of steps, at least one
+       */
+      int getNumSteps(double vx_samp, double vy_samp, double vtheta_samp);
 
       /**
        * @brief  Checks the legality of the robot footprint at a position and orientation using the world model
@@ -254,6 +402,16 @@ namespace base_local_planner {
        */
       double footprintCost(double x_i, double y_i, double theta_i);
 
+      /**
+       * @brief  Checks the legality of the robot footprint at a position and orientation using the world model
+       * @param x_i The x position of the robot 
+       * @param y_i The y position of the robot 
+       * @param cos_th The cosine of the orientation of the robot
+       * @param sin_th The sine of the orientation of the robot
+       * @return 
+       */
+      double footprintCost(double x_i, double y_i, double cos_th, double sin_th);
+
       /**
        * @brief  Used to get the cells that make up the footprint of the robot
        * @param x_i The x position of the robot
@@ -314,7 +472,64 @@ namespace base_local_planner {
       double prev_x_, prev_y_; ///< @brief Used to calculate the distance the robot has traveled before reseting oscillation booleans
       double escape_x_, escape_y_, escape_theta_; ///< @brief Used to calculate the distance the robot has traveled before reseting escape booleans
 
-      Trajectory traj_one, traj_two; ///< @brief Used for scoring trajectories
+      Trajectory traj_one; ///< @brief Used for scoring the escape trajectory
+      Trajectory check_traj_; ///< @brief Used for scoring the trajectories of checkTrajectory and scoreTrajectory
+      unsigned int max_traj_points_; ///< @brief The number of points room is made for in each trajectory
+
+      std::vector<Trajectory> rollouts_; ///< @brief The trajectories of the velocity samples, kept between cycles to reuse their storage
+      std::vector<CostBound> rollout_bounds_; ///< @brief The endpoint distances and cost bounds of the velocity samples
+      std::vector<const MotionPrimitive*> rollout_primitives_; ///< @brief The motion primitives of the velocity samples, NULL when they're not used
+      unsigned int num_rollouts_; ///< @brief The number of samples in the current cycle
+      std::vector<std::pair<double, unsigned int> > rollout_order_; ///< @brief The samples of the current batch with their endpoint costs, in the order they're scored
+
+      /**
+       * @brief The state shared by the rollout threads for one batch of samples
+       */
+      struct RolloutState {
+        double x, y, theta, vx, vy, vtheta;
+        double acc_x, acc_y, acc_theta;
+        double impossible_cost;
+        bool bounded;
+      };
+
+      RolloutState rollout_state_; ///< @brief The robot state the current batch of samples is scored from
+      unsigned int rollout_threads_; ///< @brief The number of threads that score trajectories, including the calling thread
+      boost::thread_group rollout_workers_; ///< @brief The threads that help the calling thread score trajectories
+      boost::mutex rollout_mutex_; ///< @brief Protects the batch bookkeeping below
+      boost::condition_variable rollout_cond_; ///< @brief Wakes the rollout threads when a new batch is ready
+      boost::condition_variable rollout_done_cond_; ///< @brief Wakes the calling thread when the rollout threads are done with a batch
+      unsigned int rollout_batch_; ///< @brief Counts the batches handed to the rollout threads
+      unsigned int rollout_pending_; ///< @brief The number of rollout threads still working on the current batch
+      double rollout_max_cost_; ///< @brief The cost trajectories of the current batch have to come in under, negative for no bound
+      unsigned int rollout_max_index_; ///< @brief The sample that set rollout_max_cost_, trajectories after it lose ties with it
+      bool rollout_find_min_; ///< @brief Whether legal trajectories of the current batch tighten the bound
+      bool rollout_shutdown_; ///< @brief Tells the rollout threads to exit
+      bool bound_trajectories_; ///< @brief Whether trajectories are dropped once they can't beat the best one
+
+      typedef std::pair<double, std::pair<double, double> > VelocitySample; ///< @brief The x, y, and theta velocities a trajectory is seeded with
+      typedef std::pair<int, std::pair<int, int> > VelocityKey; ///< @brief A current velocity, in steps of the lattice
+
+      /**
+       * @brief The motion primitives from one current velocity
+       */
+      struct PrimitiveSet {
+        double vx, vy, vtheta; ///< @brief The current velocity the primitives start from
+        std::map<VelocitySample, MotionPrimitive> primitives; ///< @brief The primitives, by the velocities they're seeded with
+        unsigned int last_used; ///< @brief The cycle the set was last used in
+      };
+
+      bool motion_primitives_; ///< @brief Whether to score trajectories from motion primitives
+      double primitive_vel_resolution_, primitive_rot_resolution_; ///< @brief The spacing of the lattice of current velocities
+      unsigned int max_primitive_sets_; ///< @brief The number of current velocities to keep motion primitives for
+      std::map<VelocityKey, PrimitiveSet> primitive_sets_; ///< @brief The motion primitives, by the current velocity they start from
+      PrimitiveSet* primitive_set_; ///< @brief The motion primitives for the current cycle
+      unsigned int primitive_cycle_; ///< @brief Counts the cycles that used motion primitives
+
+      std::vector<SweptFootprint*> swept_footprints_; ///< @brief One swept footprint per thread, empty if footprints are checked with the world model
+
+      double grid_time_; ///< @brief The seconds the last cycle spent computing path and goal distances
+      double rollout_time_; ///< @brief The seconds the last cycle spent creating and scoring trajectories
+      unsigned int footprint_checks_; ///< @brief The footprints checked in the last cycle
 
       double heading_lookahead_; ///< @brief How far the robot should look ahead of itself when differentiating between different rotational velocities
       double oscillation_reset_dist_; ///< @brief The distance the robot must travel before it can explore rotational velocities that were unsuccessful in the past
@@ -47,6 +47,7 @@
 #include <base_local_planner/voxel_grid_model.h>
 #include <base_local_planner/trajectory_planner.h>
 #include <base_local_planner/map_grid_visualizer.h>
+#include <base_local_planner/cycle_profiler.h>
 
 #include <base_local_planner/planar_laser_scan.h>
 
@@ -57,6 +58,8 @@
 #include <geometry_msgs/Twist.h>
 #include <geometry_msgs/Point.h>
 
+#include <diagnostic_msgs/DiagnosticArray.h>
+
 #include <tf/transform_listener.h>
 
 #include <boost/thread.hpp>
@@ -172,6 +175,44 @@ namespace base_local_planner {
 
       std::vector<double> loadYVels(ros::NodeHandle node);
 
+      /**
+       * @brief  The part of computeVelocityCommands that the profiler times as one cycle
+       * @param cmd_vel Will be filled with the velocity command to be passed to the robot base
+       * @return True if a valid trajectory was found, false otherwise
+       */
+      bool runCycle(geometry_msgs::Twist& cmd_vel);
+
+      /**
+       * @brief  Update the copy of the costmap the controller uses, either the whole costmap or the window around the
+       * robot that its trajectories can reach
+       * @param global_pose The pose of the robot in the global frame
+       */
+      void updateCostmapCopy(const tf::Stamped<tf::Pose>& global_pose);
+
+      /**
+       * @brief  Add how the trajectory planner spent the cycle to the profiler
+       */
+      void profilePlanner();
+
+      /**
+       * @brief  Publish the cycle statistics on the diagnostics topic once per period, and start collecting new ones
+       */
+      void publishDiagnostics();
+
+      /**
+       * @brief The phases of a cycle that are timed, in the order they're added to the profiler
+       */
+      enum CyclePhase {
+        TRANSFORM_PHASE, PRUNE_PHASE, CLEAR_FOOTPRINT_PHASE, COSTMAP_COPY_PHASE, DISTANCES_PHASE, ROLLOUT_PHASE, PUBLISH_PHASE
+      };
+
+      /**
+       * @brief The counts that are kept for each cycle, in the order they're added to the profiler
+       */
+      enum CycleCount {
+        SAMPLES_COUNT, FOOTPRINT_CHECKS_COUNT
+      };
+
       double sign(double x){
         return x < 0.0 ? -1.0 : 1.0;
       }
@@ -190,6 +231,7 @@ namespace base_local_planner {
       double xy_goal_tolerance_, yaw_goal_tolerance_, min_in_place_vel_th_;
       double inscribed_radius_, circumscribed_radius_, inflation_radius_; 
       std::vector<geometry_msgs::PoseStamped> global_plan_;
+      std::vector<geometry_msgs::PoseStamped> local_plan_; ///< @brief The poses of the best trajectory, kept between cycles to reuse its memory
       bool prune_plan_;
       ros::Publisher g_plan_pub_, l_plan_pub_;
       ros::Subscriber odom_sub_;
@@ -200,6 +242,13 @@ namespace base_local_planner {
       double sim_period_;
       bool rotating_to_goal_;
       bool latch_xy_goal_tolerance_, xy_tolerance_latch_;
+      bool copy_costmap_window_; ///< @brief Whether to copy only the window of the costmap the trajectories can reach
+      double costmap_window_size_; ///< @brief How far the copied window reaches from the robot in each direction, in meters
+      CycleProfiler profiler_; ///< @brief Times the phases of each cycle
+      ros::Publisher diagnostics_pub_; ///< @brief Publishes the cycle statistics
+      std::string diagnostics_name_; ///< @brief The name the cycle statistics are published under
+      double diagnostics_period_; ///< @brief The seconds between publications of the cycle statistics, publishing is off when not positive
+      ros::WallTime last_diagnostics_; ///< @brief When the cycle statistics were last published
   };
 
 };
@@ -0,0 +1,252 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2008, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#include <base_local_planner/cycle_profiler.h>
+#include <stdio.h>
+#include <algorithm>
+
+namespace base_local_planner {
+  //the buckets go up in 1-2.5-5 steps from a tenth of a millisecond to a tenth of a second
+  static const double bucket_limits[CycleProfiler::NUM_BUCKETS - 1] = {
+    0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1
+  };
+
+  CycleProfiler::CycleProfiler(double budget)
+    : budget_(budget), current_phase_(-1), num_cycles_(0), num_slow_cycles_(0)
+  {
+    cycle_.name = "cycle";
+    cycle_.cycle_time = 0.0;
+    cycle_.histogram.resize(NUM_BUCKETS);
+    reset();
+  }
+
+  unsigned int CycleProfiler::addPhase(const std::string& name){
+    PhaseStats stats;
+    stats.name = name;
+    stats.histogram.resize(NUM_BUCKETS);
+    phases_.push_back(stats);
+    reset();
+    return phases_.size() - 1;
+  }
+
+  unsigned int CycleProfiler::addCount(const std::string& name){
+    CountStats stats;
+    stats.name = name;
+    counts_.push_back(stats);
+    reset();
+    return counts_.size() - 1;
+  }
+
+  void CycleProfiler::setBudget(double budget){
+    budget_ = budget;
+  }
+
+  double CycleProfiler::getBucketLimit(unsigned int bucket){
+    return bucket < NUM_BUCKETS - 1 ? bucket_limits[bucket] : -1.0;
+  }
+
+  void CycleProfiler::startCycle(){
+    for(unsigned int i = 0; i < phases_.size(); ++i)
+      phases_[i].cycle_time = 0.0;
+    for(unsigned int i = 0; i < counts_.size(); ++i)
+      counts_[i].cycle_value = 0;
+
+    current_phase_ = -1;
+    cycle_start_ = ros::WallTime::now();
+  }
+
+  void CycleProfiler::startPhase(unsigned int phase){
+    ros::WallTime now = ros::WallTime::now();
+    if(current_phase_ >= 0)
+      phases_[current_phase_].cycle_time += (now - phase_start_).toSec();
+
+    current_phase_ = phase;
+    phase_start_ = now;
+  }
+
+  void CycleProfiler::endPhase(){
+    if(current_phase_ < 0)
+      return;
+
+    phases_[current_phase_].cycle_time += (ros::WallTime::now() - phase_start_).toSec();
+    current_phase_ = -1;
+  }
+
+  void CycleProfiler::addPhaseTime(unsigned int phase, double seconds){
+    phases_[phase].cycle_time += seconds;
+  }
+
+  void CycleProfiler::setCount(unsigned int count, unsigned int value){
+    counts_[count].cycle_value = value;
+  }
+
+  void CycleProfiler::addTime(PhaseStats& stats, double seconds){
+    stats.total_time += seconds;
+    if(seconds > stats.max_time)
+      stats.max_time = seconds;
+
+    unsigned int bucket = 0;
+    while(bucket < NUM_BUCKETS - 1 && seconds > bucket_limits[bucket])
+      ++bucket;
+    ++stats.histogram[bucket];
+  }
+
+  bool CycleProfiler::endCycle(){
+    endPhase();
+    cycle_.cycle_time = (ros::WallTime::now() - cycle_start_).toSec();
+
+    addTime(cycle_, cycle_.cycle_time);
+    for(unsigned int i = 0; i < phases_.size(); ++i)
+      addTime(phases_[i], phases_[i].cycle_time);
+
+    for(unsigned int i = 0; i < counts_.size(); ++i){
+      CountStats& stats = counts_[i];
+      stats.total += stats.cycle_value;
+      if(stats.cycle_value > stats.max)
+        stats.max = stats.cycle_value;
+    }
+
+    ++num_cycles_;
+    if(cycle_.cycle_time > budget_){
+      ++num_slow_cycles_;
+      return true;
+    }
+    return false;
+  }
+
+  std::string CycleProfiler::getCycleSummary() const {
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%.2f ms of %.2f ms", cycle_.cycle_time * 1e3, budget_ * 1e3);
+    std::string summary = buf;
+
+    for(unsigned int i = 0; i < phases_.size(); ++i){
+      snprintf(buf, sizeof(buf), ", %s %.2f ms", phases_[i].name.c_str(), phases_[i].cycle_time * 1e3);
+      summary += buf;
+    }
+
+    for(unsigned int i = 0; i < counts_.size(); ++i){
+      snprintf(buf, sizeof(buf), ", %s %u", counts_[i].name.c_str(), counts_[i].cycle_value);
+      summary += buf;
+    }
+    return summary;
+  }
+
+  void CycleProfiler::getStatus(diagnostic_msgs::DiagnosticStatus& status) const {
+    char buf[256];
+    if(num_slow_cycles_ > 0){
+      status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+      snprintf(buf, sizeof(buf), "%u of %u cycles took longer than %.2f ms", num_slow_cycles_, num_cycles_, budget_ * 1e3);
+    }
+    else{
+      status.level = diagnostic_msgs::DiagnosticStatus::OK;
+      snprintf(buf, sizeof(buf), "%u cycles took at most %.2f ms", num_cycles_, budget_ * 1e3);
+    }
+    status.message = buf;
+    status.values.clear();
+
+    diagnostic_msgs::KeyValue value;
+    value.key = "cycles";
+    snprintf(buf, sizeof(buf), "%u", num_cycles_);
+    value.value = buf;
+    status.values.push_back(value);
+
+    value.key = "slow cycles";
+    snprintf(buf, sizeof(buf), "%u", num_slow_cycles_);
+    value.value = buf;
+    status.values.push_back(value);
+
+    //the whole cycle is reported the same way as its phases, each with a histogram of "limit in ms:cycles" pairs
+    for(int i = -1; i < (int)phases_.size(); ++i){
+      const PhaseStats& stats = i < 0 ? cycle_ : phases_[i];
+
+      value.key = stats.name + " mean ms";
+      snprintf(buf, sizeof(buf), "%.3f", num_cycles_ > 0 ? stats.total_time * 1e3 / num_cycles_ : 0.0);
+      value.value = buf;
+      status.values.push_back(value);
+
+      value.key = stats.name + " max ms";
+      snprintf(buf, sizeof(buf), "%.3f", stats.max_time * 1e3);
+      value.value = buf;
+      status.values.push_back(value);
+
+      value.key = stats.name + " histogram";
+      value.value.clear();
+      for(unsigned int j = 0; j < NUM_BUCKETS; ++j){
+        if(j < NUM_BUCKETS - 1)
+          snprintf(buf, sizeof(buf), "%s%g:%u", j > 0 ? " " : "", bucket_limits[j] * 1e3, stats.histogram[j]);
+        else
+          snprintf(buf, sizeof(buf), " inf:%u", stats.histogram[j]);
+        value.value += buf;
+      }
+      status.values.push_back(value);
+    }
+
+    for(unsigned int i = 0; i < counts_.size(); ++i){
+      const CountStats& stats = counts_[i];
+
+      value.key = stats.name + " mean";
+      snprintf(buf, sizeof(buf), "%.1f", num_cycles_ > 0 ? stats.total / num_cycles_ : 0.0);
+      value.value = buf;
+      status.values.push_back(value);
+
+      value.key = stats.name + " max";
+      snprintf(buf, sizeof(buf), "%u", stats.max);
+      value.value = buf;
+      status.values.push_back(value);
+    }
+  }
+
+  void CycleProfiler::reset(){
+    cycle_.total_time = 0.0;
+    cycle_.max_time = 0.0;
+    std::fill(cycle_.histogram.begin(), cycle_.histogram.end(), 0);
+
+    for(unsigned int i = 0; i < phases_.size(); ++i){
+      PhaseStats& stats = phases_[i];
+      stats.cycle_time = 0.0;
+      stats.total_time = 0.0;
+      stats.max_time = 0.0;
+      std::fill(stats.histogram.begin(), stats.histogram.end(), 0);
+    }
+
+    for(unsigned int i = 0; i < counts_.size(); ++i){
+      CountStats& stats = counts_[i];
+      stats.cycle_value = 0;
+      stats.total = 0.0;
+      stats.max = 0;
+    }
+
+    num_cycles_ = 0;
+    num_slow_cycles_ = 0;
+  }
+};
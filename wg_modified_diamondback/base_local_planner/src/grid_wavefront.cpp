@@ -0,0 +1,166 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2008, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#include <base_local_planner/grid_wavefront.h>
+#include <algorithm>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace base_local_planner {
+  const unsigned int GridWavefront::FREE;
+  const unsigned int GridWavefront::BLOCKED;
+  const unsigned int GridWavefront::BORDER;
+
+  GridWavefront::GridWavefront()
+    : size_x_(0), size_y_(0), stride_(0), states_(NULL)
+  {
+  }
+
+  void GridWavefront::setCells(const unsigned char* states, unsigned int size_x, unsigned int size_y, unsigned char blocked){
+    size_x_ = size_x;
+    size_y_ = size_y;
+    stride_ = size_x + 2;
+    states_ = states;
+
+    //the border keeps the search from walking off of the grid without checking where it is
+    obstacles_.assign(stride_ * (size_y_ + 2), BORDER);
+    cells_.resize(obstacles_.size());
+    queue_.resize(obstacles_.size());
+
+    for(unsigned int y = 0; y < size_y_; ++y){
+      const unsigned char* state = states + y * size_x_;
+      unsigned int* cell = &obstacles_[(y + 1) * stride_ + 1];
+      unsigned int x = 0;
+#ifdef __SSE2__
+      //16 cells at a time, the flag test of each state byte is widened to a mask over its whole cell, and since FREE
+      //is all ones, or-ing that mask into BLOCKED gives the cell
+      const __m128i zero = _mm_setzero_si128();
+      const __m128i flag = _mm_set1_epi8((char)blocked);
+      const __m128i blocked_cell = _mm_set1_epi32((int)BLOCKED);
+      for(; x + 16 <= size_x_; x += 16){
+        __m128i is_free = _mm_cmpeq_epi8(_mm_and_si128(_mm_loadu_si128((const __m128i*)(state + x)), flag), zero);
+        __m128i lo = _mm_unpacklo_epi8(is_free, is_free);
+        __m128i hi = _mm_unpackhi_epi8(is_free, is_free);
+        _mm_storeu_si128((__m128i*)(cell + x), _mm_or_si128(blocked_cell, _mm_unpacklo_epi16(lo, lo)));
+        _mm_storeu_si128((__m128i*)(cell + x + 4), _mm_or_si128(blocked_cell, _mm_unpackhi_epi16(lo, lo)));
+        _mm_storeu_si128((__m128i*)(cell + x + 8), _mm_or_si128(blocked_cell, _mm_unpacklo_epi16(hi, hi)));
+        _mm_storeu_si128((__m128i*)(cell + x + 12), _mm_or_si128(blocked_cell, _mm_unpackhi_epi16(hi, hi)));
+      }
+#endif
+      for(; x < size_x_; ++x)
+        cell[x] = state[x] & blocked ? BLOCKED : FREE;
+    }
+  }
+
+  void GridWavefront::computeDistances(const unsigned char* sources, unsigned int* const* dists, unsigned int num_fields,
+      unsigned int blocked_dist, unsigned int unreached_dist){
+    for(unsigned int f = 0; f < num_fields; ++f){
+      memcpy(&cells_[0], &obstacles_[0], cells_.size() * sizeof(unsigned int));
+
+      //the sources are the wavefront at distance 0
+      unsigned int tail = 0;
+      for(unsigned int y = 0; y < size_y_; ++y){
+        const unsigned char* state = states_ + y * size_x_;
+        unsigned int row = (y + 1) * stride_ + 1;
+        unsigned int x = 0;
+#ifdef __SSE2__
+        //the sources are few, so whole runs of 16 cells without one are skipped
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i flag = _mm_set1_epi8((char)sources[f]);
+        for(; x + 16 <= size_x_; x += 16){
+          __m128i v = _mm_and_si128(_mm_loadu_si128((const __m128i*)(state + x)), flag);
+          if(_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)) == 0xffff)
+            continue;
+          for(unsigned int i = x; i < x + 16; ++i){
+            if(state[i] & sources[f]){
+              cells_[row + i] = 0;
+              queue_[tail++] = row + i;
+            }
+          }
+        }
+#endif
+        for(; x < size_x_; ++x){
+          if(state[x] & sources[f]){
+            cells_[row + x] = 0;
+            queue_[tail++] = row + x;
+          }
+        }
+      }
+      expand(tail, blocked_dist);
+
+      //copy the distances out of the work grid, the cells that weren't reached are still FREE or BLOCKED
+      for(unsigned int y = 0; y < size_y_; ++y){
+        const unsigned int* cell = &cells_[(y + 1) * stride_ + 1];
+        unsigned int* dist = dists[f] + y * size_x_;
+        unsigned int x = 0;
+#ifdef __SSE2__
+        const __m128i free_cell = _mm_set1_epi32((int)FREE);
+        const __m128i blocked_cell = _mm_set1_epi32((int)BLOCKED);
+        const __m128i unreached = _mm_set1_epi32((int)unreached_dist);
+        for(; x + 4 <= size_x_; x += 4){
+          __m128i v = _mm_loadu_si128((const __m128i*)(cell + x));
+          __m128i missed = _mm_or_si128(_mm_cmpeq_epi32(v, free_cell), _mm_cmpeq_epi32(v, blocked_cell));
+          v = _mm_or_si128(_mm_andnot_si128(missed, v), _mm_and_si128(missed, unreached));
+          _mm_storeu_si128((__m128i*)(dist + x), v);
+        }
+#endif
+        for(; x < size_x_; ++x)
+          dist[x] = cell[x] == FREE || cell[x] == BLOCKED ? unreached_dist : cell[x];
+      }
+    }
+  }
+
+  void GridWavefront::expand(unsigned int tail, unsigned int blocked_dist){
+    unsigned int* cells = &cells_[0];
+    unsigned int* queue = &queue_[0];
+    unsigned int stride = stride_;
+
+    //each wavefront is the run of the queue after the one before it, so the distance only changes between runs
+    unsigned int dist = 1;
+    unsigned int front_end = tail;
+    for(unsigned int head = 0; head < tail; ++head){
+      if(head == front_end){
+        ++dist;
+        front_end = tail;
+      }
+      unsigned int index = queue[head];
+      reachCell(index - 1, dist, blocked_dist, cells, queue, tail);
+      reachCell(index + 1, dist, blocked_dist, cells, queue, tail);
+      reachCell(index - stride, dist, blocked_dist, cells, queue, tail);
+      reachCell(index + stride, dist, blocked_dist, cells, queue, tail);
+    }
+  }
+};
@@ -32,24 +32,27 @@
  *  POSSIBILITY OF SUCH DAMAGE.
  *********************************************************************/
 #include <base_local_planner/map_grid.h>
+#include <cstring>
 
 using namespace std;
 
 namespace base_local_planner{
 
+  const unsigned int MapGrid::UNREACHED_DIST;
+
   MapGrid::MapGrid()
-    : size_x_(0), size_y_(0)
+    : size_x_(0), size_y_(0), incremental_valid_(false), last_resolution_(0.0), last_goal_(-1)
   {
   }
 
   MapGrid::MapGrid(unsigned int size_x, unsigned int size_y) 
-    : size_x_(size_x), size_y_(size_y)
+    : size_x_(size_x), size_y_(size_y), incremental_valid_(false), last_resolution_(0.0), last_goal_(-1)
   {
     commonInit();
   }
 
   MapGrid::MapGrid(unsigned int size_x, unsigned int size_y, double s, double x, double y)
-    : size_x_(size_x), size_y_(size_y), scale(s), origin_x(x), origin_y(y)
+    : size_x_(size_x), size_y_(size_y), scale(s), origin_x(x), origin_y(y), incremental_valid_(false), last_resolution_(0.0), last_goal_(-1)
   {
     commonInit();
   }
@@ -57,23 +60,21 @@ namespace base_local_planner{
   MapGrid::MapGrid(const MapGrid& mg){
     size_y_ = mg.size_y_;
     size_x_ = mg.size_x_;
-    map_ = mg.map_;
+    path_dist_ = mg.path_dist_;
+    goal_dist_ = mg.goal_dist_;
+    within_robot_ = mg.within_robot_;
+    incremental_valid_ = false;
+    last_resolution_ = 0.0;
+    last_goal_ = -1;
   }
 
   void MapGrid::commonInit(){
     //don't allow construction of zero size grid
     ROS_ASSERT(size_y_ != 0 && size_x_ != 0);
 
-    map_.resize(size_y_ * size_x_);
-
-    //make each cell aware of its location in the grid
-    for(unsigned int i = 0; i < size_y_; ++i){
-      for(unsigned int j = 0; j < size_x_; ++j){
-        unsigned int id = size_x_ * i + j;
-        map_[id].cx = j;
-        map_[id].cy = i;
-      }
-    }
+    path_dist_.resize(size(), UNREACHED_DIST);
+    goal_dist_.resize(size(), UNREACHED_DIST);
+    within_robot_.resize(size(), 0);
   }
 
   size_t MapGrid::getIndex(int x, int y){
@@ -83,60 +84,147 @@ namespace base_local_planner{
   MapGrid& MapGrid::operator= (const MapGrid& mg){
     size_y_ = mg.size_y_;
     size_x_ = mg.size_x_;
-    map_ = mg.map_;
+    path_dist_ = mg.path_dist_;
+    goal_dist_ = mg.goal_dist_;
+    within_robot_ = mg.within_robot_;
+    incremental_valid_ = false;
     return *this;
   }
 
   void MapGrid::sizeCheck(unsigned int size_x, unsigned int size_y, double o_x, double o_y){
-    if(map_.size() != size_x * size_y)
-      map_.resize(size_x * size_y);
-
-    if(size_x_ != size_x || size_y_ != size_y){
-      size_x_ = size_x;
-      size_y_ = size_y;
-
-      for(unsigned int i = 0; i < size_y_; ++i){
-        for(unsigned int j = 0; j < size_x_; ++j){
-          int index = size_x_ * i + j;
-          map_[index].cx = j;
-          map_[index].cy = i;
-        }
-      }
+    if(path_dist_.size() != size_x * size_y){
+      path_dist_.resize(size_x * size_y, UNREACHED_DIST);
+      goal_dist_.resize(size_x * size_y, UNREACHED_DIST);
+      within_robot_.resize(size_x * size_y, 0);
     }
+
+    size_x_ = size_x;
+    size_y_ = size_y;
     origin_x = o_x;
     origin_y = o_y;
   }
 
   //reset the path_dist and goal_dist fields for all cells
   void MapGrid::resetPathDist(){
-    for(unsigned int i = 0; i < map_.size(); ++i){
-      map_[i].path_dist = DBL_MAX;
-      map_[i].goal_dist = DBL_MAX;
-      map_[i].path_mark = false;
-      map_[i].goal_mark = false;
-      map_[i].within_robot = false;
-    }
+    std::fill(path_dist_.begin(), path_dist_.end(), UNREACHED_DIST);
+    std::fill(goal_dist_.begin(), goal_dist_.end(), UNREACHED_DIST);
+    std::fill(within_robot_.begin(), within_robot_.end(), 0);
+    incremental_valid_ = false;
   }
 
   //update what map cells are considered path based on the global_plan
   void MapGrid::setPathCells(const costmap_2d::Costmap2D& costmap, const std::vector<geometry_msgs::PoseStamped>& global_plan){
     sizeCheck(costmap.getSizeInCellsX(), costmap.getSizeInCellsY(), costmap.getOriginX(), costmap.getOriginY());
-    int local_goal_x = -1;
-    int local_goal_y = -1;
+
+    //the path cells start the path distance, the last of them the goal distance, and both are expanded over the
+    //same obstacles
+    last_goal_ = getCellStates(costmap, global_plan, cell_state_);
+    searchSources(CELL_PATH | CELL_GOAL);
+  }
+
+  void MapGrid::updatePathCells(const costmap_2d::Costmap2D& costmap, const std::vector<geometry_msgs::PoseStamped>& global_plan,
+      const std::vector<base_local_planner::Position2DInt>& footprint_cells){
+    //the last distances can only be reused on a grid of the same size and resolution that moved by whole cells
+    int dx = 0, dy = 0;
+    bool reuse = incremental_valid_ && size_x_ == costmap.getSizeInCellsX() && size_y_ == costmap.getSizeInCellsY()
+      && last_resolution_ == costmap.getResolution();
+    if(reuse){
+      double shift_x = (costmap.getOriginX() - origin_x) / last_resolution_;
+      double shift_y = (costmap.getOriginY() - origin_y) / last_resolution_;
+      dx = int(floor(shift_x + 0.5));
+      dy = int(floor(shift_y + 0.5));
+      reuse = fabs(shift_x - dx) < 1e-3 && fabs(shift_y - dy) < 1e-3 && abs(dx) < int(size_x_) && abs(dy) < int(size_y_);
+    }
+    bool shifted = dx != 0 || dy != 0;
+
+    //the cells under the old footprint of the robot are obstacles again if the costmap says so
+    if(reuse){
+      for(unsigned int i = 0; i < robot_cells_.size(); ++i)
+        within_robot_[getIndex(robot_cells_[i].x, robot_cells_[i].y)] = 0;
+      for(unsigned int i = 0; i < footprint_cells.size(); ++i)
+        within_robot_[getIndex(footprint_cells[i].x, footprint_cells[i].y)] = 1;
+    }
+
+    int local_goal = -1;
+    bool goal_moved = true;
+    if(reuse){
+      local_goal = getCellStates(costmap, global_plan, cell_state_);
+      if(last_goal_ >= 0){
+        int goal_x = last_goal_ % int(size_x_) - dx;
+        int goal_y = last_goal_ / int(size_x_) - dy;
+        goal_moved = goal_x < 0 || goal_x >= int(size_x_) || goal_y < 0 || goal_y >= int(size_y_) || local_goal != int(getIndex(goal_x, goal_y));
+      }
+      else
+        goal_moved = local_goal >= 0;
+
+      //a grid that rolls along with the robot usually takes the local goal along with it, and then moving every
+      //distance over and searching for the goal distance again costs more than searching for both from scratch
+      reuse = !(shifted && goal_moved);
+    }
+
+    if(!reuse){
+      sizeCheck(costmap.getSizeInCellsX(), costmap.getSizeInCellsY(), costmap.getOriginX(), costmap.getOriginY());
+      resetPathDist();
+      for(unsigned int i = 0; i < footprint_cells.size(); ++i)
+        within_robot_[getIndex(footprint_cells[i].x, footprint_cells[i].y)] = 1;
+      setPathCells(costmap, global_plan);
+
+      last_state_.swap(cell_state_);
+      robot_cells_ = footprint_cells;
+      last_resolution_ = costmap.getResolution();
+      incremental_valid_ = true;
+      return;
+    }
+
+    if(shifted)
+      shiftCells(dx, dy);
+    sizeCheck(costmap.getSizeInCellsX(), costmap.getSizeInCellsY(), costmap.getOriginX(), costmap.getOriginY());
+    robot_cells_ = footprint_cells;
+
+    //the cells whose state changed are the only places the distances can start to differ
+    changed_cells_.clear();
+    for(unsigned int i = 0; i < last_state_.size(); ++i){
+      if(last_state_[i] != cell_state_[i])
+        changed_cells_.push_back(i);
+    }
+
+    repairDistance(path_dist_, CELL_PATH, shifted);
+
+    //the goal distance all hangs off of one cell, so when the local goal moves none of it survives and searching
+    //from scratch is cheaper than throwing it away cell by cell
+    if(goal_moved)
+      searchSources(CELL_GOAL);
+    else
+      repairDistance(goal_dist_, CELL_GOAL, shifted);
+
+    last_state_.swap(cell_state_);
+    last_goal_ = local_goal;
+  }
+
+  void MapGrid::getObstacleStates(const costmap_2d::Costmap2D& costmap, std::vector<unsigned char>& states){
+    states.resize(size());
+
+    //the cells that the distances stop at, unless they're within the robot
+    unsigned char cost_states[256];
+    for(unsigned int cost = 0; cost < 256; ++cost)
+      cost_states[cost] = cost == costmap_2d::LETHAL_OBSTACLE || cost == costmap_2d::INSCRIBED_INFLATED_OBSTACLE || cost == costmap_2d::NO_INFORMATION ? CELL_BLOCKED : 0;
+    const unsigned char* costs = costmap.getCharMap();
+    for(unsigned int i = 0; i < states.size(); ++i)
+      states[i] = within_robot_[i] ? 0 : cost_states[costs[i]];
+  }
+
+  int MapGrid::getCellStates(const costmap_2d::Costmap2D& costmap, const std::vector<geometry_msgs::PoseStamped>& global_plan,
+      std::vector<unsigned char>& states){
+    getObstacleStates(costmap, states);
+
+    //the cells of the plan up to where it first leaves the grid, the last of them is the local goal
+    int local_goal = -1;
     bool started_path = false;
-    queue<MapCell*> path_dist_queue;
-    queue<MapCell*> goal_dist_queue;
     for(unsigned int i = 0; i < global_plan.size(); ++i){
-      double g_x = global_plan[i].pose.position.x;
-      double g_y = global_plan[i].pose.position.y;
       unsigned int map_x, map_y;
-      if(costmap.worldToMap(g_x, g_y, map_x, map_y) && costmap.getCost(map_x, map_y) != costmap_2d::NO_INFORMATION){
-        MapCell& current = getCell(map_x, map_y);
-        current.path_dist = 0.0;
-        current.path_mark = true;
-        path_dist_queue.push(&current);
-        local_goal_x = map_x;
-        local_goal_y = map_y;
+      if(costmap.worldToMap(global_plan[i].pose.position.x, global_plan[i].pose.position.y, map_x, map_y) && costmap.getCost(map_x, map_y) != costmap_2d::NO_INFORMATION){
+        local_goal = getIndex(map_x, map_y);
+        states[local_goal] |= CELL_PATH;
         started_path = true;
       }
       else{
@@ -145,98 +233,208 @@ namespace base_local_planner{
       }
     }
 
-    if(local_goal_x >= 0 && local_goal_y >= 0){
-      MapCell& current = getCell(local_goal_x, local_goal_y);
-      costmap.mapToWorld(local_goal_x, local_goal_y, goal_x_, goal_y_);
-      current.goal_dist = 0.0;
-      current.goal_mark = true;
-      goal_dist_queue.push(&current);
+    if(local_goal >= 0){
+      states[local_goal] |= CELL_GOAL;
+      costmap.mapToWorld(local_goal % size_x_, local_goal / size_x_, goal_x_, goal_y_);
     }
-    //compute our distances
-    computePathDistance(path_dist_queue, costmap);
-    computeGoalDistance(goal_dist_queue, costmap);
+    return local_goal;
+  }
+
+  void MapGrid::computePathDistance(std::vector<unsigned int>& dist_queue, const costmap_2d::Costmap2D& costmap){
+    getObstacleStates(costmap, cell_state_);
+    searchDistance(path_dist_, dist_queue);
+    incremental_valid_ = false;
   }
 
-  void MapGrid::computePathDistance(queue<MapCell*>& dist_queue, const costmap_2d::Costmap2D& costmap){
-    MapCell* current_cell;
-    MapCell* check_cell;
+  void MapGrid::computeGoalDistance(std::vector<unsigned int>& dist_queue, const costmap_2d::Costmap2D& costmap){
+    getObstacleStates(costmap, cell_state_);
+    searchDistance(goal_dist_, dist_queue);
+    incremental_valid_ = false;
+  }
+
+  void MapGrid::searchDistance(std::vector<unsigned int>& dist, std::vector<unsigned int>& dist_queue){
+    //the queue never holds a cell twice, so it never has to grow past the size of the grid while it's searched
+    dist_queue.reserve(size());
+    unsigned int* cell_dist = &dist[0];
     unsigned int last_col = size_x_ - 1;
-    unsigned int last_row = size_y_ - 1;
-    while(!dist_queue.empty()){
-      current_cell = dist_queue.front();
-      check_cell = current_cell;
-      dist_queue.pop();
-
-      if(current_cell->cx > 0){
-        check_cell = current_cell - 1;
-        if(!check_cell->path_mark){
-          updatePathCell(current_cell, check_cell, dist_queue, costmap);
-        }
-      }
+    unsigned int last_row_start = size() - size_x_;
+    for(unsigned int head = 0; head < dist_queue.size(); ++head){
+      unsigned int index = dist_queue[head];
+      unsigned int new_dist = cell_dist[index] + 1;
+      unsigned int col = index % size_x_;
 
-      if(current_cell->cx < last_col){
-        check_cell = current_cell + 1;
-        if(!check_cell->path_mark){
-          updatePathCell(current_cell, check_cell, dist_queue, costmap);
-        }
+      if(col > 0)
+        updateCell(index - 1, new_dist, cell_dist, dist_queue);
+      if(col < last_col)
+        updateCell(index + 1, new_dist, cell_dist, dist_queue);
+      if(index >= size_x_)
+        updateCell(index - size_x_, new_dist, cell_dist, dist_queue);
+      if(index < last_row_start)
+        updateCell(index + size_x_, new_dist, cell_dist, dist_queue);
+    }
+  }
+
+  template<class T>
+  void MapGrid::shiftValues(std::vector<T>& values, int dx, int dy, T fill){
+    //each row takes the values of the row dy further along, so walking the rows towards the ones that are read
+    //from never reads a row that was already overwritten
+    unsigned int width = size_x_ - abs(dx);
+    unsigned int from_x = dx > 0 ? dx : 0;
+    unsigned int to_x = dx > 0 ? 0 : -dx;
+    unsigned int fill_x = dx > 0 ? width : 0;
+    for(int i = 0; i < int(size_y_); ++i){
+      int y = dy > 0 ? i : size_y_ - 1 - i;
+      T* row = &values[y * size_x_];
+      int old_y = y + dy;
+      if(old_y < 0 || old_y >= int(size_y_)){
+        //the whole row just came onto the grid
+        std::fill(row, row + size_x_, fill);
+        continue;
       }
+      memmove(row + to_x, &values[old_y * size_x_ + from_x], width * sizeof(T));
+      std::fill(row + fill_x, row + fill_x + abs(dx), fill);
+    }
+  }
 
-      if(current_cell->cy > 0){
-        check_cell = current_cell - size_x_;
-        if(!check_cell->path_mark){
-          updatePathCell(current_cell, check_cell, dist_queue, costmap);
-        }
+  void MapGrid::shiftCells(int dx, int dy){
+    shiftValues(path_dist_, dx, dy, UNREACHED_DIST);
+    shiftValues(goal_dist_, dx, dy, UNREACHED_DIST);
+    shiftValues(last_state_, dx, dy, (unsigned char)CELL_UNKNOWN);
+  }
+
+  //a distance is kept where a neighbor one closer to the source still supports it, thrown away where it isn't, and then
+  //filled back in from the cells around the changes, which gives the same distances as the breadth first search
+  void MapGrid::repairDistance(std::vector<unsigned int>& dist, unsigned char source, bool shifted){
+    unsigned int neighbors[4];
+    invalid_cells_.clear();
+    lowered_cells_.clear();
+
+    //cells the distance doesn't propagate through are skipped while repairing and get their distance at the end, so
+    //only the ones that just opened up need to lose the distance they had
+    for(unsigned int i = 0; i < changed_cells_.size(); ++i){
+      unsigned int index = changed_cells_[i];
+      if(!openCell(last_state_[index], source))
+        dist[index] = UNREACHED_DIST;
+    }
+
+    //the cells that may have lost the neighbor that supported their distance
+    for(unsigned int i = 0; i < changed_cells_.size(); ++i){
+      unsigned int index = changed_cells_[i];
+      pushReachedCell(index, dist, source);
+      unsigned int n = getNeighbors(index, neighbors);
+      for(unsigned int j = 0; j < n; ++j)
+        pushReachedCell(neighbors[j], dist, source);
+    }
+
+    //when the grid moves, the cells along its edges may have been supported by cells that fell off of it
+    if(shifted){
+      for(unsigned int x = 0; x < size_x_; ++x){
+        pushReachedCell(getIndex(x, 0), dist, source);
+        pushReachedCell(getIndex(x, size_y_ - 1), dist, source);
+      }
+      for(unsigned int y = 0; y < size_y_; ++y){
+        pushReachedCell(getIndex(0, y), dist, source);
+        pushReachedCell(getIndex(size_x_ - 1, y), dist, source);
       }
+    }
+
+    //throw away the distances that aren't supported anymore, closest to the source first
+    for(unsigned int k = 0; k < dist_buckets_.size(); ++k){
+      for(unsigned int i = 0; i < dist_buckets_[k].size(); ++i){
+        unsigned int index = dist_buckets_[k][i];
+        if(dist[index] != k || !openCell(cell_state_[index], source))
+          continue;
+
+        bool supported = (cell_state_[index] & source) != 0;
+        unsigned int n = getNeighbors(index, neighbors);
+        for(unsigned int j = 0; j < n && !supported; ++j)
+          supported = k > 0 && dist[neighbors[j]] == k - 1 && openCell(cell_state_[neighbors[j]], source);
+        if(supported)
+          continue;
 
-      if(current_cell->cy < last_row){
-        check_cell = current_cell + size_x_;
-        if(!check_cell->path_mark){
-          updatePathCell(current_cell, check_cell, dist_queue, costmap);
+        dist[index] = UNREACHED_DIST;
+        invalid_cells_.push_back(index);
+        for(unsigned int j = 0; j < n; ++j){
+          if(dist[neighbors[j]] == k + 1 && openCell(cell_state_[neighbors[j]], source))
+            pushCell(neighbors[j], k + 1);
         }
       }
+      dist_buckets_[k].clear();
     }
-  }
 
-  void MapGrid::computeGoalDistance(queue<MapCell*>& dist_queue, const costmap_2d::Costmap2D& costmap){
-    MapCell* current_cell;
-    MapCell* check_cell;
-    unsigned int last_col = size_x_ - 1;
-    unsigned int last_row = size_y_ - 1;
-    while(!dist_queue.empty()){
-      current_cell = dist_queue.front();
-      current_cell->goal_mark = true;
-      check_cell = current_cell;
-      dist_queue.pop();
-
-      if(current_cell->cx > 0){
-        check_cell = current_cell - 1;
-        if(!check_cell->goal_mark){
-          updateGoalCell(current_cell, check_cell, dist_queue, costmap);
-        }
+    //fill the distances back in from the sources and the cells around the changes
+    for(unsigned int i = 0; i < changed_cells_.size(); ++i){
+      unsigned int index = changed_cells_[i];
+      if(cell_state_[index] & source){
+        dist[index] = 0;
+        pushCell(index, 0);
       }
+    }
+    for(unsigned int c = 0; c < changed_cells_.size() + invalid_cells_.size(); ++c){
+      unsigned int index = c < changed_cells_.size() ? changed_cells_[c] : invalid_cells_[c - changed_cells_.size()];
+      unsigned int n = getNeighbors(index, neighbors);
+      for(unsigned int j = 0; j < n; ++j)
+        pushReachedCell(neighbors[j], dist, source);
+    }
+
+    for(unsigned int k = 0; k < dist_buckets_.size(); ++k){
+      for(unsigned int i = 0; i < dist_buckets_[k].size(); ++i){
+        unsigned int index = dist_buckets_[k][i];
+        if(dist[index] != k)
+          continue;
 
-      if(current_cell->cx < last_col){
-        check_cell = current_cell + 1;
-        if(!check_cell->goal_mark){
-          updateGoalCell(current_cell, check_cell, dist_queue, costmap);
+        unsigned int n = getNeighbors(index, neighbors);
+        for(unsigned int j = 0; j < n; ++j){
+          if(openCell(cell_state_[neighbors[j]], source) && k + 1 < dist[neighbors[j]]){
+            dist[neighbors[j]] = k + 1;
+            lowered_cells_.push_back(neighbors[j]);
+            pushCell(neighbors[j], k + 1);
+          }
         }
       }
+      dist_buckets_[k].clear();
+    }
 
-      if(current_cell->cy > 0){
-        check_cell = current_cell - size_x_;
-        if(!check_cell->goal_mark){
-          updateGoalCell(current_cell, check_cell, dist_queue, costmap);
-        }
+    //only the cells whose distance changed and the ones next to them can need a new distance
+    const std::vector<unsigned int>* touched[3] = { &changed_cells_, &invalid_cells_, &lowered_cells_ };
+    for(unsigned int t = 0; t < 3; ++t){
+      for(unsigned int i = 0; i < touched[t]->size(); ++i){
+        unsigned int index = (*touched[t])[i];
+        finishCell(index, dist, source);
+        unsigned int n = getNeighbors(index, neighbors);
+        for(unsigned int j = 0; j < n; ++j)
+          finishCell(neighbors[j], dist, source);
       }
+    }
 
-      if(current_cell->cy < last_row){
-        check_cell = current_cell + size_x_;
-        if(!check_cell->goal_mark){
-          updateGoalCell(current_cell, check_cell, dist_queue, costmap);
-        }
+    //and the cells along the edges of a grid that moved may have lost a neighbor that fell off of it
+    if(shifted){
+      for(unsigned int x = 0; x < size_x_; ++x){
+        finishCell(getIndex(x, 0), dist, source);
+        finishCell(getIndex(x, size_y_ - 1), dist, source);
+      }
+      for(unsigned int y = 0; y < size_y_; ++y){
+        finishCell(getIndex(0, y), dist, source);
+        finishCell(getIndex(size_x_ - 1, y), dist, source);
       }
     }
   }
 
+  void MapGrid::searchSources(unsigned char sources){
+    unsigned char flags[2];
+    unsigned int* dists[2];
+    unsigned int num_fields = 0;
+    if(sources & CELL_PATH){
+      flags[num_fields] = CELL_PATH;
+      dists[num_fields++] = &path_dist_[0];
+    }
+    if(sources & CELL_GOAL){
+      flags[num_fields] = CELL_GOAL;
+      dists[num_fields++] = &goal_dist_[0];
+    }
+
+    wavefront_.setCells(&cell_state_[0], size_x_, size_y_, CELL_BLOCKED);
+    wavefront_.computeDistances(flags, dists, num_fields, size(), UNREACHED_DIST);
+  }
 
 };
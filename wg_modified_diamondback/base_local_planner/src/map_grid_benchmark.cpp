@@ -0,0 +1,159 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2008, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#include <base_local_planner/map_grid.h>
+#include <base_local_planner/grid_wavefront.h>
+#include <sys/time.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+
+using namespace std;
+using namespace base_local_planner;
+
+//timing test of the MapGrid distance computations, computes the path and goal distances of random local grids with the
+//breadth first search of MapGrid and with GridWavefront, checks that the two agree and reports the time of each
+namespace {
+  double wallMs(){
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return t.tv_sec * 1000.0 + t.tv_usec * 0.001;
+  }
+
+  //runs both searches on a size x size grid, returns false if they differ
+  bool benchGrid(int size, int reps, int obstacles){
+    const double res = 0.025;
+
+    //obstacle blocks, inflated by the costmap
+    vector<unsigned char> data(size * size, 0);
+    for(int i = 0; i < obstacles; ++i){
+      int x0 = rand() % size, y0 = rand() % size;
+      for(int y = y0; y < y0 + 4 && y < size; ++y){
+        for(int x = x0; x < x0 + 4 && x < size; ++x)
+          data[y * size + x] = costmap_2d::LETHAL_OBSTACLE;
+      }
+    }
+    costmap_2d::Costmap2D costmap(size, size, res, 0.0, 0.0, 0.325, 0.46, 0.55, 0.0, 0.0, 0.0, 10.0, data, 100);
+
+    //a winding path across the grid, the local goal is its last cell
+    vector<unsigned int> path;
+    for(int x = 0; x < size; ++x){
+      int y = (int)(size * (0.5 + 0.3 * sin(x * 6.0 / size)));
+      path.push_back(y * size + x);
+    }
+    unsigned int goal = path.back();
+
+    //the cell states the wavefront starts from, taken from the costmap the same way MapGrid does it
+    const unsigned char* costs = costmap.getCharMap();
+    vector<unsigned char> states(size * size);
+    unsigned char cost_states[256];
+    for(int c = 0; c < 256; ++c){
+      bool blocked = c == costmap_2d::LETHAL_OBSTACLE || c == costmap_2d::INSCRIBED_INFLATED_OBSTACLE
+        || c == costmap_2d::NO_INFORMATION;
+      cost_states[c] = blocked ? MapGrid::CELL_BLOCKED : 0;
+    }
+
+    MapGrid grid(size, size);
+    GridWavefront wavefront;
+    vector<unsigned int> path_dist(size * size), goal_dist(size * size);
+    vector<unsigned int> queue;
+    double t_bfs = 0, t_wave = 0;
+
+    for(int r = 0; r < reps; ++r){
+      double t0 = wallMs();
+      grid.resetPathDist();
+      queue.clear();
+      for(unsigned int i = 0; i < path.size(); ++i){
+        if(grid.path_dist_[path[i]] != 0){
+          grid.path_dist_[path[i]] = 0;
+          queue.push_back(path[i]);
+        }
+      }
+      grid.computePathDistance(queue, costmap);
+      queue.clear();
+      grid.goal_dist_[goal] = 0;
+      queue.push_back(goal);
+      grid.computeGoalDistance(queue, costmap);
+      double t1 = wallMs();
+
+      for(int i = 0; i < size * size; ++i)
+        states[i] = cost_states[costs[i]];
+      for(unsigned int i = 0; i < path.size(); ++i)
+        states[path[i]] |= MapGrid::CELL_PATH;
+      states[goal] |= MapGrid::CELL_GOAL;
+      wavefront.setCells(&states[0], size, size, MapGrid::CELL_BLOCKED);
+      unsigned char sources[2] = {MapGrid::CELL_PATH, MapGrid::CELL_GOAL};
+      unsigned int* dists[2] = {&path_dist[0], &goal_dist[0]};
+      wavefront.computeDistances(sources, dists, 2, grid.size(), MapGrid::UNREACHED_DIST);
+      double t2 = wallMs();
+
+      t_bfs += t1 - t0;
+      t_wave += t2 - t1;
+    }
+
+    int reached = 0;
+    bool ok = grid.path_dist_ == path_dist && grid.goal_dist_ == goal_dist;
+    for(int i = 0; i < size * size; ++i)
+      reached += path_dist[i] < grid.size();
+    if(!ok)
+      printf("[MapGrid] %d x %d: the wavefront distances differ from the breadth first search\n", size, size);
+
+    printf("[MapGrid] %d x %d, %d cells reached: breadth first search %.3f ms  wavefront %.3f ms\n",
+        size, size, reached, t_bfs / reps, t_wave / reps);
+    return ok;
+  }
+};
+
+int main(int argc, char** argv){
+  int reps = 50; //distance computations timed
+  int density = 300; //obstacle blocks per 1000x1000 cells
+
+  if(argc > 1)
+    reps = atoi(argv[1]);
+  if(argc > 2)
+    density = atoi(argv[2]);
+
+  if(reps < 1 || density < 0){
+    printf("usage: %s [reps] [obstacle blocks per million cells]\n", argv[0]);
+    return 1;
+  }
+
+  srand(1);
+  bool ok = true;
+  int sizes[2] = {240, 600};
+  for(int s = 0; s < 2; ++s)
+    ok = benchGrid(sizes[s], reps, density * sizes[s] * sizes[s] / 1000000) && ok;
+
+  return ok ? 0 : 1;
+}
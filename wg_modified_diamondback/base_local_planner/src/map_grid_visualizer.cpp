@@ -32,7 +32,6 @@
  *  POSSIBILITY OF SUCH DAMAGE.
  *********************************************************************/
 #include <base_local_planner/map_grid_visualizer.h>
-#include <base_local_planner/map_cell.h>
 #include <vector>
 
 namespace base_local_planner {
@@ -31,18 +31,29 @@
  *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
  *  POSSIBILITY OF SUCH DAMAGE.
  *********************************************************************/
+#include <base_local_planner/motion_primitive.h>
+#include <math.h>
 
-#include <base_local_planner/map_cell.h>
+namespace base_local_planner {
+  MotionPrimitive::MotionPrimitive()
+    : xv_(0.0), yv_(0.0), thetav_(0.0)
+  {
+  }
 
-namespace base_local_planner{
+  MotionPrimitive::MotionPrimitive(double xv, double yv, double thetav)
+    : xv_(xv), yv_(yv), thetav_(thetav)
+  {
+  }
 
-  MapCell::MapCell()
-    : cx(0), cy(0), path_dist(DBL_MAX), goal_dist(DBL_MAX), occ_dist(0.0), occ_state(0), path_mark(false), goal_mark(false), within_robot(false)
-  {}
+  void MotionPrimitive::addPoint(double x, double y, double th){
+    x_pts_.push_back(x);
+    y_pts_.push_back(y);
+    th_pts_.push_back(th);
+    cos_pts_.push_back(cos(th));
+    sin_pts_.push_back(sin(th));
+  }
 
-  MapCell::MapCell(const MapCell& mc)
-    : cx(mc.cx), cy(mc.cy), path_dist(mc.path_dist), goal_dist(mc.goal_dist), 
-    occ_dist(mc.occ_dist), occ_state(mc.occ_state), path_mark(mc.path_mark), 
-    goal_mark(mc.goal_mark), within_robot(mc.within_robot)
-  {}
+  unsigned int MotionPrimitive::getPointsSize() const {
+    return x_pts_.size();
+  }
 };
@@ -0,0 +1,169 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2008, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#include <base_local_planner/swept_footprint.h>
+
+using namespace costmap_2d;
+
+namespace base_local_planner {
+  SweptFootprint::SweptFootprint(const Costmap2D& costmap)
+    : costmap_(costmap), char_map_(NULL), size_x_(0), stamp_(0)
+  {
+  }
+
+  void SweptFootprint::clear(){
+    //the costmap may have been resized since the last trajectory
+    unsigned int size = costmap_.getSizeInCellsX() * costmap_.getSizeInCellsY();
+    if(stamps_.size() != size){
+      stamps_.assign(size, 0);
+      stamp_ = 0;
+    }
+    char_map_ = costmap_.getCharMap();
+    size_x_ = costmap_.getSizeInCellsX();
+
+    //a new stamp marks every cell as uncovered, we only have to wipe the buffer when the stamps wrap around
+    ++stamp_;
+    if(stamp_ == 0){
+      std::fill(stamps_.begin(), stamps_.end(), 0);
+      stamp_ = 1;
+    }
+  }
+
+  double SweptFootprint::footprintCost(double x, double y, double cos_th, double sin_th,
+      const std::vector<geometry_msgs::Point>& footprint_spec){
+    //used to put things into grid coordinates
+    unsigned int cell_x, cell_y;
+
+    //get the cell coord of the center point of the robot
+    if(!costmap_.worldToMap(x, y, cell_x, cell_y))
+      return -1.0;
+
+    //if number of points in the footprint is less than 3, we'll just assume a circular robot
+    if(footprint_spec.size() < 3){
+      unsigned int index = cell_y * size_x_ + cell_x;
+      if(stamps_[index] == stamp_)
+        return 0.0;
+      stamps_[index] = stamp_;
+
+      unsigned char cost = char_map_[index];
+      if(cost == LETHAL_OBSTACLE || cost == INSCRIBED_INFLATED_OBSTACLE || cost == NO_INFORMATION)
+        return -1.0;
+      return cost;
+    }
+
+    //place the corners of the footprint in the grid
+    corner_x_.resize(footprint_spec.size());
+    corner_y_.resize(footprint_spec.size());
+    for(unsigned int i = 0; i < footprint_spec.size(); ++i){
+      double corner_x = x + (footprint_spec[i].x * cos_th - footprint_spec[i].y * sin_th);
+      double corner_y = y + (footprint_spec[i].x * sin_th + footprint_spec[i].y * cos_th);
+      if(!costmap_.worldToMap(corner_x, corner_y, corner_x_[i], corner_y_[i]))
+        return -1.0;
+    }
+
+    //rasterize each line in the footprint, including the one from the last point back to the first
+    double footprint_cost = 0.0;
+    unsigned int last = footprint_spec.size() - 1;
+    for(unsigned int i = 0; i < footprint_spec.size(); ++i){
+      unsigned int next = i == last ? 0 : i + 1;
+      double line_cost = lineCost(corner_x_[i], corner_x_[next], corner_y_[i], corner_y_[next]);
+
+      //if there is an obstacle that hits the line... we know that we can return false right away 
+      if(line_cost < 0)
+        return -1.0;
+
+      footprint_cost = std::max(line_cost, footprint_cost);
+    }
+
+    return footprint_cost;
+  }
+
+  //the same Bresenham ray-tracing as CostmapModel, but each cell is only looked at once per trajectory
+  double SweptFootprint::lineCost(int x0, int x1, int y0, int y1){
+    int deltax = abs(x1 - x0);
+    int deltay = abs(y1 - y0);
+    int x = x0;
+    int y = y0;
+
+    int xinc1, xinc2, yinc1, yinc2;
+    int den, num, numadd, numpixels;
+
+    double line_cost = 0.0;
+
+    xinc1 = xinc2 = x1 >= x0 ? 1 : -1;
+    yinc1 = yinc2 = y1 >= y0 ? 1 : -1;
+
+    if(deltax >= deltay){
+      xinc1 = 0;
+      yinc2 = 0;
+      den = deltax;
+      num = deltax / 2;
+      numadd = deltay;
+      numpixels = deltax;
+    }
+    else{
+      xinc2 = 0;
+      yinc1 = 0;
+      den = deltay;
+      num = deltay / 2;
+      numadd = deltax;
+      numpixels = deltay;
+    }
+
+    for(int curpixel = 0; curpixel <= numpixels; curpixel++){
+      unsigned int index = y * size_x_ + x;
+      if(stamps_[index] != stamp_){
+        stamps_[index] = stamp_;
+
+        //if the cell is in an obstacle the path is invalid
+        unsigned char cost = char_map_[index];
+        if(cost == LETHAL_OBSTACLE || cost == NO_INFORMATION)
+          return -1.0;
+
+        if(line_cost < cost)
+          line_cost = cost;
+      }
+
+      num += numadd;
+      if(num >= den){
+        num -= den;
+        x += xinc1;
+        y += yinc1;
+      }
+      x += xinc2;
+      y += yinc2;
+    }
+
+    return line_cost;
+  }
+};
@@ -32,49 +32,61 @@
  *  POSSIBILITY OF SUCH DAMAGE.
  *********************************************************************/
 #include <base_local_planner/trajectory.h>
+#include <algorithm>
 
 namespace base_local_planner {
   Trajectory::Trajectory()
-    : xv_(0.0), yv_(0.0), thetav_(0.0), cost_(-1.0)
+    : xv_(0.0), yv_(0.0), thetav_(0.0), cost_(-1.0), num_pts_(0)
   {
   }
 
   Trajectory::Trajectory(double xv, double yv, double thetav, unsigned int num_pts)
-    : xv_(xv), yv_(yv), thetav_(thetav), cost_(-1.0), x_pts_(num_pts), y_pts_(num_pts), th_pts_(num_pts)
+    : xv_(xv), yv_(yv), thetav_(thetav), cost_(-1.0), pts_(3 * num_pts), num_pts_(num_pts)
   {
   }
 
-  void Trajectory::getPoint(unsigned int index, double& x, double& y, double& th){
-    x = x_pts_[index];
-    y = y_pts_[index];
-    th = th_pts_[index];
+  void Trajectory::getPoint(unsigned int index, double& x, double& y, double& th) const {
+    const double* pt = &pts_[3 * index];
+    x = pt[0];
+    y = pt[1];
+    th = pt[2];
   }
 
   void Trajectory::setPoint(unsigned int index, double x, double y, double th){
-    x_pts_[index] = x;
-    y_pts_[index] = y;
-    th_pts_[index] = th;
+    double* pt = &pts_[3 * index];
+    pt[0] = x;
+    pt[1] = y;
+    pt[2] = th;
   }
 
   void Trajectory::addPoint(double x, double y, double th){
-    x_pts_.push_back(x);
-    y_pts_.push_back(y);
-    th_pts_.push_back(th);
+    //the buffer only grows when a trajectory is longer than any it held before
+    if(3 * (num_pts_ + 1) > pts_.size())
+      pts_.resize(3 * std::max(2 * num_pts_, num_pts_ + 1));
+    double* pt = &pts_[3 * num_pts_++];
+    pt[0] = x;
+    pt[1] = y;
+    pt[2] = th;
   }
 
   void Trajectory::resetPoints(){
-    x_pts_.clear();
-    y_pts_.clear();
-    th_pts_.clear();
+    num_pts_ = 0;
   }
 
-  void Trajectory::getEndpoint(double& x, double& y, double& th){
-    x = x_pts_.back();
-    y = y_pts_.back();
-    th = th_pts_.back();
+  void Trajectory::reservePoints(unsigned int num_pts){
+    if(3 * num_pts > pts_.size())
+      pts_.resize(3 * num_pts);
   }
 
-  unsigned int Trajectory::getPointsSize(){
-    return x_pts_.size();
+  void Trajectory::getEndpoint(double& x, double& y, double& th) const {
+    getPoint(num_pts_ - 1, x, y, th);
+  }
+
+  unsigned int Trajectory::getPointsSize() const {
+    return num_pts_;
+  }
+
+  const double* Trajectory::getPoints() const {
+    return pts_.empty() ? NULL : &pts_[0];
   }
 };
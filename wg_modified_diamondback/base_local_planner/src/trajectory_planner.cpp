@@ -36,6 +36,7 @@
 *********************************************************************/
 
 #include <base_local_planner/trajectory_planner.h>
+#include <base_local_planner/costmap_model.h>
 
 using namespace std;
 using namespace costmap_2d;
@@ -56,7 +57,11 @@ namespace base_local_planner{
       double max_vel_th, double min_vel_th, double min_in_place_vel_th,
       double backup_vel,
       bool dwa, bool heading_scoring, double heading_scoring_timestep, bool simple_attractor,
-      vector<double> y_vels, double stop_time_buffer, double sim_period, double angular_sim_granularity)
+      vector<double> y_vels, double stop_time_buffer, double sim_period, double angular_sim_granularity,
+      int rollout_threads,
+      bool motion_primitives, double primitive_vel_resolution,
+      double primitive_rot_resolution, int max_primitive_sets,
+      bool swept_footprint, bool bound_trajectories)
     : map_(costmap.getSizeInCellsX(), costmap.getSizeInCellsY()), costmap_(costmap), 
     world_model_(world_model), footprint_spec_(footprint_spec),
     inscribed_radius_(inscribed_radius), circumscribed_radius_(circumscribed_radius),
@@ -85,21 +90,232 @@ namespace base_local_planner{
 
     escaping_ = false;
 
+    //the calling thread scores its share of the trajectories too, so we only need to start the rest
+    num_rollouts_ = 0;
+    rollout_threads_ = std::max(rollout_threads, 1);
+    rollout_batch_ = 0;
+    rollout_pending_ = 0;
+    rollout_shutdown_ = false;
+    bound_trajectories_ = bound_trajectories;
+    for(unsigned int i = 1; i < rollout_threads_; ++i)
+      rollout_workers_.create_thread(boost::bind(&TrajectoryPlanner::rolloutThread, this, i));
+
+    motion_primitives_ = motion_primitives;
+    primitive_vel_resolution_ = primitive_vel_resolution;
+    primitive_rot_resolution_ = primitive_rot_resolution;
+    max_primitive_sets_ = std::max(max_primitive_sets, 1);
+    primitive_set_ = NULL;
+    primitive_cycle_ = 0;
+
+    grid_time_ = 0.0;
+    rollout_time_ = 0.0;
+    footprint_checks_ = 0;
+
+    //room for the points of the longest trajectory we can sample, so that scoring trajectories doesn't allocate memory
+    double max_vel = max(max(fabs(max_vel_x_), fabs(min_vel_x_)), fabs(backup_vel_));
+    double max_vel_y = 0.0;
+    for(unsigned int i = 0; i < y_vels_.size(); ++i)
+      max_vel_y = max(max_vel_y, fabs(y_vels_[i]));
+    double max_vel_theta = max(max(fabs(max_vel_th_), fabs(min_vel_th_)), fabs(min_in_place_vel_th_));
+    max_traj_points_ = getNumSteps(max_vel, max_vel_y, max_vel_theta);
+    traj_one.reservePoints(max_traj_points_);
+    check_traj_.reservePoints(max_traj_points_);
+
+    //the swept footprint reads the costmap the way a CostmapModel does, any other world model has to check footprints itself
+    if(swept_footprint && dynamic_cast<CostmapModel*>(&world_model_) == NULL){
+      ROS_WARN("Swept footprints can only stand in for a CostmapModel world model, checking footprints with the world model instead");
+      swept_footprint = false;
+    }
+
+    //the stamp buffers can't be shared, so every thread that scores trajectories gets its own
+    if(swept_footprint){
+      for(unsigned int i = 0; i < rollout_threads_; ++i)
+        swept_footprints_.push_back(new SweptFootprint(costmap_));
+    }
+
+  }
+
+  TrajectoryPlanner::~TrajectoryPlanner(){
+    {
+      boost::mutex::scoped_lock lock(rollout_mutex_);
+      rollout_shutdown_ = true;
+      rollout_cond_.notify_all();
+    }
+    rollout_workers_.join_all();
+
+    for(unsigned int i = 0; i < swept_footprints_.size(); ++i)
+      delete swept_footprints_[i];
+  }
+
+  SweptFootprint* TrajectoryPlanner::getSweptFootprint(unsigned int id){
+    if(swept_footprints_.empty())
+      return NULL;
+    return swept_footprints_[id];
+  }
+
+  void TrajectoryPlanner::addRollout(double vx_samp, double vy_samp, double vtheta_samp){
+    //reuse the trajectories from previous cycles so that their points don't have to be reallocated
+    if(num_rollouts_ == rollouts_.size()){
+      rollouts_.push_back(Trajectory());
+      rollouts_.back().reservePoints(max_traj_points_);
+      rollout_bounds_.push_back(CostBound());
+      rollout_primitives_.push_back(NULL);
+    }
+
+    Trajectory& traj = rollouts_[num_rollouts_++];
+    traj.xv_ = vx_samp;
+    traj.yv_ = vy_samp;
+    traj.thetav_ = vtheta_samp;
+    traj.cost_ = -1.0;
   }
 
-  TrajectoryPlanner::~TrajectoryPlanner(){}
+  void TrajectoryPlanner::scoreRollouts(double x, double y, double theta, double vx, double vy, double vtheta,
+      double acc_x, double acc_y, double acc_theta, double impossible_cost, unsigned int begin, unsigned int end,
+      double max_cost, bool find_min){
+    rollout_state_.x = x;
+    rollout_state_.y = y;
+    rollout_state_.theta = theta;
+    rollout_state_.vx = vx;
+    rollout_state_.vy = vy;
+    rollout_state_.vtheta = vtheta;
+    rollout_state_.acc_x = acc_x;
+    rollout_state_.acc_y = acc_y;
+    rollout_state_.acc_theta = acc_theta;
+    rollout_state_.impossible_cost = impossible_cost;
+
+    //with heading scoring the cost doesn't come from the endpoint, so there's nothing to bound it with
+    rollout_state_.bounded = bound_trajectories_ && !heading_scoring_ && (max_cost >= 0 || find_min);
+    rollout_max_cost_ = max_cost;
+    rollout_max_index_ = end;
+    rollout_find_min_ = find_min;
+
+    rollout_order_.clear();
+    for(unsigned int i = begin; i < end; ++i){
+      //missing primitives are computed here, since the rollout threads can't safely add to the library
+      Trajectory& traj = rollouts_[i];
+      rollout_primitives_[i] = getPrimitive(traj.xv_, traj.yv_, traj.thetav_);
+
+      if(!rollout_state_.bounded){
+        rollout_order_.push_back(std::make_pair(0.0, i));
+        continue;
+      }
+
+      //where a trajectory ends is cheap to find, and gives everything but the occupancy part of its cost
+      CostBound& bound = rollout_bounds_[i];
+      if(!getEndpointDistances(x, y, theta, vx, vy, vtheta, traj.xv_, traj.yv_, traj.thetav_,
+            acc_x, acc_y, acc_theta, bound.path_dist, bound.goal_dist, rollout_primitives_[i])){
+        traj.resetPoints();
+        traj.cost_ = -1.0;
+        continue;
+      }
+
+      //a trajectory that ends without a clear path to the goal is invalid
+      if(!simple_attractor_ && (impossible_cost <= bound.goal_dist || impossible_cost <= bound.path_dist)){
+        traj.resetPoints();
+        traj.cost_ = -2.0;
+        continue;
+      }
+
+      rollout_order_.push_back(std::make_pair(pdist_scale_ * bound.path_dist + bound.goal_dist * gdist_scale_, i));
+    }
+
+    //the most promising trajectories go first, so that the bound gets tight early
+    if(rollout_state_.bounded)
+      std::sort(rollout_order_.begin(), rollout_order_.end());
+
+    //there's no point in waking the other threads for a handful of samples
+    if(rollout_threads_ == 1 || rollout_order_.size() < 2 * rollout_threads_){
+      scoreRolloutShare(0, 1);
+      return;
+    }
+
+    {
+      boost::mutex::scoped_lock lock(rollout_mutex_);
+      ++rollout_batch_;
+      rollout_pending_ = rollout_threads_ - 1;
+      rollout_cond_.notify_all();
+    }
+
+    scoreRolloutShare(0, rollout_threads_);
+
+    boost::mutex::scoped_lock lock(rollout_mutex_);
+    while(rollout_pending_ > 0)
+      rollout_done_cond_.wait(lock);
+  }
+
+  void TrajectoryPlanner::scoreRolloutShare(unsigned int id, unsigned int num_shares){
+    const RolloutState& s = rollout_state_;
+    SweptFootprint* swept = getSweptFootprint(id);
+    unsigned int footprint_checks = 0;
+
+    //each thread takes every n-th sample, so the slow and fast kinds of trajectories are spread evenly
+    for(unsigned int k = id; k < rollout_order_.size(); k += num_shares){
+      unsigned int i = rollout_order_[k].second;
+      Trajectory& traj = rollouts_[i];
+
+      if(!s.bounded){
+        generateTrajectory(s.x, s.y, s.theta, s.vx, s.vy, s.vtheta, traj.xv_, traj.yv_, traj.thetav_,
+            s.acc_x, s.acc_y, s.acc_theta, s.impossible_cost, traj, NULL, rollout_primitives_[i], swept, &footprint_checks);
+        continue;
+      }
+
+      CostBound& bound = rollout_bounds_[i];
+      {
+        boost::mutex::scoped_lock lock(rollout_mutex_);
+        bound.max_cost = rollout_max_cost_;
+        bound.ties_lose = rollout_max_index_ < i;
+      }
+
+      generateTrajectory(s.x, s.y, s.theta, s.vx, s.vy, s.vtheta, traj.xv_, traj.yv_, traj.thetav_,
+          s.acc_x, s.acc_y, s.acc_theta, s.impossible_cost, traj, &bound, rollout_primitives_[i], swept, &footprint_checks);
+
+      //a legal trajectory tightens the bound for the ones scored after it
+      if(rollout_find_min_ && traj.cost_ >= 0){
+        boost::mutex::scoped_lock lock(rollout_mutex_);
+        if(rollout_max_cost_ < 0 || traj.cost_ < rollout_max_cost_ 
+            || (traj.cost_ == rollout_max_cost_ && i < rollout_max_index_)){
+          rollout_max_cost_ = traj.cost_;
+          rollout_max_index_ = i;
+        }
+      }
+    }
+
+    boost::mutex::scoped_lock lock(rollout_mutex_);
+    footprint_checks_ += footprint_checks;
+  }
+
+  void TrajectoryPlanner::rolloutThread(unsigned int id){
+    unsigned int batch = 0;
+    boost::mutex::scoped_lock lock(rollout_mutex_);
+    while(true){
+      while(rollout_batch_ == batch && !rollout_shutdown_)
+        rollout_cond_.wait(lock);
+
+      if(rollout_shutdown_)
+        return;
+
+      batch = rollout_batch_;
+      lock.unlock();
+      scoreRolloutShare(id, rollout_threads_);
+      lock.lock();
+
+      if(--rollout_pending_ == 0)
+        rollout_done_cond_.notify_one();
+    }
+  }
 
   bool TrajectoryPlanner::getCellCosts(int cx, int cy, float &path_cost, float &goal_cost, float &occ_cost, float &total_cost) {
-    MapCell cell = map_(cx, cy);
-    if (cell.within_robot) {
+    if (map_.isWithinRobot(cx, cy)) {
         return false;
     }
     occ_cost = costmap_.getCost(cx, cy);
-    if (cell.path_dist >= map_.map_.size() || cell.goal_dist >= map_.map_.size() || occ_cost >= costmap_2d::INSCRIBED_INFLATED_OBSTACLE) {
+    double path_dist = map_.getPathDist(cx, cy);
+    double goal_dist = map_.getGoalDist(cx, cy);
+    if (path_dist >= map_.size() || goal_dist >= map_.size() || occ_cost >= costmap_2d::INSCRIBED_INFLATED_OBSTACLE) {
         return false;
     }
-    path_cost = cell.path_dist;
-    goal_cost = cell.goal_dist;
+    path_cost = path_dist;
+    goal_cost = goal_dist;
     total_cost = pdist_scale_ * path_cost + gdist_scale_ * goal_cost + occdist_scale_ * occ_cost;
     return true;
   }
@@ -108,7 +324,8 @@ namespace base_local_planner{
   void TrajectoryPlanner::generateTrajectory(double x, double y, double theta, double vx, double vy, 
       double vtheta, double vx_samp, double vy_samp, double vtheta_samp, 
       double acc_x, double acc_y, double acc_theta, double impossible_cost,
-      Trajectory& traj){
+      Trajectory& traj, const CostBound* bound, const MotionPrimitive* primitive, SweptFootprint* swept,
+      unsigned int* footprint_checks){
     double x_i = x;
     double y_i = y;
     double theta_i = theta;
@@ -119,21 +336,16 @@ namespace base_local_planner{
     vy_i = vy;
     vtheta_i = vtheta;
 
-    //compute the magnitude of the velocities
-    double vmag = sqrt(vx_samp * vx_samp + vy_samp * vy_samp);
-
-    //compute the number of steps we must take along this trajectory to be "safe"
-    int num_steps;
-    if(!heading_scoring_)
-      num_steps = int(max((vmag * sim_time_) / sim_granularity_, fabs(vtheta_samp) / angular_sim_granularity_) + 0.5);
-    else
-      num_steps = int(sim_time_ / sim_granularity_ + 0.5);
+    int num_steps = primitive != NULL ? primitive->getPointsSize() : getNumSteps(vx_samp, vy_samp, vtheta_samp);
+    double dt = sim_time_ / num_steps;
 
-    //we at least want to take one step... even if we won't move, we want to score our current position
-    if(num_steps == 0)
-      num_steps = 1;
+    //a primitive only needs to be rotated into place, its poses already carry their own sines and cosines
+    double cos_th = 0.0, sin_th = 0.0, cos_th_i = 0.0, sin_th_i = 0.0;
+    if(primitive != NULL){
+      cos_th = cos(theta);
+      sin_th = sin(theta);
+    }
 
-    double dt = sim_time_ / num_steps;
     double time = 0.0;
 
     //create a potential trajectory
@@ -143,6 +355,10 @@ namespace base_local_planner{
     traj.thetav_ = vtheta_samp;
     traj.cost_ = -1.0;
 
+    //none of the cells have been covered by this trajectory yet
+    if(swept != NULL)
+      swept->clear();
+
     //initialize the costs for the trajectory
     double path_dist = 0.0;
     double goal_dist = 0.0;
@@ -150,6 +366,9 @@ namespace base_local_planner{
     double heading_diff = 0.0;
 
     for(int i = 0; i < num_steps; ++i){
+      if(primitive != NULL)
+        primitive->getPose(i, x, y, theta, cos_th, sin_th, x_i, y_i, theta_i, cos_th_i, sin_th_i);
+
       //get map coordinates of a point
       unsigned int cell_x, cell_y;
 
@@ -159,8 +378,24 @@ namespace base_local_planner{
         return;
       }
 
+      //if even the occupancy cost we've seen so far keeps us from beating the bound, there's no point in checking further
+      if(bound != NULL && bound->max_cost >= 0){
+        double min_cost = pdist_scale_ * bound->path_dist + bound->goal_dist * gdist_scale_ + occdist_scale_ * occ_cost;
+        if(min_cost > bound->max_cost || (bound->ties_lose && min_cost == bound->max_cost)){
+          traj.cost_ = -3.0;
+          return;
+        }
+      }
+
       //check the point on the trajectory for legality
-      double footprint_cost = footprintCost(x_i, y_i, theta_i);
+      if(primitive == NULL){
+        cos_th_i = cos(theta_i);
+        sin_th_i = sin(theta_i);
+      }
+      if(footprint_checks != NULL)
+        ++*footprint_checks;
+      double footprint_cost = swept != NULL ? swept->footprintCost(x_i, y_i, cos_th_i, sin_th_i, footprint_spec_)
+        : footprintCost(x_i, y_i, cos_th_i, sin_th_i);
 
       //if the footprint hits an obstacle this trajectory is invalid
       if(footprint_cost < 0){
@@ -191,8 +426,8 @@ namespace base_local_planner{
 
       occ_cost = std::max(std::max(occ_cost, footprint_cost), double(costmap_.getCost(cell_x, cell_y)));
 
-      double cell_pdist = map_(cell_x, cell_y).path_dist;
-      double cell_gdist = map_(cell_x, cell_y).goal_dist;
+      double cell_pdist = map_.getPathDist(cell_x, cell_y);
+      double cell_gdist = map_.getGoalDist(cell_x, cell_y);
 
       //update path and goal distances
       if(!heading_scoring_){
@@ -228,15 +463,17 @@ namespace base_local_planner{
       //the point is legal... add it to the trajectory
       traj.addPoint(x_i, y_i, theta_i);
 
-      //calculate velocities
-      vx_i = computeNewVelocity(vx_samp, vx_i, acc_x, dt);
-      vy_i = computeNewVelocity(vy_samp, vy_i, acc_y, dt);
-      vtheta_i = computeNewVelocity(vtheta_samp, vtheta_i, acc_theta, dt);
+      if(primitive == NULL){
+        //calculate velocities
+        vx_i = computeNewVelocity(vx_samp, vx_i, acc_x, dt);
+        vy_i = computeNewVelocity(vy_samp, vy_i, acc_y, dt);
+        vtheta_i = computeNewVelocity(vtheta_samp, vtheta_i, acc_theta, dt);
 
-      //calculate positions
-      x_i = computeNewXPosition(x_i, vx_i, vy_i, theta_i, dt);
-      y_i = computeNewYPosition(y_i, vx_i, vy_i, theta_i, dt);
-      theta_i = computeNewThetaPosition(theta_i, vtheta_i, dt);
+        //calculate positions
+        x_i = computeNewXPosition(x_i, vx_i, vy_i, theta_i, dt);
+        y_i = computeNewYPosition(y_i, vx_i, vy_i, theta_i, dt);
+        theta_i = computeNewThetaPosition(theta_i, vtheta_i, dt);
+      }
 
       //increment time
       time += dt;
@@ -252,6 +489,150 @@ namespace base_local_planner{
     traj.cost_ = cost;
   }
 
+  int TrajectoryPlanner::getNumSteps(double vx_samp, double vy_samp, double vtheta_samp){
+    //compute the magnitude of the velocities
+    double vmag = sqrt(vx_samp * vx_samp + vy_samp * vy_samp);
+
+    //compute the number of steps we must take along this trajectory to be "safe"
+    int num_steps;
+    if(!heading_scoring_)
+      num_steps = int(max((vmag * sim_time_) / sim_granularity_, fabs(vtheta_samp) / angular_sim_granularity_) + 0.5);
+    else
+      num_steps = int(sim_time_ / sim_granularity_ + 0.5);
+
+    //we at least want to take one step... even if we won't move, we want to score our current position
+    if(num_steps == 0)
+      num_steps = 1;
+
+    return num_steps;
+  }
+
+  //follow a trajectory the same way generateTrajectory does, but only look at the cell it's scored by
+  bool TrajectoryPlanner::getEndpointDistances(double x, double y, double theta, double vx, double vy, 
+      double vtheta, double vx_samp, double vy_samp, double vtheta_samp, 
+      double acc_x, double acc_y, double acc_theta, double& path_dist, double& goal_dist,
+      const MotionPrimitive* primitive){
+    double x_i = x;
+    double y_i = y;
+    double theta_i = theta;
+
+    double vx_i = vx;
+    double vy_i = vy;
+    double vtheta_i = vtheta;
+
+    int num_steps = getNumSteps(vx_samp, vy_samp, vtheta_samp);
+    double dt = sim_time_ / num_steps;
+
+    //the last point scored is the last pose of the primitive
+    if(primitive != NULL){
+      double cos_th_i, sin_th_i;
+      primitive->getPose(primitive->getPointsSize() - 1, x, y, theta, cos(theta), sin(theta),
+          x_i, y_i, theta_i, cos_th_i, sin_th_i);
+      num_steps = 1;
+    }
+
+    //the last point scored is the one before the final step
+    for(int i = 0; i < num_steps - 1; ++i){
+      //calculate velocities
+      vx_i = computeNewVelocity(vx_samp, vx_i, acc_x, dt);
+      vy_i = computeNewVelocity(vy_samp, vy_i, acc_y, dt);
+      vtheta_i = computeNewVelocity(vtheta_samp, vtheta_i, acc_theta, dt);
+
+      //calculate positions
+      x_i = computeNewXPosition(x_i, vx_i, vy_i, theta_i, dt);
+      y_i = computeNewYPosition(y_i, vx_i, vy_i, theta_i, dt);
+      theta_i = computeNewThetaPosition(theta_i, vtheta_i, dt);
+    }
+
+    unsigned int cell_x, cell_y;
+    if(!costmap_.worldToMap(x_i, y_i, cell_x, cell_y))
+      return false;
+
+    if(simple_attractor_){
+      goal_dist = (x_i - global_plan_[global_plan_.size() -1].pose.position.x) * 
+        (x_i - global_plan_[global_plan_.size() -1].pose.position.x) + 
+        (y_i - global_plan_[global_plan_.size() -1].pose.position.y) * 
+        (y_i - global_plan_[global_plan_.size() -1].pose.position.y);
+      path_dist = 0.0;
+    }
+    else{
+      path_dist = map_.getPathDist(cell_x, cell_y);
+      goal_dist = map_.getGoalDist(cell_x, cell_y);
+    }
+    return true;
+  }
+
+  void TrajectoryPlanner::selectPrimitiveSet(double& vx, double& vy, double& vtheta){
+    VelocityKey key(int(floor(vx / primitive_vel_resolution_ + 0.5)),
+        std::make_pair(int(floor(vy / primitive_vel_resolution_ + 0.5)), int(floor(vtheta / primitive_rot_resolution_ + 0.5))));
+    vx = key.first * primitive_vel_resolution_;
+    vy = key.second.first * primitive_vel_resolution_;
+    vtheta = key.second.second * primitive_rot_resolution_;
+
+    ++primitive_cycle_;
+    std::map<VelocityKey, PrimitiveSet>::iterator it = primitive_sets_.find(key);
+    if(it == primitive_sets_.end()){
+      //make room by dropping the primitives that went unused the longest
+      if(primitive_sets_.size() >= max_primitive_sets_){
+        std::map<VelocityKey, PrimitiveSet>::iterator oldest = primitive_sets_.begin();
+        for(std::map<VelocityKey, PrimitiveSet>::iterator set = primitive_sets_.begin(); set != primitive_sets_.end(); ++set){
+          if(set->second.last_used < oldest->second.last_used)
+            oldest = set;
+        }
+        primitive_sets_.erase(oldest);
+      }
+
+      it = primitive_sets_.insert(std::make_pair(key, PrimitiveSet())).first;
+      it->second.vx = vx;
+      it->second.vy = vy;
+      it->second.vtheta = vtheta;
+    }
+
+    it->second.last_used = primitive_cycle_;
+    primitive_set_ = &it->second;
+  }
+
+  const MotionPrimitive* TrajectoryPlanner::getPrimitive(double vx_samp, double vy_samp, double vtheta_samp){
+    if(!motion_primitives_ || primitive_set_ == NULL)
+      return NULL;
+
+    VelocitySample sample(vx_samp, std::make_pair(vy_samp, vtheta_samp));
+    std::map<VelocitySample, MotionPrimitive>::iterator it = primitive_set_->primitives.find(sample);
+    if(it != primitive_set_->primitives.end())
+      return &it->second;
+
+    //simulate the trajectory from the origin, the same way generateTrajectory does
+    MotionPrimitive& primitive = primitive_set_->primitives[sample];
+    primitive = MotionPrimitive(vx_samp, vy_samp, vtheta_samp);
+
+    double x_i = 0.0;
+    double y_i = 0.0;
+    double theta_i = 0.0;
+
+    double vx_i = primitive_set_->vx;
+    double vy_i = primitive_set_->vy;
+    double vtheta_i = primitive_set_->vtheta;
+
+    int num_steps = getNumSteps(vx_samp, vy_samp, vtheta_samp);
+    double dt = sim_time_ / num_steps;
+
+    for(int i = 0; i < num_steps; ++i){
+      primitive.addPoint(x_i, y_i, theta_i);
+
+      //calculate velocities
+      vx_i = computeNewVelocity(vx_samp, vx_i, acc_lim_x_, dt);
+      vy_i = computeNewVelocity(vy_samp, vy_i, acc_lim_y_, dt);
+      vtheta_i = computeNewVelocity(vtheta_samp, vtheta_i, acc_lim_theta_, dt);
+
+      //calculate positions
+      x_i = computeNewXPosition(x_i, vx_i, vy_i, theta_i, dt);
+      y_i = computeNewYPosition(y_i, vx_i, vy_i, theta_i, dt);
+      theta_i = computeNewThetaPosition(theta_i, vtheta_i, dt);
+    }
+
+    return &primitive;
+  }
+
   double TrajectoryPlanner::headingDiff(int cell_x, int cell_y, double x, double y, double heading){
     double heading_diff = DBL_MAX;
     unsigned int goal_cell_x, goal_cell_y;
@@ -389,8 +770,6 @@ namespace base_local_planner{
 
   bool TrajectoryPlanner::checkTrajectory(double x, double y, double theta, double vx, double vy, 
       double vtheta, double vx_samp, double vy_samp, double vtheta_samp){
-    Trajectory t; 
-
     double cost = scoreTrajectory(x, y, theta, vx, vy, vtheta, vx_samp, vy_samp, vtheta_samp);
 
     //if the trajectory is a legal one... the check passes
@@ -403,19 +782,22 @@ namespace base_local_planner{
 
   double TrajectoryPlanner::scoreTrajectory(double x, double y, double theta, double vx, double vy, 
       double vtheta, double vx_samp, double vy_samp, double vtheta_samp){
-    Trajectory t; 
-    double impossible_cost = map_.map_.size();
+    double impossible_cost = map_.size();
     generateTrajectory(x, y, theta, vx, vy, vtheta, vx_samp, vy_samp, vtheta_samp, 
-        acc_lim_x_, acc_lim_y_, acc_lim_theta_, impossible_cost, t);
+        acc_lim_x_, acc_lim_y_, acc_lim_theta_, impossible_cost, check_traj_, NULL, NULL, getSweptFootprint(0));
 
     // return the cost.
-    return double( t.cost_ );
+    return double( check_traj_.cost_ );
   }
 
   //create the trajectories we wish to score
-  Trajectory TrajectoryPlanner::createTrajectories(double x, double y, double theta, 
+  const Trajectory& TrajectoryPlanner::createTrajectories(double x, double y, double theta, 
       double vx, double vy, double vtheta,
       double acc_x, double acc_y, double acc_theta){
+    //with motion primitives we plan from the nearest velocity on the lattice, so the same primitives come up cycle after cycle
+    if(motion_primitives_)
+      selectPrimitiveSet(vx, vy, vtheta);
+
     //compute feasible velocity limits in robot space
     double max_vel_x, max_vel_theta;
     double min_vel_x, min_vel_theta;
@@ -449,42 +831,26 @@ namespace base_local_planner{
     Trajectory* best_traj = &traj_one;
     best_traj->cost_ = -1.0;
 
-    Trajectory* comp_traj = &traj_two;
-    comp_traj->cost_ = -1.0;
-
-    Trajectory* swap = NULL;
+    Trajectory* comp_traj = NULL;
 
     //any cell with a cost greater than the size of the map is impossible
-    double impossible_cost = map_.map_.size();
+    double impossible_cost = map_.size();
+
+    //lay out all the samples before rolling any of them out... they're compared in this order below
+    num_rollouts_ = 0;
+    footprint_checks_ = 0;
 
     //if we're performing an escape we won't allow moving forward
     if(!escaping_){
       //loop through all x velocities
       for(int i = 0; i < vx_samples_; ++i){
-        vtheta_samp = 0;
         //first sample the straight trajectory
-        generateTrajectory(x, y, theta, vx, vy, vtheta, vx_samp, vy_samp, vtheta_samp, 
-            acc_x, acc_y, acc_theta, impossible_cost, *comp_traj);
-
-        //if the new trajectory is better... let's take it
-        if(comp_traj->cost_ >= 0 && (comp_traj->cost_ < best_traj->cost_ || best_traj->cost_ < 0)){
-          swap = best_traj;
-          best_traj = comp_traj;
-          comp_traj = swap;
-        }
+        addRollout(vx_samp, vy_samp, 0);
 
         vtheta_samp = min_vel_theta;
         //next sample all theta trajectories
         for(int j = 0; j < vtheta_samples_ - 1; ++j){
-          generateTrajectory(x, y, theta, vx, vy, vtheta, vx_samp, vy_samp, vtheta_samp, 
-              acc_x, acc_y, acc_theta, impossible_cost, *comp_traj);
-
-          //if the new trajectory is better... let's take it
-          if(comp_traj->cost_ >= 0 && (comp_traj->cost_ < best_traj->cost_ || best_traj->cost_ < 0)){
-            swap = best_traj;
-            best_traj = comp_traj;
-            comp_traj = swap;
-          }
+          addRollout(vx_samp, vy_samp, vtheta_samp);
           vtheta_samp += dvtheta;
         }
         vx_samp += dvx;
@@ -493,49 +859,46 @@ namespace base_local_planner{
       //only explore y velocities with holonomic robots
       if(holonomic_robot_){
         //explore trajectories that move forward but also strafe slightly
-        vx_samp = 0.1;
-        vy_samp = 0.1;
-        vtheta_samp = 0.0;
-        generateTrajectory(x, y, theta, vx, vy, vtheta, vx_samp, vy_samp, vtheta_samp, 
-            acc_x, acc_y, acc_theta, impossible_cost, *comp_traj);
+        addRollout(0.1, 0.1, 0.0);
+        addRollout(0.1, -0.1, 0.0);
+      }
+    }
+    unsigned int num_forward = num_rollouts_;
 
-        //if the new trajectory is better... let's take it
-        if(comp_traj->cost_ >= 0 && (comp_traj->cost_ < best_traj->cost_ || best_traj->cost_ < 0)){
-          swap = best_traj;
-          best_traj = comp_traj;
-          comp_traj = swap;
-        }
+    //next we want to generate trajectories for rotating in place
+    vtheta_samp = min_vel_theta;
+    for(int i = 0; i < vtheta_samples_; ++i){
+      //enforce a minimum rotational velocity because the base can't handle small in-place rotations
+      double vtheta_samp_limited = vtheta_samp > 0 ? max(vtheta_samp, min_in_place_vel_th_) 
+        : min(vtheta_samp, -1.0 * min_in_place_vel_th_);
+      addRollout(0.0, 0.0, vtheta_samp_limited);
+      vtheta_samp += dvtheta;
+    }
 
-        vx_samp = 0.1;
-        vy_samp = -0.1;
-        vtheta_samp = 0.0;
-        generateTrajectory(x, y, theta, vx, vy, vtheta, vx_samp, vy_samp, vtheta_samp, 
-            acc_x, acc_y, acc_theta, impossible_cost, *comp_traj);
+    //the forward trajectories are a straight search for the lowest cost one
+    scoreRollouts(x, y, theta, vx, vy, vtheta, acc_x, acc_y, acc_theta, impossible_cost, 0, num_forward, -1.0, true);
 
-        //if the new trajectory is better... let's take it
-        if(comp_traj->cost_ >= 0 && (comp_traj->cost_ < best_traj->cost_ || best_traj->cost_ < 0)){
-          swap = best_traj;
-          best_traj = comp_traj;
-          comp_traj = swap;
-        }
+    for(unsigned int i = 0; i < num_forward; ++i){
+      comp_traj = &rollouts_[i];
+
+      //if the new trajectory is better... let's take it
+      if(comp_traj->cost_ >= 0 && (comp_traj->cost_ < best_traj->cost_ || best_traj->cost_ < 0)){
+        best_traj = comp_traj;
       }
     }
 
-    //next we want to generate trajectories for rotating in place
-    vtheta_samp = min_vel_theta;
-    vx_samp = 0.0;
-    vy_samp = 0.0;
+    //rotating in place only has to match the best of them, unless that one strafes
+    double max_cost = -1.0;
+    if(best_traj->cost_ >= 0 && best_traj->yv_ == 0.0)
+      max_cost = best_traj->cost_;
+    scoreRollouts(x, y, theta, vx, vy, vtheta, acc_x, acc_y, acc_theta, impossible_cost, num_forward, num_rollouts_, max_cost);
 
     //let's try to rotate toward open space
     double heading_dist = DBL_MAX;
 
+    vtheta_samp = min_vel_theta;
     for(int i = 0; i < vtheta_samples_; ++i){
-      //enforce a minimum rotational velocity because the base can't handle small in-place rotations
-      double vtheta_samp_limited = vtheta_samp > 0 ? max(vtheta_samp, min_in_place_vel_th_) 
-        : min(vtheta_samp, -1.0 * min_in_place_vel_th_);
-
-      generateTrajectory(x, y, theta, vx, vy, vtheta, vx_samp, vy_samp, vtheta_samp_limited, 
-          acc_x, acc_y, acc_theta, impossible_cost, *comp_traj);
+      comp_traj = &rollouts_[num_forward + i];
 
       //if the new trajectory is better... let's take it... 
       //note if we can legally rotate in place we prefer to do that rather than move with y velocity
@@ -550,20 +913,16 @@ namespace base_local_planner{
 
         //make sure that we'll be looking at a legal cell
         if(costmap_.worldToMap(x_r, y_r, cell_x, cell_y)){
-          double ahead_gdist = map_(cell_x, cell_y).goal_dist;
+          double ahead_gdist = map_.getGoalDist(cell_x, cell_y);
           if(ahead_gdist < heading_dist){
             //if we haven't already tried rotating left since we've moved forward
             if(vtheta_samp < 0 && !stuck_left){
-              swap = best_traj;
               best_traj = comp_traj;
-              comp_traj = swap;
               heading_dist = ahead_gdist;
             }
             //if we haven't already tried rotating right since we've moved forward
             else if(vtheta_samp > 0 && !stuck_right){
-              swap = best_traj;
               best_traj = comp_traj;
-              comp_traj = swap;
               heading_dist = ahead_gdist;
             }
           }
@@ -631,16 +990,21 @@ namespace base_local_planner{
     //only explore y velocities with holonomic robots
     if(holonomic_robot_){
       //if we can't rotate in place or move forward... maybe we can move sideways and rotate
-      vtheta_samp = min_vel_theta;
+      //nothing is legal so far, so best_traj doesn't point into the rollouts we're adding
+      unsigned int num_rotate = num_rollouts_;
       vx_samp = 0.0;
 
       //loop through all y velocities
       for(unsigned int i = 0; i < y_vels_.size(); ++i){
-        vtheta_samp = 0;
-        vy_samp = y_vels_[i];
         //sample completely horizontal trajectories
-        generateTrajectory(x, y, theta, vx, vy, vtheta, vx_samp, vy_samp, vtheta_samp, 
-            acc_x, acc_y, acc_theta, impossible_cost, *comp_traj);
+        addRollout(vx_samp, y_vels_[i], 0);
+      }
+
+      scoreRollouts(x, y, theta, vx, vy, vtheta, acc_x, acc_y, acc_theta, impossible_cost, num_rotate, num_rollouts_);
+
+      for(unsigned int i = 0; i < y_vels_.size(); ++i){
+        vy_samp = y_vels_[i];
+        comp_traj = &rollouts_[num_rotate + i];
 
         //if the new trajectory is better... let's take it
         if(comp_traj->cost_ >= 0 && (comp_traj->cost_ <= best_traj->cost_ || best_traj->cost_ < 0)){
@@ -652,20 +1016,16 @@ namespace base_local_planner{
 
           //make sure that we'll be looking at a legal cell
           if(costmap_.worldToMap(x_r, y_r, cell_x, cell_y)){
-            double ahead_gdist = map_(cell_x, cell_y).goal_dist;
+            double ahead_gdist = map_.getGoalDist(cell_x, cell_y);
             if(ahead_gdist < heading_dist){
               //if we haven't already tried strafing left since we've moved forward
               if(vy_samp > 0 && !stuck_left_strafe){
-                swap = best_traj;
                 best_traj = comp_traj;
-                comp_traj = swap;
                 heading_dist = ahead_gdist;
               }
               //if we haven't already tried rotating right since we've moved forward
               else if(vy_samp < 0 && !stuck_right_strafe){
-                swap = best_traj;
                 best_traj = comp_traj;
-                comp_traj = swap;
                 heading_dist = ahead_gdist;
               }
             }
@@ -732,22 +1092,20 @@ namespace base_local_planner{
     vtheta_samp = 0.0;
     vx_samp = backup_vel_;
     vy_samp = 0.0;
+    comp_traj = &traj_one;
     generateTrajectory(x, y, theta, vx, vy, vtheta, vx_samp, vy_samp, vtheta_samp, 
-        acc_x, acc_y, acc_theta, impossible_cost, *comp_traj);
+        acc_x, acc_y, acc_theta, impossible_cost, *comp_traj, NULL, getPrimitive(vx_samp, vy_samp, vtheta_samp),
+        getSweptFootprint(0), &footprint_checks_);
 
     //if the new trajectory is better... let's take it
     /*
        if(comp_traj->cost_ >= 0 && (comp_traj->cost_ < best_traj->cost_ || best_traj->cost_ < 0)){
-       swap = best_traj;
        best_traj = comp_traj;
-       comp_traj = swap;
        }
        */
 
     //we'll allow moving backwards slowly even when the static map shows it as blocked
-    swap = best_traj;
     best_traj = comp_traj;
-    comp_traj = swap;
     
     double dist = sqrt((x - prev_x_) * (x - prev_x_) + (y - prev_y_) * (y - prev_y_));
     if(dist > oscillation_reset_dist_){
@@ -785,7 +1143,7 @@ namespace base_local_planner{
   }
 
   //given the current state of the robot, find a good trajectory
-  Trajectory TrajectoryPlanner::findBestPath(tf::Stamped<tf::Pose> global_pose, tf::Stamped<tf::Pose> global_vel, 
+  const Trajectory& TrajectoryPlanner::findBestPath(tf::Stamped<tf::Pose> global_pose, tf::Stamped<tf::Pose> global_vel, 
       tf::Stamped<tf::Pose>& drive_velocities){
 
     double yaw = tf::getYaw(global_pose.getRotation());
@@ -799,27 +1157,26 @@ namespace base_local_planner{
     double vy = global_vel.getOrigin().getY();
     double vtheta = vel_yaw;
 
-    //reset the map for new operations
-    map_.resetPathDist();
+    ros::WallTime start_time = ros::WallTime::now();
 
     //temporarily remove obstacles that are within the footprint of the robot
     vector<base_local_planner::Position2DInt> footprint_list = getFootprintCells(x, y, theta, true);
 
-    //mark cells within the initial footprint of the robot
-    for(unsigned int i = 0; i < footprint_list.size(); ++i){
-      map_(footprint_list[i].x, footprint_list[i].y).within_robot = true;
-    }
-
-    //make sure that we update our path based on the global plan and compute costs
-    map_.setPathCells(costmap_, global_plan_);
+    //make sure that we update our path based on the global plan and compute costs, only the distances
+    //around what changed since the last cycle are recomputed
+    map_.updatePathCells(costmap_, global_plan_, footprint_list);
     ROS_DEBUG("Path/Goal distance computed");
+    ros::WallTime grid_time = ros::WallTime::now();
 
-    //rollout trajectories and find the minimum cost one
-    Trajectory best = createTrajectories(x, y, theta, 
+    //rollout trajectories and find the minimum cost one, it stays where it was scored so it doesn't have to be copied
+    const Trajectory& best = createTrajectories(x, y, theta, 
         vx, vy, vtheta, 
         acc_lim_x_, acc_lim_y_, acc_lim_theta_);
     ROS_DEBUG("Trajectories created");
 
+    grid_time_ = (grid_time - start_time).toSec();
+    rollout_time_ = (ros::WallTime::now() - grid_time).toSec();
+
     /*
     //If we want to print a ppm file to draw goal dist
     char buf[4096];
@@ -831,8 +1188,8 @@ namespace base_local_planner{
       fprintf(fp, "255\n");
       for(int j = map_.size_y_ - 1; j >= 0; --j){
         for(unsigned int i = 0; i < map_.size_x_; ++i){
-          int g_dist = 255 - int(map_(i, j).goal_dist);
-          int p_dist = 255 - int(map_(i, j).path_dist);
+          int g_dist = 255 - int(map_.getGoalDist(i, j));
+          int p_dist = 255 - int(map_.getPathDist(i, j));
           if(g_dist < 0)
             g_dist = 0;
           if(p_dist < 0)
@@ -859,11 +1216,20 @@ namespace base_local_planner{
     return best;
   }
 
+  void TrajectoryPlanner::getCycleStats(double& grid_time, double& rollout_time, unsigned int& num_samples, unsigned int& footprint_checks) const {
+    grid_time = grid_time_;
+    rollout_time = rollout_time_;
+    num_samples = num_rollouts_;
+    footprint_checks = footprint_checks_;
+  }
+
   //we need to take the footprint of the robot into account when we calculate cost to obstacles
   double TrajectoryPlanner::footprintCost(double x_i, double y_i, double theta_i){
+    return footprintCost(x_i, y_i, cos(theta_i), sin(theta_i));
+  }
+
+  double TrajectoryPlanner::footprintCost(double x_i, double y_i, double cos_th, double sin_th){
     //build the oriented footprint
-    double cos_th = cos(theta_i);
-    double sin_th = sin(theta_i);
     vector<geometry_msgs::Point> oriented_footprint;
     for(unsigned int i = 0; i < footprint_spec_.size(); ++i){
       geometry_msgs::Point new_pt;
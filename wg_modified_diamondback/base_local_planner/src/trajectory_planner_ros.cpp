@@ -69,6 +69,12 @@ namespace base_local_planner {
       trans_stopped_velocity_ = 1e-2;
       double sim_time, sim_granularity, angular_sim_granularity;
       int vx_samples, vtheta_samples;
+      int rollout_threads;
+      bool motion_primitives;
+      double primitive_vel_resolution, primitive_rot_resolution;
+      int max_primitive_sets;
+      bool swept_footprint;
+      bool bound_trajectories;
       double pdist_scale, gdist_scale, occdist_scale, heading_lookahead, oscillation_reset_dist, escape_reset_dist, escape_reset_theta;
       bool holonomic_robot, dwa, simple_attractor, heading_scoring;
       double heading_scoring_timestep;
@@ -82,6 +88,7 @@ namespace base_local_planner {
       costmap_ros_->getCostmapCopy(costmap_);
 
       ros::NodeHandle private_nh("~/" + name);
+      ros::NodeHandle global_node;
 
       g_plan_pub_ = private_nh.advertise<nav_msgs::Path>("global_plan", 1);
       l_plan_pub_ = private_nh.advertise<nav_msgs::Path>("local_plan", 1);
@@ -94,7 +101,6 @@ namespace base_local_planner {
       private_nh.param("xy_goal_tolerance", xy_goal_tolerance_, 0.10);
 
       //to get odometery information, we need to get a handle to the topic in the global namespace of the node
-      ros::NodeHandle global_node;
       odom_sub_ = global_node.subscribe<nav_msgs::Odometry>("odom", 1, boost::bind(&TrajectoryPlannerROS::odomCallback, this, _1));
 
       //we'll get the parameters for the robot radius from the costmap we're associated with
@@ -141,12 +147,46 @@ namespace base_local_planner {
       }
       ROS_INFO("Sim period is set to %.2f", sim_period_);
 
+      //every cycle is timed, cycles that take longer than the controller period are logged with where their time went
+      profiler_.setBudget(sim_period_);
+      profiler_.addPhase("transform plan");
+      profiler_.addPhase("prune plan");
+      profiler_.addPhase("clear footprint");
+      profiler_.addPhase("costmap copy");
+      profiler_.addPhase("distances");
+      profiler_.addPhase("rollouts");
+      profiler_.addPhase("publish");
+      profiler_.addCount("samples");
+      profiler_.addCount("footprint checks");
+
+      //the statistics of the cycles are also published as histograms on the diagnostics topic
+      private_nh.param("cycle_diagnostics_period", diagnostics_period_, 1.0);
+      diagnostics_name_ = private_nh.getNamespace() + ": cycle";
+      if(diagnostics_period_ > 0.0)
+        diagnostics_pub_ = global_node.advertise<diagnostic_msgs::DiagnosticArray>("diagnostics", 1);
+      last_diagnostics_ = ros::WallTime::now();
+
       private_nh.param("sim_time", sim_time, 1.0);
       private_nh.param("sim_granularity", sim_granularity, 0.025);
       private_nh.param("angular_sim_granularity", angular_sim_granularity, sim_granularity);
       private_nh.param("vx_samples", vx_samples, 3);
       private_nh.param("vtheta_samples", vtheta_samples, 20);
 
+      //trajectories can be scored on several threads to allow for more samples in the same time
+      private_nh.param("rollout_threads", rollout_threads, 1);
+
+      //trajectories can also be taken from a library of motion primitives, at the price of rounding the current velocity
+      private_nh.param("motion_primitives", motion_primitives, false);
+      private_nh.param("primitive_vel_resolution", primitive_vel_resolution, 0.05);
+      private_nh.param("primitive_rot_resolution", primitive_rot_resolution, 0.1);
+      private_nh.param("max_primitive_sets", max_primitive_sets, 64);
+
+      //footprints can be checked against the costmap directly, scoring each cell a trajectory covers only once
+      private_nh.param("swept_footprint", swept_footprint, false);
+
+      //trajectories that can't beat the best one are dropped early, this can be turned off to compare against scoring all of them
+      private_nh.param("bound_trajectories", bound_trajectories, true);
+
       private_nh.param("path_distance_bias", pdist_scale, 0.6);
       private_nh.param("goal_distance_bias", gdist_scale, 0.8);
 
@@ -204,11 +244,24 @@ namespace base_local_planner {
       world_model_ = new CostmapModel(costmap_);
       std::vector<double> y_vels = loadYVels(private_nh);
 
+      //instead of the whole costmap, the controller can copy just the window its trajectories can reach each cycle,
+      //padded a little so that the local goal and the path distances look beyond the ends of the trajectories
+      double costmap_window_padding;
+      private_nh.param("copy_costmap_window", copy_costmap_window_, false);
+      private_nh.param("costmap_window_padding", costmap_window_padding, 0.5);
+      double max_vel_y = 0.0;
+      for(unsigned int i = 0; i < y_vels.size(); ++i)
+        max_vel_y = std::max(max_vel_y, fabs(y_vels[i]));
+      double max_vel = std::max(std::max(fabs(max_vel_x), fabs(min_vel_x)), fabs(backup_vel));
+      costmap_window_size_ = sqrt(max_vel * max_vel + max_vel_y * max_vel_y) * sim_time + circumscribed_radius_ + costmap_window_padding;
+
       tc_ = new TrajectoryPlanner(*world_model_, costmap_, costmap_ros_->getRobotFootprint(), inscribed_radius_, circumscribed_radius_,
           acc_lim_x_, acc_lim_y_, acc_lim_theta_, sim_time, sim_granularity, vx_samples, vtheta_samples, pdist_scale,
           gdist_scale, occdist_scale, heading_lookahead, oscillation_reset_dist, escape_reset_dist, escape_reset_theta, holonomic_robot,
           max_vel_x, min_vel_x, max_vel_th_, min_vel_th_, min_in_place_vel_th_, backup_vel,
-          dwa, heading_scoring, heading_scoring_timestep, simple_attractor, y_vels, stop_time_buffer, sim_period_, angular_sim_granularity);
+          dwa, heading_scoring, heading_scoring_timestep, simple_attractor, y_vels, stop_time_buffer, sim_period_, angular_sim_granularity,
+          rollout_threads, motion_primitives, primitive_vel_resolution, primitive_rot_resolution, max_primitive_sets,
+          swept_footprint, bound_trajectories);
 
       map_viz_.initialize(name, &costmap_, boost::bind(&TrajectoryPlanner::getCellCosts, tc_, _1, _2, _3, _4, _5, _6));
       initialized_ = true;
@@ -355,33 +408,86 @@ namespace base_local_planner {
       return false;
     }
 
+    profiler_.startCycle();
+    bool valid_cmd = runCycle(cmd_vel);
+    if(profiler_.endCycle())
+      ROS_WARN("The local planner cycle took longer than the controller period: %s", profiler_.getCycleSummary().c_str());
+
+    publishDiagnostics();
+    return valid_cmd;
+  }
+
+  void TrajectoryPlannerROS::updateCostmapCopy(const tf::Stamped<tf::Pose>& global_pose){
+    if(copy_costmap_window_)
+      costmap_ros_->getCostmapWindowCopy(global_pose.getOrigin().x(), global_pose.getOrigin().y(),
+          costmap_window_size_, costmap_window_size_, costmap_);
+    else
+      costmap_ros_->getCostmapCopy(costmap_);
+  }
+
+  void TrajectoryPlannerROS::profilePlanner(){
+    double grid_time, rollout_time;
+    unsigned int num_samples, footprint_checks;
+    tc_->getCycleStats(grid_time, rollout_time, num_samples, footprint_checks);
+
+    profiler_.addPhaseTime(DISTANCES_PHASE, grid_time);
+    profiler_.addPhaseTime(ROLLOUT_PHASE, rollout_time);
+    profiler_.setCount(SAMPLES_COUNT, num_samples);
+    profiler_.setCount(FOOTPRINT_CHECKS_COUNT, footprint_checks);
+  }
+
+  void TrajectoryPlannerROS::publishDiagnostics(){
+    if(diagnostics_period_ <= 0.0)
+      return;
+
+    ros::WallTime now = ros::WallTime::now();
+    if((now - last_diagnostics_).toSec() < diagnostics_period_)
+      return;
+
+    diagnostic_msgs::DiagnosticArray msg;
+    msg.header.stamp = ros::Time::now();
+    msg.status.resize(1);
+    msg.status[0].name = diagnostics_name_;
+    profiler_.getStatus(msg.status[0]);
+    diagnostics_pub_.publish(msg);
+
+    profiler_.reset();
+    last_diagnostics_ = now;
+  }
+
+  bool TrajectoryPlannerROS::runCycle(geometry_msgs::Twist& cmd_vel){
     bool DEBUGGING = false;
     if (DEBUGGING) ROS_INFO("Updating footprint in local planner");
     tc_->updateFootprintAndRadii(costmap_ros_->getFootprint(), costmap_ros_->getInscribedRadius(),
             costmap_ros_->getCircumscribedRadius());
 
-    std::vector<geometry_msgs::PoseStamped> local_plan;
+    local_plan_.clear();
     tf::Stamped<tf::Pose> global_pose;
     if(!costmap_ros_->getRobotPose(global_pose))
       return false;
 
     std::vector<geometry_msgs::PoseStamped> transformed_plan;
     //get the global plan in our frame
+    profiler_.startPhase(TRANSFORM_PHASE);
     if(!transformGlobalPlan(*tf_, global_plan_, *costmap_ros_, global_frame_, transformed_plan)){
       ROS_WARN("Could not transform the global plan to the frame of the controller");
       return false;
     }
 
     //now we'll prune the plan based on the position of the robot
+    profiler_.startPhase(PRUNE_PHASE);
     if(prune_plan_)
       prunePlan(global_pose, transformed_plan, global_plan_);
 
 
     //we also want to clear the robot footprint from the costmap we're using
+    profiler_.startPhase(CLEAR_FOOTPRINT_PHASE);
     costmap_ros_->clearRobotFootprint();
 
     //make sure to update the costmap we'll use for this cycle
-    costmap_ros_->getCostmapCopy(costmap_);
+    profiler_.startPhase(COSTMAP_COPY_PHASE);
+    updateCostmapCopy(global_pose);
+    profiler_.endPhase();
 
     // Set current velocities from odometry
     geometry_msgs::Twist global_vel;
@@ -400,12 +506,6 @@ namespace base_local_planner {
     robot_vel.frame_id_ = robot_base_frame_;
     robot_vel.stamp_ = ros::Time();
 
-    /* For timing uncomment
-    struct timeval start, end;
-    double start_t, end_t, t_diff;
-    gettimeofday(&start, NULL);
-    */
-
     //if the global plan passed in is empty... we won't do anything
     if(transformed_plan.empty())
       return false;
@@ -441,8 +541,11 @@ namespace base_local_planner {
         //we need to call the next two lines to make sure that the trajectory
         //planner updates its path distance and goal distance grids
         tc_->updatePlan(transformed_plan);
-        Trajectory path = tc_->findBestPath(global_pose, robot_vel, drive_cmds);
+        tc_->findBestPath(global_pose, robot_vel, drive_cmds);
+        profilePlanner();
+        profiler_.startPhase(PUBLISH_PHASE);
         map_viz_.publishCostCloud();
+        profiler_.endPhase();
 
         //copy over the odometry information
         nav_msgs::Odometry base_odom;
@@ -466,8 +569,9 @@ namespace base_local_planner {
       }
 
       //publish an empty plan because we've reached our goal position
+      profiler_.startPhase(PUBLISH_PHASE);
       publishPlan(transformed_plan, g_plan_pub_, 0.0, 1.0, 0.0, 0.0);
-      publishPlan(local_plan, l_plan_pub_, 0.0, 0.0, 1.0, 0.0);
+      publishPlan(local_plan_, l_plan_pub_, 0.0, 0.0, 1.0, 0.0);
 
       //we don't actually want to run the controller when we're just rotating to goal
       return true;
@@ -475,17 +579,13 @@ namespace base_local_planner {
 
     tc_->updatePlan(transformed_plan);
 
-    //compute what trajectory to drive along
-    Trajectory path = tc_->findBestPath(global_pose, robot_vel, drive_cmds);
+    //compute what trajectory to drive along, the planner keeps it until the next cycle
+    const Trajectory& path = tc_->findBestPath(global_pose, robot_vel, drive_cmds);
+    profilePlanner();
 
+    //everything from here on goes to the visualizers
+    profiler_.startPhase(PUBLISH_PHASE);
     map_viz_.publishCostCloud();
-    /* For timing uncomment
-    gettimeofday(&end, NULL);
-    start_t = start.tv_sec + double(start.tv_usec) / 1e6;
-    end_t = end.tv_sec + double(end.tv_usec) / 1e6;
-    t_diff = end_t - start_t;
-    ROS_INFO("Cycle time: %.9f", t_diff);
-    */
 
     //pass along drive commands
     cmd_vel.linear.x = drive_cmds.getOrigin().getX();
@@ -496,26 +596,22 @@ namespace base_local_planner {
 
     //if we cannot move... tell someone
     if(path.cost_ < 0){
-      local_plan.clear();
       publishPlan(transformed_plan, g_plan_pub_, 0.0, 1.0, 0.0, 0.0);
-      publishPlan(local_plan, l_plan_pub_, 0.0, 0.0, 1.0, 0.0);
+      publishPlan(local_plan_, l_plan_pub_, 0.0, 0.0, 1.0, 0.0);
       return false;
     }
 
-    // Fill out the local plan
-    for(unsigned int i = 0; i < path.getPointsSize(); ++i){
-      double p_x, p_y, p_th;
-      path.getPoint(i, p_x, p_y, p_th);
-
-      tf::Stamped<tf::Pose> p = tf::Stamped<tf::Pose>(tf::Pose(tf::createQuaternionFromYaw(p_th), tf::Point(p_x, p_y, 0.0)), ros::Time::now(), global_frame_);
-      geometry_msgs::PoseStamped pose;
-      tf::poseStampedTFToMsg(p, pose);
-      local_plan.push_back(pose);
+    // Fill out the local plan, local_plan_ keeps its capacity from one cycle to the next
+    local_plan_.resize(path.getPointsSize());
+    const double* pts = path.getPoints();
+    for(unsigned int i = 0; i < path.getPointsSize(); ++i, pts += 3){
+      tf::Stamped<tf::Pose> p = tf::Stamped<tf::Pose>(tf::Pose(tf::createQuaternionFromYaw(pts[2]), tf::Point(pts[0], pts[1], 0.0)), ros::Time::now(), global_frame_);
+      tf::poseStampedTFToMsg(p, local_plan_[i]);
     }
 
     //publish information to the visualizer
     publishPlan(transformed_plan, g_plan_pub_, 0.0, 1.0, 0.0, 0.0);
-    publishPlan(local_plan, l_plan_pub_, 0.0, 0.0, 1.0, 0.0);
+    publishPlan(local_plan_, l_plan_pub_, 0.0, 0.0, 1.0, 0.0);
     return true;
   }
 
@@ -527,7 +623,7 @@ namespace base_local_planner {
         costmap_ros_->clearRobotFootprint();
 
         //make sure to update the costmap we'll use for this cycle
-        costmap_ros_->getCostmapCopy(costmap_);
+        updateCostmapCopy(global_pose);
 
         //we need to give the planne some sort of global plan, since we're only checking for legality
         //we'll just give the robots current position
@@ -565,7 +661,7 @@ namespace base_local_planner {
         costmap_ros_->clearRobotFootprint();
 
         //make sure to update the costmap we'll use for this cycle
-        costmap_ros_->getCostmapCopy(costmap_);
+        updateCostmapCopy(global_pose);
 
         //we need to give the planne some sort of global plan, since we're only checking for legality
         //we'll just give the robots current position
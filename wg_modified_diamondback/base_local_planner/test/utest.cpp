@@ -35,13 +35,15 @@
 #include <iostream>
 #include <vector>
 #include <utility>
-#include <base_local_planner/map_cell.h>
 #include <base_local_planner/map_grid.h>
 #include <base_local_planner/trajectory.h>
 #include <base_local_planner/trajectory_planner.h>
 #include <base_local_planner/costmap_model.h>
+#include <base_local_planner/cycle_profiler.h>
 #include <costmap_2d/costmap_2d.h>
 #include <math.h>
+#include <unistd.h>
+#include <boost/scoped_ptr.hpp>
 
 #include <geometry_msgs/Point.h>
 #include <base_local_planner/Position2DInt.h>
@@ -53,41 +55,73 @@ using namespace base_local_planner;
 namespace base_local_planner {
   class WavefrontMapAccessor : public costmap_2d::Costmap2D {
     public:
-      WavefrontMapAccessor(MapGrid &map, double outer_radius) 
+      WavefrontMapAccessor(MapGrid &map) 
         : costmap_2d::Costmap2D(map.size_x_, map.size_y_, map.scale, map.origin_x, map.origin_y, 5, 10, 15),
-        map_(map), outer_radius_(outer_radius) {
+        occ_state_(map.size_x_ * map.size_y_, 0) {
           synchronize();
         }
 
       virtual ~WavefrontMapAccessor(){};
 
       void synchronize(){
-        // Write Cost Data from the map
+        // Write Cost Data from the map, every free cell is treated as close to an obstacle
         for(unsigned int x = 0; x < size_x_; x++){
           for (unsigned int y = 0; y < size_y_; y++){
             unsigned int ind = x + (y * size_x_);
-            if(map_(x, y).occ_state == 1)
+            if(occ_state_[ind] == 1)
               costmap_[ind] = costmap_2d::LETHAL_OBSTACLE;
-            else if(map_(x, y).occ_dist < outer_radius_)
-              costmap_[ind] = costmap_2d::INSCRIBED_INFLATED_OBSTACLE/2;
             else 
-              costmap_[ind] = 0;
+              costmap_[ind] = costmap_2d::INSCRIBED_INFLATED_OBSTACLE/2;
           }
         }
       }
 
+      void setObstacle(unsigned int x, unsigned int y){
+        occ_state_[x + (y * size_x_)] = 1;
+      }
+
     private:
-      MapGrid& map_;
-      double outer_radius_;
+      std::vector<int> occ_state_; ///< @brief Occupancy state (-1 = free, 0 = unknown, 1 = occupied)
+  };
+
+  //a world without obstacles, which isn't backed by a costmap
+  class FreeWorldModel : public WorldModel {
+    public:
+      virtual double footprintCost(const geometry_msgs::Point& position, const std::vector<geometry_msgs::Point>& footprint,
+          double inscribed_radius, double circumscribed_radius){
+        return 0.0;
+      }
   };
 
   class TrajectoryPlannerTest : public testing::Test {
     public:
+    /**
+     * @brief The settings the planners in the tests differ in, all the others are shared
+     */
+    struct PlannerOptions {
+      PlannerOptions() : world_model(NULL), rollout_threads(1), motion_primitives(false), max_primitive_sets(64), swept_footprint(false), 
+        bound_trajectories(true) {}
+      WorldModel* world_model; ///< @brief The world model to check footprints with, NULL for the fixture's costmap model
+      int rollout_threads;
+      bool motion_primitives;
+      int max_primitive_sets;
+      bool swept_footprint;
+      bool bound_trajectories;
+    };
+
     TrajectoryPlannerTest(MapGrid& g, WavefrontMapAccessor* wave, const costmap_2d::Costmap2D& map, std::vector<geometry_msgs::Point> footprint_spec);
+    TrajectoryPlanner* makePlanner(const vector<geometry_msgs::Point>& footprint, const PlannerOptions& options);
+    void compareHeadings(TrajectoryPlanner& a, TrajectoryPlanner& b, int num_states = 16, int num_vels = 4);
     void correctFootprint();
     void footprintObstacles();
     void checkGoalDistance();
     void checkPathDistance();
+    void parallelRollout();
+    void boundedRollout();
+    void prunedNeverBest();
+    void motionPrimitives();
+    void sweptFootprint();
+    void trajectoryStorage();
     virtual void TestBody(){}
 
     MapGrid& map_;
@@ -100,6 +134,56 @@ namespace base_local_planner {
     : map_(g), wa(wave), cm(map), tc(cm, map, footprint_spec, 0.0, 1.0, 1.0, 1.0, 1.0, 2.0) 
   {}
 
+  //a planner following a plan up the right side of the map
+  TrajectoryPlanner* TrajectoryPlannerTest::makePlanner(const vector<geometry_msgs::Point>& footprint, const PlannerOptions& options){
+    WorldModel& world_model = options.world_model != NULL ? *options.world_model : cm;
+    TrajectoryPlanner* planner = new TrajectoryPlanner(world_model, *wa, footprint, 0.0, 1.0, 1.0, 1.0, 1.0, 2.0, 0.25, 6, 20,
+        0.6, 0.8, 0.2, 0.325, 0.05, 0.1, M_PI_2, true, 0.5, 0.1, 1.0, -1.0, 0.4, -0.1,
+        false, false, 0.1, false, vector<double>(0), 0.2, 0.1, 0.025, options.rollout_threads,
+        options.motion_primitives, 0.05, 0.1, options.max_primitive_sets, options.swept_footprint, 
+        options.bound_trajectories);
+
+    vector<geometry_msgs::PoseStamped> plan;
+    geometry_msgs::PoseStamped pose;
+    pose.pose.position.x = 8.5;
+    for(int i = 1; i < 10; ++i){
+      pose.pose.position.y = i + 0.5;
+      plan.push_back(pose);
+    }
+    planner->updatePlan(plan);
+    return planner;
+  }
+
+  //both planners should make the same choice from every heading and velocity, ties included
+  void TrajectoryPlannerTest::compareHeadings(TrajectoryPlanner& a, TrajectoryPlanner& b, int num_states, int num_vels){
+    for(int i = 0; i < num_states; ++i){
+      tf::Stamped<tf::Pose> global_pose, global_vel, drive_velocities;
+      global_pose.setIdentity();
+      global_pose.setOrigin(btVector3(8.5, 2.5, 0));
+      global_pose.setRotation(tf::createQuaternionFromYaw(i * M_PI / 8));
+      global_vel.setIdentity();
+      global_vel.setOrigin(btVector3(0.1 * (i % num_vels), 0, 0));
+
+      Trajectory a_traj = a.findBestPath(global_pose, global_vel, drive_velocities);
+      Trajectory b_traj = b.findBestPath(global_pose, global_vel, drive_velocities);
+
+      EXPECT_FLOAT_EQ(a_traj.cost_, b_traj.cost_) << "state " << i;
+      EXPECT_FLOAT_EQ(a_traj.xv_, b_traj.xv_) << "state " << i;
+      EXPECT_FLOAT_EQ(a_traj.yv_, b_traj.yv_) << "state " << i;
+      EXPECT_FLOAT_EQ(a_traj.thetav_, b_traj.thetav_) << "state " << i;
+      ASSERT_EQ(a_traj.getPointsSize(), b_traj.getPointsSize()) << "state " << i;
+
+      for(unsigned int j = 0; j < a_traj.getPointsSize(); ++j){
+        double x, y, th, b_x, b_y, b_th;
+        a_traj.getPoint(j, x, y, th);
+        b_traj.getPoint(j, b_x, b_y, b_th);
+        EXPECT_NEAR(x, b_x, 1e-9);
+        EXPECT_NEAR(y, b_y, 1e-9);
+        EXPECT_NEAR(th, b_th, 1e-9);
+      }
+    }
+  }
+
   void TrajectoryPlannerTest::correctFootprint(){
     //just create a basic footprint
     vector<base_local_planner::Position2DInt> footprint = tc.getFootprintCells(4.5, 4.5, 0, false);
@@ -166,7 +250,7 @@ namespace base_local_planner {
 
   void TrajectoryPlannerTest::footprintObstacles(){
     //place an obstacle
-    map_(4, 6).occ_state = 1;
+    wa->setObstacle(4, 6);
     wa->synchronize();
     EXPECT_EQ(wa->getCost(4,6), costmap_2d::LETHAL_OBSTACLE);
     Trajectory traj(0, 0, 0, 30);
@@ -176,12 +260,12 @@ namespace base_local_planner {
     EXPECT_FLOAT_EQ(traj.cost_, -1.0);
 
     //place a wall next to the footprint of the robot
-    map_(7, 1).occ_state = 1;
-    map_(7, 3).occ_state = 1;
-    map_(7, 4).occ_state = 1;
-    map_(7, 5).occ_state = 1;
-    map_(7, 6).occ_state = 1;
-    map_(7, 7).occ_state = 1;
+    wa->setObstacle(7, 1);
+    wa->setObstacle(7, 3);
+    wa->setObstacle(7, 4);
+    wa->setObstacle(7, 5);
+    wa->setObstacle(7, 6);
+    wa->setObstacle(7, 7);
     wa->synchronize();
 
     //try to rotate into it
@@ -193,66 +277,253 @@ namespace base_local_planner {
 
   void TrajectoryPlannerTest::checkGoalDistance(){
     //let's box a cell in and make sure that its distance gets set to max
-    map_(1, 2).occ_state = 1;
-    map_(1, 1).occ_state = 1;
-    map_(1, 0).occ_state = 1;
-    map_(2, 0).occ_state = 1;
-    map_(3, 0).occ_state = 1;
-    map_(3, 1).occ_state = 1;
-    map_(3, 2).occ_state = 1;
-    map_(2, 2).occ_state = 1;
+    wa->setObstacle(1, 2);
+    wa->setObstacle(1, 1);
+    wa->setObstacle(1, 0);
+    wa->setObstacle(2, 0);
+    wa->setObstacle(3, 0);
+    wa->setObstacle(3, 1);
+    wa->setObstacle(3, 2);
+    wa->setObstacle(2, 2);
     wa->synchronize();
 
     //set a goal
     tc.map_.resetPathDist();
-    queue<MapCell*> goal_dist_queue;
-    MapCell& current = tc.map_(4, 9);
-    current.goal_dist = 0.0;
-    current.goal_mark = true;
-    goal_dist_queue.push(&current);
+    vector<unsigned int> goal_dist_queue;
+    unsigned int current = tc.map_.getIndex(4, 9);
+    tc.map_.goal_dist_[current] = 0;
+    goal_dist_queue.push_back(current);
     tc.map_.computeGoalDistance(goal_dist_queue, tc.costmap_);
 
-    EXPECT_FLOAT_EQ(tc.map_(4, 8).goal_dist, 1.0);
-    EXPECT_FLOAT_EQ(tc.map_(4, 7).goal_dist, 2.0);
-    EXPECT_FLOAT_EQ(tc.map_(4, 6).goal_dist, 100.0); //there's an obstacle here placed above
-    EXPECT_FLOAT_EQ(tc.map_(4, 5).goal_dist, 6.0);
-    EXPECT_FLOAT_EQ(tc.map_(4, 4).goal_dist, 7.0);
-    EXPECT_FLOAT_EQ(tc.map_(4, 3).goal_dist, 8.0);
-    EXPECT_FLOAT_EQ(tc.map_(4, 2).goal_dist, 9.0);
-    EXPECT_FLOAT_EQ(tc.map_(4, 1).goal_dist, 10.0);
-    EXPECT_FLOAT_EQ(tc.map_(4, 0).goal_dist, 11.0);
-    EXPECT_FLOAT_EQ(tc.map_(5, 8).goal_dist, 2.0);
-    EXPECT_FLOAT_EQ(tc.map_(9, 4).goal_dist, 10.0);
+    EXPECT_FLOAT_EQ(tc.map_.getGoalDist(4, 8), 1.0);
+    EXPECT_FLOAT_EQ(tc.map_.getGoalDist(4, 7), 2.0);
+    EXPECT_FLOAT_EQ(tc.map_.getGoalDist(4, 6), 100.0); //there's an obstacle here placed above
+    EXPECT_FLOAT_EQ(tc.map_.getGoalDist(4, 5), 6.0);
+    EXPECT_FLOAT_EQ(tc.map_.getGoalDist(4, 4), 7.0);
+    EXPECT_FLOAT_EQ(tc.map_.getGoalDist(4, 3), 8.0);
+    EXPECT_FLOAT_EQ(tc.map_.getGoalDist(4, 2), 9.0);
+    EXPECT_FLOAT_EQ(tc.map_.getGoalDist(4, 1), 10.0);
+    EXPECT_FLOAT_EQ(tc.map_.getGoalDist(4, 0), 11.0);
+    EXPECT_FLOAT_EQ(tc.map_.getGoalDist(5, 8), 2.0);
+    EXPECT_FLOAT_EQ(tc.map_.getGoalDist(9, 4), 10.0);
 
     //check the boxed in cell
-    EXPECT_FLOAT_EQ(tc.map_(2, 2).goal_dist, 100.0);
+    EXPECT_FLOAT_EQ(tc.map_.getGoalDist(2, 2), 100.0);
 
   }
 
   void TrajectoryPlannerTest::checkPathDistance(){
     tc.map_.resetPathDist();
-    queue<MapCell*> path_dist_queue;
-    MapCell& current = tc.map_(4, 9);
-    current.path_dist = 0.0;
-    current.path_mark = true;
-    path_dist_queue.push(&current);
+    vector<unsigned int> path_dist_queue;
+    unsigned int current = tc.map_.getIndex(4, 9);
+    tc.map_.path_dist_[current] = 0;
+    path_dist_queue.push_back(current);
     tc.map_.computePathDistance(path_dist_queue, tc.costmap_);
 
-    EXPECT_FLOAT_EQ(tc.map_(4, 8).path_dist, 1.0);
-    EXPECT_FLOAT_EQ(tc.map_(4, 7).path_dist, 2.0);
-    EXPECT_FLOAT_EQ(tc.map_(4, 6).path_dist, 100.0); //there's an obstacle here placed above
-    EXPECT_FLOAT_EQ(tc.map_(4, 5).path_dist, 6.0);
-    EXPECT_FLOAT_EQ(tc.map_(4, 4).path_dist, 7.0);
-    EXPECT_FLOAT_EQ(tc.map_(4, 3).path_dist, 8.0);
-    EXPECT_FLOAT_EQ(tc.map_(4, 2).path_dist, 9.0);
-    EXPECT_FLOAT_EQ(tc.map_(4, 1).path_dist, 10.0);
-    EXPECT_FLOAT_EQ(tc.map_(4, 0).path_dist, 11.0);
-    EXPECT_FLOAT_EQ(tc.map_(5, 8).path_dist, 2.0);
-    EXPECT_FLOAT_EQ(tc.map_(9, 4).path_dist, 10.0);
+    EXPECT_FLOAT_EQ(tc.map_.getPathDist(4, 8), 1.0);
+    EXPECT_FLOAT_EQ(tc.map_.getPathDist(4, 7), 2.0);
+    EXPECT_FLOAT_EQ(tc.map_.getPathDist(4, 6), 100.0); //there's an obstacle here placed above
+    EXPECT_FLOAT_EQ(tc.map_.getPathDist(4, 5), 6.0);
+    EXPECT_FLOAT_EQ(tc.map_.getPathDist(4, 4), 7.0);
+    EXPECT_FLOAT_EQ(tc.map_.getPathDist(4, 3), 8.0);
+    EXPECT_FLOAT_EQ(tc.map_.getPathDist(4, 2), 9.0);
+    EXPECT_FLOAT_EQ(tc.map_.getPathDist(4, 1), 10.0);
+    EXPECT_FLOAT_EQ(tc.map_.getPathDist(4, 0), 11.0);
+    EXPECT_FLOAT_EQ(tc.map_.getPathDist(5, 8), 2.0);
+    EXPECT_FLOAT_EQ(tc.map_.getPathDist(9, 4), 10.0);
 
     //check the boxed in cell
-    EXPECT_FLOAT_EQ(tc.map_(2, 2).path_dist, 100.0);
+    EXPECT_FLOAT_EQ(tc.map_.getPathDist(2, 2), 100.0);
+
+  }
+
+  void TrajectoryPlannerTest::parallelRollout(){
+    //a round robot that scores its trajectories on one thread and one that uses four
+    vector<geometry_msgs::Point> round_footprint;
+    PlannerOptions options;
+    boost::scoped_ptr<TrajectoryPlanner> serial(makePlanner(round_footprint, options));
+    options.rollout_threads = 4;
+    boost::scoped_ptr<TrajectoryPlanner> parallel(makePlanner(round_footprint, options));
+
+    compareHeadings(*serial, *parallel);
+  }
+
+  void TrajectoryPlannerTest::boundedRollout(){
+    //a round robot that scores every trajectory to the end and one that drops them once they can't win
+    vector<geometry_msgs::Point> round_footprint;
+    PlannerOptions options;
+    options.bound_trajectories = false;
+    boost::scoped_ptr<TrajectoryPlanner> full(makePlanner(round_footprint, options));
+    options.bound_trajectories = true;
+    boost::scoped_ptr<TrajectoryPlanner> bounded(makePlanner(round_footprint, options));
+
+    compareHeadings(*full, *bounded);
+  }
+
+  void TrajectoryPlannerTest::prunedNeverBest(){
+    vector<geometry_msgs::Point> round_footprint;
+    boost::scoped_ptr<TrajectoryPlanner> planner(makePlanner(round_footprint, PlannerOptions()));
+
+    unsigned int pruned = 0;
+    for(int i = 0; i < 16; ++i){
+      tf::Stamped<tf::Pose> global_pose, global_vel, drive_velocities;
+      global_pose.setIdentity();
+      global_pose.setOrigin(btVector3(8.5, 2.5, 0));
+      global_pose.setRotation(tf::createQuaternionFromYaw(i * M_PI / 8));
+      global_vel.setIdentity();
+      global_vel.setOrigin(btVector3(0.1 * (i % 4), 0, 0));
+
+      const Trajectory& best = planner->findBestPath(global_pose, global_vel, drive_velocities);
+      EXPECT_NE(best.cost_, -3.0) << "state " << i;
+
+      //none of the trajectories dropped this cycle may be the one returned
+      for(unsigned int j = 0; j < planner->num_rollouts_; ++j){
+        const Trajectory& traj = planner->rollouts_[j];
+        if(traj.cost_ == -3.0){
+          ++pruned;
+          EXPECT_NE(&best, &traj) << "state " << i;
+        }
+      }
+    }
+
+    //otherwise there's nothing to test
+    EXPECT_GT(pruned, 0u);
+  }
+
+  void TrajectoryPlannerTest::motionPrimitives(){
+    //a round robot that simulates its trajectories and one that takes them from motion primitives
+    vector<geometry_msgs::Point> round_footprint;
+    PlannerOptions options;
+    boost::scoped_ptr<TrajectoryPlanner> simulated(makePlanner(round_footprint, options));
+    options.motion_primitives = true;
+    options.max_primitive_sets = 2;
+    boost::scoped_ptr<TrajectoryPlanner> primitives(makePlanner(round_footprint, options));
+
+    //the velocities are on the lattice, so both should follow the same trajectories, whether the primitives are new, reused, or evicted
+    compareHeadings(*simulated, *primitives, 32, 3);
+  }
+
+  void TrajectoryPlannerTest::sweptFootprint(){
+    //a small square robot
+    vector<geometry_msgs::Point> square_footprint;
+    geometry_msgs::Point pt;
+    pt.x = 0.4; pt.y = 0.4; square_footprint.push_back(pt);
+    pt.x = 0.4; pt.y = -0.4; square_footprint.push_back(pt);
+    pt.x = -0.4; pt.y = -0.4; square_footprint.push_back(pt);
+    pt.x = -0.4; pt.y = 0.4; square_footprint.push_back(pt);
+
+    //a lone footprint should cost the same as it does in the costmap model
+    SweptFootprint swept(*wa);
+    for(int i = 0; i < 64; ++i){
+      double x = 0.5 + (i % 8) * 1.1, y = 0.5 + (i / 8) * 1.1, th = i * M_PI / 7;
+      geometry_msgs::Point position;
+      position.x = x;
+      position.y = y;
+      vector<geometry_msgs::Point> oriented_footprint;
+      for(unsigned int j = 0; j < square_footprint.size(); ++j){
+        pt.x = x + (square_footprint[j].x * cos(th) - square_footprint[j].y * sin(th));
+        pt.y = y + (square_footprint[j].x * sin(th) + square_footprint[j].y * cos(th));
+        oriented_footprint.push_back(pt);
+      }
+      double model_cost = cm.footprintCost(position, oriented_footprint, 0.0, 1.0);
+
+      swept.clear();
+      double swept_cost = swept.footprintCost(x, y, cos(th), sin(th), square_footprint);
+      if(model_cost < 0)
+        EXPECT_LT(swept_cost, 0.0);
+      else{
+        EXPECT_FLOAT_EQ(model_cost, swept_cost);
+
+        //the same footprint again covers no new cells
+        EXPECT_FLOAT_EQ(swept.footprintCost(x, y, cos(th), sin(th), square_footprint), 0.0);
+      }
+    }
+
+    //and the planner should make the same choices as with per step checks
+    PlannerOptions options;
+    boost::scoped_ptr<TrajectoryPlanner> per_step(makePlanner(square_footprint, options));
+    options.swept_footprint = true;
+    boost::scoped_ptr<TrajectoryPlanner> swept_planner(makePlanner(square_footprint, options));
+    ASSERT_TRUE(swept_planner->getSweptFootprint(0) != NULL);
+
+    compareHeadings(*per_step, *swept_planner);
+
+    //any other world model has to check the footprints itself
+    FreeWorldModel free_world;
+    options.world_model = &free_world;
+    boost::scoped_ptr<TrajectoryPlanner> free_planner(makePlanner(square_footprint, options));
+    EXPECT_TRUE(free_planner->getSweptFootprint(0) == NULL);
+  }
+
+  void TrajectoryPlannerTest::trajectoryStorage(){
+    vector<geometry_msgs::Point> round_footprint;
+    boost::scoped_ptr<TrajectoryPlanner> planner(makePlanner(round_footprint, PlannerOptions()));
+
+    //the first pass over the states may still need to make room for trajectories, the second one shouldn't
+    vector<const double*> points;
+    for(int pass = 0; pass < 2; ++pass){
+      for(int i = 0; i < 16; ++i){
+        tf::Stamped<tf::Pose> global_pose, global_vel, drive_velocities;
+        global_pose.setIdentity();
+        global_pose.setOrigin(btVector3(8.5, 2.5, 0));
+        global_pose.setRotation(tf::createQuaternionFromYaw(i * M_PI / 8));
+        global_vel.setIdentity();
+        global_vel.setOrigin(btVector3(0.1 * (i % 4), 0, 0));
+
+        const Trajectory& best = planner->findBestPath(global_pose, global_vel, drive_velocities);
+        bool owned = &best == &planner->traj_one;
+        for(unsigned int j = 0; j < planner->rollouts_.size(); ++j)
+          owned = owned || &best == &planner->rollouts_[j];
+        EXPECT_TRUE(owned);
+
+        //reused storage has to hold the same trajectory as a planner scoring this state for the first time
+        boost::scoped_ptr<TrajectoryPlanner> fresh(makePlanner(round_footprint, PlannerOptions()));
+        const Trajectory& fresh_best = fresh->findBestPath(global_pose, global_vel, drive_velocities);
+        EXPECT_FLOAT_EQ(fresh_best.cost_, best.cost_);
+        EXPECT_FLOAT_EQ(fresh_best.xv_, best.xv_);
+        EXPECT_FLOAT_EQ(fresh_best.thetav_, best.thetav_);
+        ASSERT_EQ(fresh_best.getPointsSize(), best.getPointsSize());
+        for(unsigned int j = 0; j < best.getPointsSize(); ++j){
+          double x, y, th, fresh_x, fresh_y, fresh_th;
+          best.getPoint(j, x, y, th);
+          fresh_best.getPoint(j, fresh_x, fresh_y, fresh_th);
+          EXPECT_EQ(fresh_x, x);
+          EXPECT_EQ(fresh_y, y);
+          EXPECT_EQ(fresh_th, th);
+        }
+      }
 
+      vector<const double*> pass_points;
+      for(unsigned int j = 0; j < planner->rollouts_.size(); ++j){
+        EXPECT_LE(planner->rollouts_[j].getPointsSize(), planner->max_traj_points_);
+        pass_points.push_back(planner->rollouts_[j].getPoints());
+      }
+      pass_points.push_back(planner->traj_one.getPoints());
+      if(pass == 1){
+        EXPECT_TRUE(pass_points == points);
+      }
+      points = pass_points;
+    }
+
+    //points are stored one after the other, and new points overwrite the old ones in place
+    Trajectory t;
+    t.addPoint(1.0, 2.0, 3.0);
+    t.addPoint(4.0, 5.0, 6.0);
+    const double* pts = t.getPoints();
+    EXPECT_EQ(t.getPointsSize(), 2u);
+    EXPECT_FLOAT_EQ(pts[3], 4.0);
+    EXPECT_FLOAT_EQ(pts[5], 6.0);
+    t.resetPoints();
+    EXPECT_EQ(t.getPointsSize(), 0u);
+    t.addPoint(7.0, 8.0, 9.0);
+    EXPECT_EQ(t.getPoints(), pts);
+    double x, y, th;
+    t.getPoint(0, x, y, th);
+    EXPECT_FLOAT_EQ(x, 7.0);
+    EXPECT_FLOAT_EQ(y, 8.0);
+    EXPECT_FLOAT_EQ(th, 9.0);
+    t.getEndpoint(x, y, th);
+    EXPECT_FLOAT_EQ(x, 7.0);
   }
 };
 
@@ -260,24 +531,221 @@ namespace base_local_planner {
 TEST(MapGrid, properGridConstruction){
   MapGrid mg(10, 10);
   mg.scale = 1.0;
-  MapCell mc;
+  EXPECT_EQ(mg.size(), 100u);
 
   for(int i = 0; i < 10; ++i){
     for(int j = 0; j < 10; ++j){
-      mc.cx = i;
-      mc.cy = j;
-      mg(i, j) = mc;
+      EXPECT_FLOAT_EQ(mg.getPathDist(i, j), DBL_MAX);
+      EXPECT_FLOAT_EQ(mg.getGoalDist(i, j), DBL_MAX);
+      EXPECT_FALSE(mg.isWithinRobot(i, j));
+      mg.path_dist_[mg.getIndex(i, j)] = i;
+      mg.goal_dist_[mg.getIndex(i, j)] = j;
     }
   }
 
   for(int i = 0; i < 10; ++i){
     for(int j = 0; j < 10; ++j){
-      EXPECT_FLOAT_EQ(mg(i, j).cx, i);
-      EXPECT_FLOAT_EQ(mg(i, j).cy, j);
+      EXPECT_FLOAT_EQ(mg.getPathDist(i, j), i);
+      EXPECT_FLOAT_EQ(mg.getGoalDist(i, j), j);
     }
   }
 }
 
+//make sure that repairing the distances gives the same distances as computing them from scratch
+TEST(MapGrid, incrementalDistances){
+  //a world with some obstacles in it, and a winding plan across it
+  const int world_size = 100;
+  const int window_size = 50;
+  const double resolution = 0.1;
+  srand(42);
+  vector<unsigned char> world(world_size * world_size, 0);
+  for(int i = 0; i < 40; ++i){
+    int x0 = rand() % world_size, y0 = rand() % world_size;
+    for(int y = y0; y < y0 + 3 && y < world_size; ++y)
+      for(int x = x0; x < x0 + 3 && x < world_size; ++x)
+        world[y * world_size + x] = costmap_2d::LETHAL_OBSTACLE;
+  }
+
+  vector<geometry_msgs::PoseStamped> world_plan;
+  geometry_msgs::PoseStamped pose;
+  for(int i = 0; i < 200; ++i){
+    pose.pose.position.x = 2.6 + i * 0.025;
+    pose.pose.position.y = 2.6 + i * 0.025 + 0.5 * sin(i * 0.05);
+    world_plan.push_back(pose);
+  }
+
+  MapGrid incremental;
+  int window_x = 0, window_y = 0;
+  for(int cycle = 0; cycle < 66; ++cycle){
+    //the robot moves along the plan, which gets pruned behind it and now and then ends short of the edge of the window
+    unsigned int robot = cycle * 3;
+    unsigned int plan_end = cycle % 11 == 4 ? min(robot + 20, (unsigned int)world_plan.size()) : world_plan.size();
+    vector<geometry_msgs::PoseStamped> plan(world_plan.begin() + robot, world_plan.begin() + plan_end);
+    double robot_x = world_plan[robot].pose.position.x;
+    double robot_y = world_plan[robot].pose.position.y;
+
+    //obstacles come and go around the robot
+    if(cycle % 2 == 0){
+      int x = int(robot_x / resolution) + rand() % 11 - 5;
+      int y = int(robot_y / resolution) + rand() % 11 - 5;
+      world[y * world_size + x] = world[y * world_size + x] == 0 ? costmap_2d::LETHAL_OBSTACLE : 0;
+    }
+
+    //the window rolls along with the robot by whole cells once it gets off center, and every so often it doesn't
+    //line up with the old one
+    int robot_cell_x = int(robot_x / resolution);
+    int robot_cell_y = int(robot_y / resolution);
+    if(cycle == 0 || abs(robot_cell_x - window_x - window_size / 2) > 2 || abs(robot_cell_y - window_y - window_size / 2) > 2){
+      window_x = robot_cell_x - window_size / 2;
+      window_y = robot_cell_y - window_size / 2;
+    }
+    double offset = cycle % 13 == 12 ? 0.03 : 0.0;
+    vector<unsigned char> window(window_size * window_size);
+    for(int y = 0; y < window_size; ++y)
+      for(int x = 0; x < window_size; ++x)
+        window[y * window_size + x] = world[(window_y + y) * world_size + window_x + x];
+    costmap_2d::Costmap2D costmap(window_size, window_size, resolution, window_x * resolution + offset, window_y * resolution + offset,
+        0.2, 0.25, 0.4, 0.0, 0.0, 0.0, 10.0, window, 100);
+
+    vector<base_local_planner::Position2DInt> footprint_cells;
+    base_local_planner::Position2DInt cell;
+    for(int y = -2; y <= 2; ++y){
+      for(int x = -2; x <= 2; ++x){
+        cell.x = robot_cell_x - window_x + x;
+        cell.y = robot_cell_y - window_y + y;
+        footprint_cells.push_back(cell);
+      }
+    }
+
+    incremental.updatePathCells(costmap, plan, footprint_cells);
+
+    MapGrid full(window_size, window_size);
+    full.resetPathDist();
+    for(unsigned int i = 0; i < footprint_cells.size(); ++i)
+      full.within_robot_[full.getIndex(footprint_cells[i].x, footprint_cells[i].y)] = 1;
+    full.setPathCells(costmap, plan);
+
+    int path_mismatches = 0, goal_mismatches = 0;
+    for(int y = 0; y < window_size; ++y){
+      for(int x = 0; x < window_size; ++x){
+        if(incremental.getPathDist(x, y) != full.getPathDist(x, y))
+          ++path_mismatches;
+        if(incremental.getGoalDist(x, y) != full.getGoalDist(x, y))
+          ++goal_mismatches;
+      }
+    }
+    EXPECT_EQ(path_mismatches, 0) << "cycle " << cycle;
+    EXPECT_EQ(goal_mismatches, 0) << "cycle " << cycle;
+    EXPECT_FLOAT_EQ(incremental.goal_x_, full.goal_x_);
+    EXPECT_FLOAT_EQ(incremental.goal_y_, full.goal_y_);
+  }
+}
+
+//make sure that the wavefront gives the same distances as the breadth first search
+TEST(MapGrid, wavefrontDistances){
+  const int size = 70;
+  srand(7);
+  vector<unsigned char> data(size * size, 0);
+  for(int i = 0; i < 60; ++i)
+    data[(rand() % size) * size + rand() % size] = costmap_2d::LETHAL_OBSTACLE;
+  costmap_2d::Costmap2D costmap(size, size, 0.1, 0.0, 0.0, 0.1, 0.15, 0.2, 0.0, 0.0, 0.0, 10.0, data, 100);
+
+  //a plan that runs through some of the obstacles and ends in the middle of the grid
+  vector<geometry_msgs::PoseStamped> plan;
+  geometry_msgs::PoseStamped pose;
+  for(int i = 0; i < 120; ++i){
+    pose.pose.position.x = 0.05 + i * 0.03;
+    pose.pose.position.y = 3.5 + 2.0 * sin(i * 0.06);
+    plan.push_back(pose);
+  }
+
+  MapGrid wavefront(size, size);
+  wavefront.resetPathDist();
+  wavefront.setPathCells(costmap, plan);
+
+  MapGrid search(size, size);
+  search.resetPathDist();
+  vector<unsigned int> queue;
+  unsigned int goal = 0;
+  for(unsigned int i = 0; i < plan.size(); ++i){
+    unsigned int x, y;
+    ASSERT_TRUE(costmap.worldToMap(plan[i].pose.position.x, plan[i].pose.position.y, x, y));
+    goal = search.getIndex(x, y);
+    if(search.path_dist_[goal] != 0){
+      search.path_dist_[goal] = 0;
+      queue.push_back(goal);
+    }
+  }
+  search.computePathDistance(queue, costmap);
+  queue.clear();
+  search.goal_dist_[goal] = 0;
+  queue.push_back(goal);
+  search.computeGoalDistance(queue, costmap);
+
+  int blocked = 0;
+  for(int y = 0; y < size; ++y){
+    for(int x = 0; x < size; ++x){
+      EXPECT_EQ(wavefront.getPathDist(x, y), search.getPathDist(x, y)) << x << ", " << y;
+      EXPECT_EQ(wavefront.getGoalDist(x, y), search.getGoalDist(x, y)) << x << ", " << y;
+      blocked += search.getGoalDist(x, y) == search.size();
+    }
+  }
+  EXPECT_GT(blocked, 0);
+}
+
+//make sure that the phases of a cycle end up in the right histogram buckets
+TEST(CycleProfiler, histograms){
+  CycleProfiler profiler(1000.0);
+  unsigned int slow = profiler.addPhase("slow");
+  unsigned int fast = profiler.addPhase("fast");
+  unsigned int samples = profiler.addCount("samples");
+
+  for(unsigned int i = 0; i < 4; ++i){
+    profiler.startCycle();
+    profiler.addPhaseTime(slow, 0.02);
+    profiler.addPhaseTime(fast, 0.0002);
+    profiler.addPhaseTime(fast, 0.0002);
+    profiler.setCount(samples, 10 * i);
+    EXPECT_FALSE(profiler.endCycle());
+  }
+
+  //0.02 seconds is at most 25 ms, twice 0.2 ms at most 0.5 ms
+  EXPECT_EQ(profiler.getNumCycles(), 4u);
+  EXPECT_EQ(profiler.getHistogram(slow)[7], 4u);
+  EXPECT_EQ(profiler.getHistogram(fast)[2], 4u);
+  EXPECT_FLOAT_EQ(CycleProfiler::getBucketLimit(7), 0.025);
+  EXPECT_LT(CycleProfiler::getBucketLimit(CycleProfiler::NUM_BUCKETS - 1), 0.0);
+
+  diagnostic_msgs::DiagnosticStatus status;
+  profiler.getStatus(status);
+  EXPECT_EQ(status.level, (unsigned char)diagnostic_msgs::DiagnosticStatus::OK);
+  bool found_mean = false;
+  for(unsigned int i = 0; i < status.values.size(); ++i){
+    if(status.values[i].key == "samples mean"){
+      EXPECT_EQ(status.values[i].value, "15.0");
+      found_mean = true;
+    }
+  }
+  EXPECT_TRUE(found_mean);
+
+  //a cycle over budget is counted and reported
+  profiler.setBudget(0.0);
+  profiler.startCycle();
+  profiler.startPhase(slow);
+  usleep(1000);
+  profiler.endPhase();
+  EXPECT_TRUE(profiler.endCycle());
+  EXPECT_EQ(profiler.getNumSlowCycles(), 1u);
+  EXPECT_EQ(profiler.getHistogram(slow)[0], 0u);
+  EXPECT_EQ(profiler.getHistogram(fast)[0], 1u);
+  profiler.getStatus(status);
+  EXPECT_EQ(status.level, (unsigned char)diagnostic_msgs::DiagnosticStatus::WARN);
+
+  profiler.reset();
+  EXPECT_EQ(profiler.getNumCycles(), 0u);
+  EXPECT_EQ(profiler.getHistogram(slow)[7], 0u);
+}
+
 TrajectoryPlannerTest* tct = NULL;
 
 TEST(TrajectoryPlannerTest, correctFootprint){
@@ -299,12 +767,42 @@ TEST(TrajectoryPlannerTest, checkPathDistance){
   tct->checkPathDistance();
 }
 
+//make sure that scoring trajectories on several threads picks the same trajectory
+TEST(TrajectoryPlannerTest, parallelRollout){
+  tct->parallelRollout();
+}
+
+//make sure that dropping trajectories early picks the same trajectory as scoring all of them
+TEST(TrajectoryPlannerTest, boundedRollout){
+  tct->boundedRollout();
+}
+
+//make sure that a trajectory dropped by the bound is never picked
+TEST(TrajectoryPlannerTest, prunedNeverBest){
+  tct->prunedNeverBest();
+}
+
+//make sure that trajectories from motion primitives match the simulated ones
+TEST(TrajectoryPlannerTest, motionPrimitives){
+  tct->motionPrimitives();
+}
+
+//make sure that the swept footprint scores trajectories the same way the costmap model does
+TEST(TrajectoryPlannerTest, sweptFootprint){
+  tct->sweptFootprint();
+}
+
+//make sure that trajectories keep their storage from one cycle to the next
+TEST(TrajectoryPlannerTest, trajectoryStorage){
+  tct->trajectoryStorage();
+}
+
 
 
 //test some stuff
 int main(int argc, char** argv){
   MapGrid mg(10, 10, 1, 0, 0);
-  WavefrontMapAccessor wa(mg, .25);
+  WavefrontMapAccessor wa(mg);
   const costmap_2d::Costmap2D& map = wa;
   std::vector<geometry_msgs::Point> footprint_spec;
   geometry_msgs::Point pt;
@@ -39,6 +39,9 @@
 
 #include <vector>
 #include <queue>
+#include <algorithm>
+#include <string>
+#include <stdint.h>
 #include <costmap_2d/observation.h>
 #include <costmap_2d/cell_data.h>
 #include <costmap_2d/cost_values.h>
@@ -52,6 +55,47 @@ namespace costmap_2d {
     unsigned int y;
   };
 
+  /**
+   * @brief  A bounding box of the cells that have changed since a map derived from the costmap was last updated
+   */
+  struct DirtyRegion {
+    DirtyRegion() : dirty(false), min_x(0), min_y(0), max_x(0), max_y(0) {}
+
+    inline void add(unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1){
+      if(!dirty){
+        min_x = x0;
+        min_y = y0;
+        max_x = x1;
+        max_y = y1;
+        dirty = true;
+        return;
+      }
+
+      min_x = std::min(min_x, x0);
+      min_y = std::min(min_y, y0);
+      max_x = std::max(max_x, x1);
+      max_y = std::max(max_y, y1);
+    }
+
+    bool dirty;
+    unsigned int min_x, min_y, max_x, max_y;
+  };
+
+  /**
+   * @brief  The header written at the start of a static map cache file, the inflated static map follows it directly
+   */
+  struct StaticMapFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t size_x, size_y;
+    double resolution;
+    double origin_x, origin_y;
+    double inscribed_radius, circumscribed_radius, inflation_radius;
+    double weight;
+    unsigned char lethal_threshold, track_unknown_space, unknown_cost_value, padding;
+    uint64_t source_checksum;
+  };
+
   /**
    * @class Costmap2D
    * @brief A 2D costmap provides a mapping between points in the world and their associated "costs".
@@ -100,7 +144,9 @@ namespace costmap_2d {
       Costmap2D& operator=(const Costmap2D& map);
 
       /**
-       * @brief  Turn this costmap into a copy of a window of a costmap passed in
+       * @brief  Turn this costmap into a copy of a window of a costmap passed in. The window is grown to whole cells of
+       * the map, and has to fit inside of it. Taking a window of the same size again reuses the memory of this costmap.
+       * The window keeps a pyramid and a distance field if the map does, with the distances copied from the map.
        * @param  map The costmap to copy
        * @param win_origin_x The x origin (lower left corner) for the window to copy, in meters
        * @param win_origin_y The y origin (lower left corner) for the window to copy, in meters
@@ -368,6 +414,138 @@ namespace costmap_2d {
        */
       void saveMap(std::string file_name);
 
+      /**
+       * @brief  Save the inflated static map to a binary cache file that can be loaded back with loadStaticMap
+       * @param file_name The name of the file to save
+       * @param source_checksum A checksum of the occupancy data the static map was built from
+       * @return True if the file was written, false otherwise
+       */
+      bool saveStaticMap(const std::string& file_name, uint64_t source_checksum) const;
+
+      /**
+       * @brief  Read a binary cache file written by saveStaticMap and use it as the static map, skipping inflation
+       * @param file_name The name of the file to load
+       * @param source_checksum A checksum of the occupancy data the static map should have been built from
+       * @return True if the file matched the size, origin, inflation parameters, and checksum of the costmap and was loaded, false otherwise
+       */
+      bool loadStaticMap(const std::string& file_name, uint64_t source_checksum);
+
+      /**
+       * @brief  Keep a max-pooled pyramid of coarser versions of the costmap, a cell at level k covers 2^k by 2^k cells of the costmap
+       * @param levels The number of coarse levels to maintain, 0 disables the pyramid
+       */
+      void setPyramidLevels(unsigned int levels);
+
+      /**
+       * @brief  Accessor for the number of coarse levels in the pyramid
+       * @return The number of coarse levels, 0 if the pyramid is disabled
+       */
+      unsigned int getPyramidLevels() const { return pyramid_levels_; }
+
+      /**
+       * @brief  Recompute the pyramid over the regions of the costmap that have changed since the last call,
+       * queries against the pyramid reflect the costmap as of the last call to this function
+       */
+      void updatePyramid();
+
+      /**
+       * @brief  Accessor for the x size of a pyramid level in cells
+       * @param level The pyramid level, 0 is the costmap itself
+       * @return The x size of the level
+       */
+      unsigned int getPyramidSizeInCellsX(unsigned int level) const;
+
+      /**
+       * @brief  Accessor for the y size of a pyramid level in cells
+       * @param level The pyramid level, 0 is the costmap itself
+       * @return The y size of the level
+       */
+      unsigned int getPyramidSizeInCellsY(unsigned int level) const;
+
+      /**
+       * @brief  Get the maximum cost of the costmap cells covered by a coarse cell
+       * @param level The pyramid level, 0 is the costmap itself
+       * @param cx The x coordinate of the cell at that level
+       * @param cy The y coordinate of the cell at that level
+       * @return The maximum cost under the coarse cell
+       */
+      unsigned char getCoarseCost(unsigned int level, unsigned int cx, unsigned int cy) const;
+
+      /**
+       * @brief  Get an upper bound on the cost of the cells overlapping a box in world space. As long as the pyramid has
+       * enough levels to cover the box, this takes at most four lookups. Note that NO_INFORMATION dominates every other cost.
+       * @param wx0 The x coordinate of one corner of the box
+       * @param wy0 The y coordinate of one corner of the box
+       * @param wx1 The x coordinate of the opposite corner of the box
+       * @param wy1 The y coordinate of the opposite corner of the box
+       * @param cost Will be set to the maximum cost of the coarse cells covering the box
+       * @return False if the box does not overlap the costmap, true otherwise
+       */
+      bool getMaxCostInBox(double wx0, double wy0, double wx1, double wy1, unsigned char& cost) const;
+
+      /**
+       * @brief  Maintain a signed distance field alongside the costmap holding the metric distance from each cell to the nearest
+       * lethal obstacle, positive in free space and negative inside obstacles
+       * @param max_distance The distance in meters at which the field saturates, this also bounds the work done per update
+       */
+      void enableDistanceField(double max_distance);
+
+      /**
+       * @brief  Stop maintaining the distance field and free its memory
+       */
+      void disableDistanceField();
+
+      /**
+       * @brief  Check whether or not the costmap is maintaining a distance field
+       * @return True if the distance field is enabled
+       */
+      bool hasDistanceField() const { return distance_field_ != NULL; }
+
+      /**
+       * @brief  Accessor for the distance at which the distance field saturates
+       * @return The maximum magnitude of a distance in the field in meters
+       */
+      double getDistanceFieldMaxDistance() const { return distance_field_max_; }
+
+      /**
+       * @brief  Recompute the distance field around the regions of the costmap that have changed since the last call,
+       * queries against the distance field reflect the costmap as of the last call to this function
+       */
+      void updateDistanceField();
+
+      /**
+       * @brief  Get the signed distance from a cell to the nearest lethal obstacle
+       * @param mx The x coordinate of the cell
+       * @param my The y coordinate of the cell
+       * @return The distance in meters, negative inside obstacles and saturated at the maximum distance of the field
+       */
+      double getDistance(unsigned int mx, unsigned int my) const;
+
+      /**
+       * @brief  Will return a immutable pointer to the underlying distance field, laid out the same way as the costmap
+       * @return A pointer to the distance field, NULL if the distance field is disabled
+       */
+      const float* getDistanceField() const;
+
+      /**
+       * @brief  Have obstacles marked by sensors decay out of the costmap unless they are re-observed
+       * @param decay_time The time in seconds after which an obstacle that hasn't been re-observed is forgotten, 0.0 disables decay
+       */
+      void setObstacleDecayTime(double decay_time);
+
+      /**
+       * @brief  Accessor for the time after which obstacles decay out of the costmap
+       * @return The decay time in seconds, 0.0 if obstacles don't decay
+       */
+      double getObstacleDecayTime() const { return obstacle_decay_time_; }
+
+      /**
+       * @brief  Forget the obstacles that have not been re-observed within the decay time and reinflate around them,
+       * obstacles marked after this call are stamped with the given time
+       * @param now The current time in seconds
+       */
+      void decayObstacles(double now);
+
       /**
        * @brief  Update the costmap's static map with new data
        * @param win_origin_x The x origin of the map we'll be using to replace the static map in meters
@@ -394,6 +572,120 @@ namespace costmap_2d {
 
 
     protected:
+      /**
+       * @brief  Fill out a static map cache header describing this costmap
+       * @param header The header to fill out
+       * @param source_checksum A checksum of the occupancy data the static map was built from
+       */
+      void fillStaticMapHeader(StaticMapFileHeader& header, uint64_t source_checksum) const;
+
+      /**
+       * @brief  Record that a region of the costmap has changed so that the maps derived from it can be brought up to date
+       * @param x0 The lower x bound of the changed region in cells
+       * @param y0 The lower y bound of the changed region in cells
+       * @param x1 The upper x bound of the changed region in cells, inclusive
+       * @param y1 The upper y bound of the changed region in cells, inclusive
+       */
+      inline void markDirty(unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1){
+        if(pyramid_levels_ > 0)
+          pyramid_dirty_.add(x0, y0, x1, y1);
+        if(distance_field_ != NULL)
+          distance_field_dirty_.add(x0, y0, x1, y1);
+      }
+
+      /**
+       * @brief  Record that the whole costmap has changed
+       */
+      void markDirty();
+
+      /**
+       * @brief  Record that a window of the costmap, given in world coordinates, has changed
+       * @param wx The x coordinate of the center of the window
+       * @param wy The y coordinate of the center of the window
+       * @param w_size_x The x size of the window
+       * @param w_size_y The y size of the window
+       */
+      void markDirtyWindow(double wx, double wy, double w_size_x, double w_size_y);
+
+      /**
+       * @brief  Allocate the pyramid levels for the current size of the costmap
+       */
+      void initPyramid();
+
+      /**
+       * @brief  Free the pyramid levels
+       */
+      void deletePyramid();
+
+      /**
+       * @brief  Record that a cell has been marked as an obstacle by a sensor at the current time
+       * @param index The index of the cell
+       */
+      inline void stampObstacle(unsigned int index){
+        if(obstacle_stamps_ == NULL)
+          return;
+
+        //start tracking the cell if it isn't already being tracked
+        if(obstacle_stamps_[index] < 0.0f)
+          decay_cells_.push_back(index);
+
+        obstacle_stamps_[index] = obstacle_time_;
+      }
+
+      /**
+       * @brief  Remove an obstacle that has decayed from the costmap, restoring the cell to what the static map has for it
+       * @param index The index of the cell
+       */
+      virtual void forgetObstacle(unsigned int index);
+
+      /**
+       * @brief  Move the obstacle stamps along with the data in the costmap when its origin moves
+       * @param cell_ox The x offset of the new origin from the old one in cells
+       * @param cell_oy The y offset of the new origin from the old one in cells
+       */
+      void shiftObstacleStamps(int cell_ox, int cell_oy);
+
+      /**
+       * @brief  Allocate the obstacle stamps for the current size of the costmap
+       */
+      void initObstacleStamps();
+
+      /**
+       * @brief  Free the obstacle stamps
+       */
+      void deleteObstacleStamps();
+
+      /**
+       * @brief  Allocate the distance field for the current size of the costmap
+       */
+      void initDistanceField();
+
+      /**
+       * @brief  Free the distance field
+       */
+      void deleteDistanceField();
+
+      /**
+       * @brief  Compute squared cell distances over a window of the costmap into the distance scratch grid
+       * @param x0 The lower x bound of the window
+       * @param y0 The lower y bound of the window
+       * @param size_x The x size of the window
+       * @param size_y The y size of the window
+       * @param to_obstacles If true, compute distances to lethal cells, otherwise compute distances to non-lethal cells
+       * @param max_sq_dist Distances larger than this are reported as this value, which keeps the arithmetic exact in floats
+       */
+      void distanceTransformWindow(unsigned int x0, unsigned int y0, unsigned int size_x, unsigned int size_y,
+          bool to_obstacles, float max_sq_dist);
+
+      /**
+       * @brief  Exact 1D squared distance transform of a sampled function (Felzenszwalb and Huttenlocher), linear in the input size
+       * @param f The sampled function, read with the given stride
+       * @param n The number of samples
+       * @param stride The distance between consecutive samples in f and d
+       * @param d Will be filled with the transform, written with the given stride
+       */
+      void distanceTransform1D(float* f, unsigned int n, unsigned int stride, float* d);
+
       /**
        * @brief  Given an index of a cell in the costmap, place it into a priority queue for obstacle inflation
        * @param  index The index of the cell
@@ -676,6 +968,20 @@ namespace costmap_2d {
       bool track_unknown_space_;
       unsigned char unknown_cost_value_;
       std::priority_queue<CellData> inflation_queue_;
+      unsigned int pyramid_levels_;
+      std::vector<unsigned char*> pyramid_; ///< @brief The coarse levels of the pyramid, level k is stored at k - 1
+      std::vector<unsigned int> pyramid_size_x_, pyramid_size_y_; ///< @brief The size of each level, including level 0
+      DirtyRegion pyramid_dirty_; ///< @brief The region of the costmap that has changed since the pyramid was last updated
+      float* distance_field_;
+      double distance_field_max_;
+      DirtyRegion distance_field_dirty_; ///< @brief The region of the costmap that has changed since the distance field was last updated
+      std::vector<float> edt_grid_, edt_f_, edt_z_; ///< @brief Scratch space for the distance transform
+      std::vector<int> edt_v_;
+      double obstacle_decay_time_;
+      float* obstacle_stamps_; ///< @brief The time each cell was last marked by a sensor relative to the stamp epoch, negative for cells that aren't tracked
+      std::vector<unsigned int> decay_cells_; ///< @brief The cells that have a stamp, so that decaying doesn't have to search the whole map
+      double obstacle_stamp_epoch_;
+      float obstacle_time_;
 
       //functors for raytracing actions
       class ClearCell {
@@ -44,6 +44,7 @@
 #include <costmap_2d/costmap_2d_publisher.h>
 #include <costmap_2d/observation_buffer.h>
 #include <costmap_2d/voxel_costmap_2d.h>
+#include <costmap_2d/replay_log.h>
 #include <costmap_2d/VoxelGrid.h>
 #include <nav_msgs/OccupancyGrid.h>
 #include <map>
@@ -413,6 +414,9 @@ namespace costmap_2d {
       boost::recursive_mutex map_data_lock_;
       nav_msgs::MapMetaData map_meta_data_;
       std::vector<unsigned char> input_data_;
+      std::string static_map_cache_; ///< @brief Path of the pre-inflated static map cache, empty if caching is disabled
+      nav_msgs::OccupancyGridConstPtr static_map_msg_; ///< @brief Held onto at startup when caching so that we only copy the map on a cache miss
+      ReplayLogWriter replay_log_; ///< @brief Records the inputs to each map update for offline benchmarking when the replay_log parameter is set
       bool costmap_initialized_;
 
 
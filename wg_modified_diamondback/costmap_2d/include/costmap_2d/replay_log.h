@@ -0,0 +1,161 @@
+/*********************************************************************
+*
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+#ifndef COSTMAP_REPLAY_LOG_H_
+#define COSTMAP_REPLAY_LOG_H_
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <costmap_2d/observation.h>
+
+namespace costmap_2d {
+  /**
+   * @brief  The parameters a costmap was created with, stored at the start of a replay log so the costmap can be rebuilt offline
+   */
+  struct ReplayConfig {
+    ReplayConfig();
+
+    std::string map_type;
+    unsigned int size_x, size_y;
+    double resolution;
+    double origin_x, origin_y;
+    double inscribed_radius, circumscribed_radius, inflation_radius;
+    double obstacle_range, max_obstacle_height, raytrace_range;
+    double weight;
+    unsigned int lethal_threshold;
+    bool track_unknown_space;
+    unsigned int unknown_cost_value;
+    unsigned int z_voxels;
+    double z_resolution, origin_z;
+    unsigned int unknown_threshold, mark_threshold;
+    bool rolling_window;
+    unsigned int pyramid_levels;
+    double distance_field_max_distance;
+    double obstacle_decay_time;
+    std::vector<unsigned char> static_data; ///< @brief The occupancy data the static map was built from, empty without a static map
+  };
+
+  /**
+   * @brief  Everything a costmap was given in one update cycle
+   */
+  struct ReplayUpdate {
+    double stamp;
+    double robot_x, robot_y;
+    std::vector<Observation> observations;
+    std::vector<Observation> clearing_observations;
+  };
+
+  /**
+   * @class ReplayLogWriter
+   * @brief Records the observations and robot poses a costmap is updated with so they can be replayed without a running system
+   */
+  class ReplayLogWriter {
+    public:
+      ReplayLogWriter();
+      ~ReplayLogWriter();
+
+      /**
+       * @brief  Start a new log, overwriting any existing file
+       * @param filename The file to write to
+       * @param config The parameters of the costmap being recorded
+       * @return True if the file could be opened
+       */
+      bool open(const std::string& filename, const ReplayConfig& config);
+
+      /**
+       * @brief  Check whether or not the log is open for writing
+       * @return True if updates will be recorded
+       */
+      bool isOpen() const { return file_ != NULL; }
+
+      /**
+       * @brief  Append one update cycle to the log
+       * @param stamp The time of the update in seconds
+       * @param robot_x The x position of the robot in the global frame
+       * @param robot_y The y position of the robot in the global frame
+       * @param observations The observations used to mark obstacles
+       * @param clearing_observations The observations used to raytrace freespace
+       */
+      void write(double stamp, double robot_x, double robot_y, const std::vector<Observation>& observations,
+          const std::vector<Observation>& clearing_observations);
+
+      /**
+       * @brief  Flush and close the log
+       */
+      void close();
+
+    private:
+      void writeObservation(const Observation& obs);
+
+      FILE* file_;
+  };
+
+  /**
+   * @class ReplayLogReader
+   * @brief Reads back a log written by a ReplayLogWriter one update at a time
+   */
+  class ReplayLogReader {
+    public:
+      ReplayLogReader();
+      ~ReplayLogReader();
+
+      /**
+       * @brief  Open a log and read the costmap parameters from the start of it
+       * @param filename The file to read from
+       * @param config Will be set to the parameters of the recorded costmap
+       * @return True if the file could be opened and has a valid header
+       */
+      bool open(const std::string& filename, ReplayConfig& config);
+
+      /**
+       * @brief  Read the next update cycle from the log
+       * @param update Will be set to the next update
+       * @return True if an update was read, false at the end of the log or on a malformed entry
+       */
+      bool read(ReplayUpdate& update);
+
+      /**
+       * @brief  Close the log
+       */
+      void close();
+
+    private:
+      bool readObservation(Observation& obs);
+
+      FILE* file_;
+  };
+};
+
+#endif
@@ -147,6 +147,11 @@ namespace costmap_2d {
        */
       virtual void initMaps(unsigned int size_x, unsigned int size_y);
 
+      /**
+       * @brief  Remove an obstacle that has decayed from the costmap along with its column in the voxel grid
+       * @param index The index of the cell
+       */
+      virtual void forgetObstacle(unsigned int index);
 
     private:
       /**
@@ -36,6 +36,13 @@
 *********************************************************************/
 #include <costmap_2d/costmap_2d.h>
 #include <cstdio>
+#include <limits>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define STATIC_MAP_FILE_MAGIC "CMAPSTAT"
+#define STATIC_MAP_FILE_VERSION 1
 
 using namespace std;
 
@@ -49,7 +56,9 @@ namespace costmap_2d{
   costmap_(NULL), markers_(NULL), max_obstacle_range_(max_obstacle_range), 
   max_obstacle_height_(max_obstacle_height), max_raytrace_range_(max_raytrace_range), cached_costs_(NULL), cached_distances_(NULL), 
   inscribed_radius_(inscribed_radius), circumscribed_radius_(circumscribed_radius), inflation_radius_(inflation_radius),
-  weight_(weight), lethal_threshold_(lethal_threshold), track_unknown_space_(track_unknown_space), unknown_cost_value_(unknown_cost_value), inflation_queue_(){
+  weight_(weight), lethal_threshold_(lethal_threshold), track_unknown_space_(track_unknown_space), unknown_cost_value_(unknown_cost_value), inflation_queue_(),
+  pyramid_levels_(0), distance_field_(NULL), distance_field_max_(0.0), obstacle_decay_time_(0.0), obstacle_stamps_(NULL),
+  obstacle_stamp_epoch_(-1.0), obstacle_time_(0.0f){
     //creat the costmap, static_map, and markers
     costmap_ = new unsigned char[size_x_ * size_y_];
     static_map_ = new unsigned char[size_x_ * size_y_];
@@ -316,6 +325,9 @@ namespace costmap_2d{
     delete[] costmap_;
     delete[] static_map_;
     delete[] markers_;
+    deletePyramid();
+    deleteDistanceField();
+    deleteObstacleStamps();
   }
 
   void Costmap2D::deleteKernels(){
@@ -341,6 +353,18 @@ namespace costmap_2d{
 
     //reset markers for inflation
     memset(markers_, 0, size_x_ * size_y_ * sizeof(unsigned char));
+
+    //the pyramid needs to match the new size of the map
+    if(pyramid_levels_ > 0)
+      initPyramid();
+
+    //as does the distance field
+    if(distance_field_max_ > 0.0)
+      initDistanceField();
+
+    //and the obstacle stamps
+    if(obstacle_decay_time_ > 0.0)
+      initObstacleStamps();
   }
 
   void Costmap2D::resetMaps(){
@@ -353,6 +377,7 @@ namespace costmap_2d{
       memset(static_map_, FREE_SPACE, size_x_ * size_y_ * sizeof(unsigned char));
       memset(costmap_, FREE_SPACE, size_x_ * size_y_ * sizeof(unsigned char));
     }
+    markDirty();
   }
   
   void Costmap2D::copyKernels(const Costmap2D& map, unsigned int cell_inflation_radius){
@@ -375,34 +400,89 @@ namespace costmap_2d{
       return;
     }
 
-    //clean up old data
-    deleteMaps();
-    deleteKernels();
-
-    //compute the bounds of our new map
-    unsigned int lower_left_x, lower_left_y, upper_right_x, upper_right_y;
-    if(!map.worldToMap(win_origin_x, win_origin_y, lower_left_x, lower_left_y) 
-        || ! map.worldToMap(win_origin_x + win_size_x, win_origin_y + win_size_y, upper_right_x, upper_right_y)){
+    //compute the cells covered by the window before we touch any of our own data
+    int lower_left_x = (int) floor((win_origin_x - map.origin_x_) / map.resolution_);
+    int lower_left_y = (int) floor((win_origin_y - map.origin_y_) / map.resolution_);
+    int upper_right_x = (int) ceil((win_origin_x + win_size_x - map.origin_x_) / map.resolution_);
+    int upper_right_y = (int) ceil((win_origin_y + win_size_y - map.origin_y_) / map.resolution_);
+    if(lower_left_x < 0 || lower_left_y < 0 || upper_right_x > (int) map.size_x_ || upper_right_y > (int) map.size_y_
+        || upper_right_x <= lower_left_x || upper_right_y <= lower_left_y){
       ROS_ERROR("Cannot window a map that the window bounds don't fit inside of");
       return;
     }
 
-    size_x_ = upper_right_x - lower_left_x;
-    size_y_ = upper_right_y - lower_left_y;
+    unsigned int size_x = upper_right_x - lower_left_x;
+    unsigned int size_y = upper_right_y - lower_left_y;
+
+    //a window of the same size as the last one reuses our maps, so taking a window every cycle doesn't allocate
+    if(costmap_ == NULL || size_x != size_x_ || size_y != size_y_){
+      deleteMaps();
+      size_x_ = size_x;
+      size_y_ = size_y;
+      pyramid_levels_ = map.pyramid_levels_;
+      distance_field_max_ = map.distance_field_max_;
+
+      //initialize our various maps and reset markers for inflation
+      initMaps(size_x_, size_y_);
+    }
+    else{
+      //the derived maps follow those of the map, which may have been turned on or off since the last window
+      if(pyramid_levels_ != map.pyramid_levels_){
+        pyramid_levels_ = map.pyramid_levels_;
+        if(pyramid_levels_ > 0)
+          initPyramid();
+        else
+          deletePyramid();
+      }
+      if(distance_field_max_ != map.distance_field_max_){
+        distance_field_max_ = map.distance_field_max_;
+        if(distance_field_max_ > 0.0)
+          initDistanceField();
+        else
+          deleteDistanceField();
+      }
+
+      memset(markers_, 0, size_x_ * size_y_ * sizeof(unsigned char));
+      markDirty();
+    }
+
+    //the window lines up with the cells of the map, so that its cells don't move around as the window does
     resolution_ = map.resolution_;
-    origin_x_ = win_origin_x;
-    origin_y_ = win_origin_y;
+    origin_x_ = map.origin_x_ + lower_left_x * map.resolution_;
+    origin_y_ = map.origin_y_ + lower_left_y * map.resolution_;
 
     ROS_DEBUG("ll(%d, %d), ur(%d, %d), size(%d, %d), origin(%.2f, %.2f)", 
         lower_left_x, lower_left_y, upper_right_x, upper_right_y, size_x_, size_y_, origin_x_, origin_y_);
 
-
-    //initialize our various maps and reset markers for inflation
-    initMaps(size_x_, size_y_);
-
     //copy the window of the static map and the costmap that we're taking
     copyMapRegion(map.costmap_, lower_left_x, lower_left_y, map.size_x_, costmap_, 0, 0, size_x_, size_x_, size_y_);
     copyMapRegion(map.static_map_, lower_left_x, lower_left_y, map.size_x_, static_map_, 0, 0, size_x_, size_x_, size_y_);
+
+    //the distances near the edges of the window depend on obstacles outside of it, so they're taken from the map
+    //instead of being recomputed, except where the map's own distances are out of date
+    if(distance_field_ != NULL && map.distance_field_ != NULL){
+      copyMapRegion(map.distance_field_, lower_left_x, lower_left_y, map.size_x_, distance_field_, 0, 0, size_x_, size_x_, size_y_);
+      distance_field_dirty_.dirty = false;
+
+      const DirtyRegion& dirty = map.distance_field_dirty_;
+      if(dirty.dirty && (int) dirty.max_x >= lower_left_x && (int) dirty.min_x < upper_right_x 
+          && (int) dirty.max_y >= lower_left_y && (int) dirty.min_y < upper_right_y){
+        distance_field_dirty_.add(max((int) dirty.min_x - lower_left_x, 0), max((int) dirty.min_y - lower_left_y, 0),
+            min((int) dirty.max_x - lower_left_x, (int) size_x_ - 1), min((int) dirty.max_y - lower_left_y, (int) size_y_ - 1));
+      }
+    }
+
+    //copy the cost and distance kernels, they only need to be reallocated when the inflation radius changes
+    if(cached_costs_ != NULL && cached_distances_ != NULL && cell_inflation_radius_ == map.cell_inflation_radius_){
+      for(unsigned int i = 0; i <= cell_inflation_radius_ + 1; ++i){
+        memcpy(cached_costs_[i], map.cached_costs_[i], (cell_inflation_radius_ + 2) * sizeof(unsigned char));
+        memcpy(cached_distances_[i], map.cached_distances_[i], (cell_inflation_radius_ + 2) * sizeof(double));
+      }
+    }
+    else{
+      deleteKernels();
+      copyKernels(map, map.cell_inflation_radius_);
+    }
     
     max_obstacle_range_ = map.max_obstacle_range_;
     max_obstacle_height_ = map.max_obstacle_height_;
@@ -421,8 +501,8 @@ namespace costmap_2d{
 
     weight_ = map.weight_;
 
-    //copy the cost and distance kernels
-    copyKernels(map, cell_inflation_radius_);
+    updatePyramid();
+    updateDistanceField();
   }
 
   Costmap2D& Costmap2D::operator=(const Costmap2D& map) {
@@ -439,6 +519,8 @@ namespace costmap_2d{
     resolution_ = map.resolution_;
     origin_x_ = map.origin_x_;
     origin_y_ = map.origin_y_;
+    pyramid_levels_ = map.pyramid_levels_;
+    distance_field_max_ = map.distance_field_max_;
 
     //initialize our various maps
     initMaps(size_x_, size_y_);
@@ -469,16 +551,28 @@ namespace costmap_2d{
     //copy the cost and distance kernels
     copyKernels(map, cell_inflation_radius_);
 
+    updatePyramid();
+
+    //the distance field is only valid as of the last update of the source, so we'll take it along with what's still dirty
+    if(distance_field_ != NULL){
+      memcpy(distance_field_, map.distance_field_, size_x_ * size_y_ * sizeof(float));
+      distance_field_dirty_ = map.distance_field_dirty_;
+    }
+
     return *this;
   }
 
-  Costmap2D::Costmap2D(const Costmap2D& map) : static_map_(NULL), costmap_(NULL), markers_(NULL), cached_costs_(NULL), cached_distances_(NULL) {
+  Costmap2D::Costmap2D(const Costmap2D& map) : static_map_(NULL), costmap_(NULL), markers_(NULL), cached_costs_(NULL), cached_distances_(NULL),
+  pyramid_levels_(0), distance_field_(NULL), distance_field_max_(0.0), obstacle_decay_time_(0.0), obstacle_stamps_(NULL),
+  obstacle_stamp_epoch_(-1.0), obstacle_time_(0.0f) {
     *this = map;
   }
 
   //just initialize everything to NULL by default
   Costmap2D::Costmap2D() : size_x_(0), size_y_(0), resolution_(0.0), origin_x_(0.0), origin_y_(0.0), static_map_(NULL),
-  costmap_(NULL), markers_(NULL), cached_costs_(NULL), cached_distances_(NULL) {}
+  costmap_(NULL), markers_(NULL), cached_costs_(NULL), cached_distances_(NULL), pyramid_levels_(0),
+  distance_field_(NULL), distance_field_max_(0.0), obstacle_decay_time_(0.0), obstacle_stamps_(NULL),
+  obstacle_stamp_epoch_(-1.0), obstacle_time_(0.0f) {}
 
   Costmap2D::~Costmap2D(){
     deleteMaps();
@@ -502,6 +596,7 @@ namespace costmap_2d{
   void Costmap2D::setCost(unsigned int mx, unsigned int my, unsigned char cost) {
     ROS_ASSERT_MSG(mx < size_x_ && my < size_y_, "You cannot set the cost of a cell that is outside the bounds of the costmap");
     costmap_[getIndex(mx, my)] = cost;
+    markDirty(mx, my, mx, my);
   }
 
   void Costmap2D::mapToWorld(unsigned int mx, unsigned int my, double& wx, double& wy) const {
@@ -565,6 +660,9 @@ namespace costmap_2d{
     //now we want to copy the local map back into the costmap
     copyMapRegion(local_map, 0, 0, cell_size_x, costmap_, start_x, start_y, size_x_, cell_size_x, cell_size_y);
 
+    //everything outside the window may have changed
+    markDirty();
+
     //clean up
     delete[] local_map;
   }
@@ -593,6 +691,10 @@ namespace costmap_2d{
     updateObstacles(observations, inflation_queue_);
 
     inflateObstacles(inflation_queue_);
+
+    //new obstacles can land anywhere within obstacle range and inflate beyond the reset window
+    double dirty_window_size = 2 * (max(max_raytrace_range_, max_obstacle_range_) + 2 * inflation_radius_);
+    markDirtyWindow(robot_x, robot_y, dirty_window_size, dirty_window_size);
   }
   
   void Costmap2D::reinflateWindow(double wx, double wy, double w_size_x, double w_size_y, bool clear){
@@ -608,6 +710,7 @@ namespace costmap_2d{
     //inflate the obstacles
     inflateObstacles(inflation_queue_);
 
+    markDirtyWindow(wx, wy, w_size_x + 2 * inflation_radius_, w_size_y + 2 * inflation_radius_);
   }
 
   void Costmap2D::updateObstacles(const vector<Observation>& observations, priority_queue<CellData>& inflation_queue){
@@ -649,6 +752,7 @@ namespace costmap_2d{
 
         //push the relevant cell index back onto the inflation queue
         enqueue(index, mx, my, mx, my, inflation_queue);
+        stampObstacle(index);
       }
     }
   }
@@ -795,6 +899,8 @@ namespace costmap_2d{
       current += size_x_ - (map_ex - map_sx) - 1;
       index += size_x_ - (map_ex - map_sx) - 1;
     }
+
+    markDirty(map_sx, map_sy, map_ex, map_ey);
   }
 
   void Costmap2D::resetInflationWindow(double wx, double wy, double w_size_x, double w_size_y,
@@ -890,6 +996,9 @@ namespace costmap_2d{
     //now we want to copy the overlapping information back into the map, but in its new location
     copyMapRegion(local_map, 0, 0, cell_size_x, costmap_, start_x, start_y, size_x_, cell_size_x, cell_size_y);
 
+    //the obstacles we've kept need to keep their stamps
+    shiftObstacleStamps(cell_ox, cell_oy);
+
     //make sure to clean up
     delete[] local_map;
 
@@ -933,6 +1042,7 @@ namespace costmap_2d{
     for(unsigned int i = 0; i < polygon_cells.size(); ++i){
       unsigned int index = getIndex(polygon_cells[i].x, polygon_cells[i].y);
       costmap_[index] = cost_value;
+      markDirty(polygon_cells[i].x, polygon_cells[i].y, polygon_cells[i].x, polygon_cells[i].y);
     }
     return true;
   }
@@ -1081,4 +1191,535 @@ namespace costmap_2d{
     fclose(fp);
   }
 
+  static bool readFully(int fd, void* buffer, size_t bytes){
+    unsigned char* dest = (unsigned char*) buffer;
+    while(bytes > 0){
+      ssize_t got = read(fd, dest, bytes);
+      if(got <= 0)
+        return false;
+      dest += got;
+      bytes -= got;
+    }
+    return true;
+  }
+
+  void Costmap2D::fillStaticMapHeader(StaticMapFileHeader& header, uint64_t source_checksum) const {
+    //zero everything first so that padding bytes are deterministic on disk
+    memset(&header, 0, sizeof(StaticMapFileHeader));
+    memcpy(header.magic, STATIC_MAP_FILE_MAGIC, sizeof(header.magic));
+    header.version = STATIC_MAP_FILE_VERSION;
+    header.size_x = size_x_;
+    header.size_y = size_y_;
+    header.resolution = resolution_;
+    header.origin_x = origin_x_;
+    header.origin_y = origin_y_;
+    header.inscribed_radius = inscribed_radius_;
+    header.circumscribed_radius = circumscribed_radius_;
+    header.inflation_radius = inflation_radius_;
+    header.weight = weight_;
+    header.lethal_threshold = lethal_threshold_;
+    header.track_unknown_space = track_unknown_space_;
+    header.unknown_cost_value = unknown_cost_value_;
+    header.source_checksum = source_checksum;
+  }
+
+  bool Costmap2D::saveStaticMap(const std::string& file_name, uint64_t source_checksum) const {
+    //write to a temporary file and move it into place so that a reader never sees a partial cache
+    std::string tmp_name = file_name + ".tmp";
+    FILE *fp = fopen(tmp_name.c_str(), "wb");
+
+    if(!fp){
+      ROS_WARN("Can't open file %s", tmp_name.c_str());
+      return false;
+    }
+
+    StaticMapFileHeader header;
+    fillStaticMapHeader(header, source_checksum);
+
+    size_t map_bytes = size_x_ * size_y_ * sizeof(unsigned char);
+    bool written = fwrite(&header, sizeof(StaticMapFileHeader), 1, fp) == 1
+      && fwrite(static_map_, sizeof(unsigned char), map_bytes, fp) == map_bytes;
+
+    if(fclose(fp) != 0 || !written || rename(tmp_name.c_str(), file_name.c_str()) != 0){
+      ROS_WARN("Failed to write the static map cache %s", file_name.c_str());
+      unlink(tmp_name.c_str());
+      return false;
+    }
+
+    return true;
+  }
+
+  bool Costmap2D::loadStaticMap(const std::string& file_name, uint64_t source_checksum){
+    int fd = open(file_name.c_str(), O_RDONLY);
+    if(fd < 0){
+      ROS_DEBUG("Can't open static map cache %s", file_name.c_str());
+      return false;
+    }
+
+    size_t map_bytes = size_x_ * size_y_ * sizeof(unsigned char);
+    size_t file_bytes = sizeof(StaticMapFileHeader) + map_bytes;
+
+    struct stat file_stat;
+    if(fstat(fd, &file_stat) != 0 || (size_t)file_stat.st_size != file_bytes){
+      ROS_WARN("The static map cache %s does not match the size of the costmap, ignoring it", file_name.c_str());
+      close(fd);
+      return false;
+    }
+
+    StaticMapFileHeader expected, header;
+    fillStaticMapHeader(expected, source_checksum);
+
+    //the cache is only good if it was built from the same map with the same inflation parameters
+    if(!readFully(fd, &header, sizeof(StaticMapFileHeader)) || memcmp(&header, &expected, sizeof(StaticMapFileHeader)) != 0){
+      ROS_WARN("The static map cache %s was built from a different map or with different parameters, ignoring it", file_name.c_str());
+      close(fd);
+      return false;
+    }
+
+    //read straight into the static layer, a short read leaves it half written so we restore it from the costmap
+    bool loaded = readFully(fd, static_map_, map_bytes);
+    close(fd);
+
+    if(!loaded){
+      ROS_WARN("Failed to read the static map cache %s", file_name.c_str());
+      memcpy(static_map_, costmap_, map_bytes);
+      return false;
+    }
+
+    memcpy(costmap_, static_map_, map_bytes);
+    markDirty();
+    return true;
+  }
+
+  void Costmap2D::setPyramidLevels(unsigned int levels){
+    pyramid_levels_ = levels;
+    if(pyramid_levels_ > 0){
+      initPyramid();
+      updatePyramid();
+    }
+    else
+      deletePyramid();
+  }
+
+  void Costmap2D::initPyramid(){
+    deletePyramid();
+
+    pyramid_size_x_.push_back(size_x_);
+    pyramid_size_y_.push_back(size_y_);
+
+    //each level halves the size of the one below it, rounding up so that every cell has a parent
+    for(unsigned int k = 1; k <= pyramid_levels_; ++k){
+      unsigned int level_size_x = (pyramid_size_x_[k - 1] + 1) / 2;
+      unsigned int level_size_y = (pyramid_size_y_[k - 1] + 1) / 2;
+      pyramid_size_x_.push_back(level_size_x);
+      pyramid_size_y_.push_back(level_size_y);
+      pyramid_.push_back(new unsigned char[level_size_x * level_size_y]);
+    }
+
+    pyramid_dirty_.add(0, 0, size_x_ - 1, size_y_ - 1);
+  }
+
+  void Costmap2D::deletePyramid(){
+    for(unsigned int i = 0; i < pyramid_.size(); ++i)
+      delete[] pyramid_[i];
+
+    pyramid_.clear();
+    pyramid_size_x_.clear();
+    pyramid_size_y_.clear();
+    pyramid_dirty_.dirty = false;
+  }
+
+  void Costmap2D::markDirty(){
+    if(size_x_ == 0 || size_y_ == 0)
+      return;
+
+    markDirty(0, 0, size_x_ - 1, size_y_ - 1);
+  }
+
+  void Costmap2D::markDirtyWindow(double wx, double wy, double w_size_x, double w_size_y){
+    if((pyramid_levels_ == 0 && distance_field_ == NULL) || size_x_ == 0 || size_y_ == 0)
+      return;
+
+    int start_x = (int) floor((wx - w_size_x / 2 - origin_x_) / resolution_);
+    int start_y = (int) floor((wy - w_size_y / 2 - origin_y_) / resolution_);
+    int end_x = (int) floor((wx + w_size_x / 2 - origin_x_) / resolution_);
+    int end_y = (int) floor((wy + w_size_y / 2 - origin_y_) / resolution_);
+
+    //nothing to do if the window is completely off the map
+    if(end_x < 0 || end_y < 0 || start_x >= (int)size_x_ || start_y >= (int)size_y_)
+      return;
+
+    markDirty(max(start_x, 0), max(start_y, 0), min(end_x, (int)size_x_ - 1), min(end_y, (int)size_y_ - 1));
+  }
+
+  void Costmap2D::updatePyramid(){
+    if(pyramid_levels_ == 0 || !pyramid_dirty_.dirty)
+      return;
+
+    unsigned int x0 = pyramid_dirty_.min_x;
+    unsigned int y0 = pyramid_dirty_.min_y;
+    unsigned int x1 = pyramid_dirty_.max_x;
+    unsigned int y1 = pyramid_dirty_.max_y;
+
+    for(unsigned int k = 1; k <= pyramid_levels_; ++k){
+      const unsigned char* fine = k == 1 ? costmap_ : pyramid_[k - 2];
+      unsigned char* coarse = pyramid_[k - 1];
+      unsigned int fine_size_x = pyramid_size_x_[k - 1];
+      unsigned int fine_size_y = pyramid_size_y_[k - 1];
+      unsigned int coarse_size_x = pyramid_size_x_[k];
+
+      //the dirty region at this level is just the parents of the dirty region below
+      x0 /= 2;
+      y0 /= 2;
+      x1 /= 2;
+      y1 /= 2;
+
+      for(unsigned int cy = y0; cy <= y1; ++cy){
+        const unsigned char* row0 = fine + 2 * cy * fine_size_x;
+        //the last row of an odd sized level has no partner
+        const unsigned char* row1 = 2 * cy + 1 < fine_size_y ? row0 + fine_size_x : row0;
+        unsigned char* coarse_row = coarse + cy * coarse_size_x;
+        for(unsigned int cx = x0; cx <= x1; ++cx){
+          unsigned int fx0 = 2 * cx;
+          unsigned int fx1 = fx0 + 1 < fine_size_x ? fx0 + 1 : fx0;
+          coarse_row[cx] = max(max(row0[fx0], row0[fx1]), max(row1[fx0], row1[fx1]));
+        }
+      }
+    }
+
+    pyramid_dirty_.dirty = false;
+  }
+
+  unsigned int Costmap2D::getPyramidSizeInCellsX(unsigned int level) const {
+    if(level == 0)
+      return size_x_;
+    ROS_ASSERT_MSG(level <= pyramid_levels_, "You cannot get the size of a pyramid level that does not exist");
+    return pyramid_size_x_[level];
+  }
+
+  unsigned int Costmap2D::getPyramidSizeInCellsY(unsigned int level) const {
+    if(level == 0)
+      return size_y_;
+    ROS_ASSERT_MSG(level <= pyramid_levels_, "You cannot get the size of a pyramid level that does not exist");
+    return pyramid_size_y_[level];
+  }
+
+  unsigned char Costmap2D::getCoarseCost(unsigned int level, unsigned int cx, unsigned int cy) const {
+    if(level == 0)
+      return getCost(cx, cy);
+
+    ROS_ASSERT_MSG(level <= pyramid_levels_, "You cannot get the cost of a pyramid level that does not exist");
+    ROS_ASSERT_MSG(cx < pyramid_size_x_[level] && cy < pyramid_size_y_[level], "You cannot get the cost of a cell that is outside the bounds of the pyramid level");
+    return pyramid_[level - 1][cy * pyramid_size_x_[level] + cx];
+  }
+
+  bool Costmap2D::getMaxCostInBox(double wx0, double wy0, double wx1, double wy1, unsigned char& cost) const {
+    if(size_x_ == 0 || size_y_ == 0)
+      return false;
+
+    int start_x = (int) floor((min(wx0, wx1) - origin_x_) / resolution_);
+    int start_y = (int) floor((min(wy0, wy1) - origin_y_) / resolution_);
+    int end_x = (int) floor((max(wx0, wx1) - origin_x_) / resolution_);
+    int end_y = (int) floor((max(wy0, wy1) - origin_y_) / resolution_);
+
+    if(end_x < 0 || end_y < 0 || start_x >= (int)size_x_ || start_y >= (int)size_y_)
+      return false;
+
+    unsigned int sx = max(start_x, 0);
+    unsigned int sy = max(start_y, 0);
+    unsigned int ex = min(end_x, (int)size_x_ - 1);
+    unsigned int ey = min(end_y, (int)size_y_ - 1);
+
+    //pick the finest level at which the box spans no more than two cells in each direction
+    unsigned int span = max(ex - sx, ey - sy) + 1;
+    unsigned int level = 0;
+    while(level < pyramid_levels_ && (1u << level) < span)
+      ++level;
+
+    //if the pyramid isn't tall enough we'll have to look at more cells at the top level
+    cost = FREE_SPACE;
+    for(unsigned int cy = sy >> level; cy <= ey >> level; ++cy){
+      for(unsigned int cx = sx >> level; cx <= ex >> level; ++cx){
+        cost = max(cost, getCoarseCost(level, cx, cy));
+      }
+    }
+    return true;
+  }
+
+  void Costmap2D::enableDistanceField(double max_distance){
+    if(max_distance <= 0.0){
+      ROS_ERROR("The maximum distance of the distance field must be positive, not %.2f", max_distance);
+      return;
+    }
+
+    distance_field_max_ = max_distance;
+    initDistanceField();
+    updateDistanceField();
+  }
+
+  void Costmap2D::disableDistanceField(){
+    distance_field_max_ = 0.0;
+    deleteDistanceField();
+  }
+
+  void Costmap2D::initDistanceField(){
+    deleteDistanceField();
+
+    if(size_x_ == 0 || size_y_ == 0)
+      return;
+
+    distance_field_ = new float[size_x_ * size_y_];
+    distance_field_dirty_.add(0, 0, size_x_ - 1, size_y_ - 1);
+  }
+
+  void Costmap2D::deleteDistanceField(){
+    delete[] distance_field_;
+    distance_field_ = NULL;
+    distance_field_dirty_.dirty = false;
+
+    //we don't want to hang on to scratch space sized for a full map update
+    std::vector<float>().swap(edt_grid_);
+  }
+
+  double Costmap2D::getDistance(unsigned int mx, unsigned int my) const {
+    ROS_ASSERT_MSG(distance_field_ != NULL, "You cannot get a distance from a costmap that is not maintaining a distance field");
+    return distance_field_[getIndex(mx, my)];
+  }
+
+  const float* Costmap2D::getDistanceField() const {
+    return distance_field_;
+  }
+
+  void Costmap2D::updateDistanceField(){
+    if(distance_field_ == NULL || !distance_field_dirty_.dirty)
+      return;
+
+    //cells within the maximum distance of a change may have a new distance, and computing those exactly
+    //requires looking at the cells within the maximum distance of them in turn
+    int cell_max = (int) cellDistance(distance_field_max_) + 1;
+
+    unsigned int rx0 = max((int)distance_field_dirty_.min_x - cell_max, 0);
+    unsigned int ry0 = max((int)distance_field_dirty_.min_y - cell_max, 0);
+    unsigned int rx1 = min((int)distance_field_dirty_.max_x + cell_max, (int)size_x_ - 1);
+    unsigned int ry1 = min((int)distance_field_dirty_.max_y + cell_max, (int)size_y_ - 1);
+
+    unsigned int wx0 = max((int)rx0 - cell_max, 0);
+    unsigned int wy0 = max((int)ry0 - cell_max, 0);
+    unsigned int wx1 = min((int)rx1 + cell_max, (int)size_x_ - 1);
+    unsigned int wy1 = min((int)ry1 + cell_max, (int)size_y_ - 1);
+
+    unsigned int w_size_x = wx1 - wx0 + 1;
+    unsigned int w_size_y = wy1 - wy0 + 1;
+
+    //anything further than this saturates anyway, and capping distances keeps the squared values exact in floats
+    float max_sq_dist = (float)((cell_max + 1) * (cell_max + 1));
+    float max_dist = (float) distance_field_max_;
+    float resolution = (float) resolution_;
+
+    //first... the distance from free space to the nearest obstacle
+    distanceTransformWindow(wx0, wy0, w_size_x, w_size_y, true, max_sq_dist);
+    for(unsigned int j = ry0; j <= ry1; ++j){
+      const float* grid_row = &edt_grid_[(j - wy0) * w_size_x];
+      unsigned int index = getIndex(rx0, j);
+      for(unsigned int i = rx0; i <= rx1; ++i, ++index){
+        if(costmap_[index] != LETHAL_OBSTACLE)
+          distance_field_[index] = min(sqrtf(grid_row[i - wx0]) * resolution, max_dist);
+      }
+    }
+
+    //then... the distance from inside an obstacle to the nearest free space
+    distanceTransformWindow(wx0, wy0, w_size_x, w_size_y, false, max_sq_dist);
+    for(unsigned int j = ry0; j <= ry1; ++j){
+      const float* grid_row = &edt_grid_[(j - wy0) * w_size_x];
+      unsigned int index = getIndex(rx0, j);
+      for(unsigned int i = rx0; i <= rx1; ++i, ++index){
+        if(costmap_[index] == LETHAL_OBSTACLE)
+          distance_field_[index] = -min(sqrtf(grid_row[i - wx0]) * resolution, max_dist);
+      }
+    }
+
+    distance_field_dirty_.dirty = false;
+  }
+
+  void Costmap2D::distanceTransformWindow(unsigned int x0, unsigned int y0, unsigned int size_x, unsigned int size_y,
+      bool to_obstacles, float max_sq_dist){
+    edt_grid_.resize(size_x * size_y);
+
+    unsigned int line_size = max(size_x, size_y);
+    edt_f_.resize(line_size);
+    edt_z_.resize(line_size + 1);
+    edt_v_.resize(line_size);
+
+    //seed the grid with zero at the cells we're measuring distance to
+    for(unsigned int j = 0; j < size_y; ++j){
+      const unsigned char* cost_row = costmap_ + getIndex(x0, y0 + j);
+      float* grid_row = &edt_grid_[j * size_x];
+      for(unsigned int i = 0; i < size_x; ++i){
+        bool lethal = cost_row[i] == LETHAL_OBSTACLE;
+        grid_row[i] = lethal == to_obstacles ? 0.0f : max_sq_dist;
+      }
+    }
+
+    //the transform is separable... so we'll run it down the columns and then along the rows
+    for(unsigned int i = 0; i < size_x; ++i)
+      distanceTransform1D(&edt_grid_[i], size_y, size_x, &edt_grid_[i]);
+
+    for(unsigned int j = 0; j < size_y; ++j)
+      distanceTransform1D(&edt_grid_[j * size_x], size_x, 1, &edt_grid_[j * size_x]);
+  }
+
+  void Costmap2D::distanceTransform1D(float* f, unsigned int n, unsigned int stride, float* d){
+    //gather the input so that we can write the output in place
+    for(unsigned int q = 0; q < n; ++q)
+      edt_f_[q] = f[q * stride];
+
+    //compute the lower envelope of the parabolas rooted at each sample
+    int k = 0;
+    edt_v_[0] = 0;
+    edt_z_[0] = -std::numeric_limits<float>::max();
+    edt_z_[1] = std::numeric_limits<float>::max();
+    for(int q = 1; q < (int)n; ++q){
+      float s = ((edt_f_[q] + q * q) - (edt_f_[edt_v_[k]] + edt_v_[k] * edt_v_[k])) / (2 * q - 2 * edt_v_[k]);
+      while(s <= edt_z_[k]){
+        --k;
+        s = ((edt_f_[q] + q * q) - (edt_f_[edt_v_[k]] + edt_v_[k] * edt_v_[k])) / (2 * q - 2 * edt_v_[k]);
+      }
+      ++k;
+      edt_v_[k] = q;
+      edt_z_[k] = s;
+      edt_z_[k + 1] = std::numeric_limits<float>::max();
+    }
+
+    //and read the transform off of the envelope
+    k = 0;
+    for(int q = 0; q < (int)n; ++q){
+      while(edt_z_[k + 1] < q)
+        ++k;
+      int offset = q - edt_v_[k];
+      d[q * stride] = offset * offset + edt_f_[edt_v_[k]];
+    }
+  }
+
+  void Costmap2D::setObstacleDecayTime(double decay_time){
+    if(decay_time < 0.0){
+      ROS_ERROR("The obstacle decay time must not be negative, not %.2f", decay_time);
+      return;
+    }
+
+    obstacle_decay_time_ = decay_time;
+    if(obstacle_decay_time_ > 0.0){
+      if(obstacle_stamps_ == NULL)
+        initObstacleStamps();
+    }
+    else
+      deleteObstacleStamps();
+  }
+
+  void Costmap2D::initObstacleStamps(){
+    deleteObstacleStamps();
+
+    if(size_x_ == 0 || size_y_ == 0)
+      return;
+
+    obstacle_stamps_ = new float[size_x_ * size_y_];
+    std::fill(obstacle_stamps_, obstacle_stamps_ + size_x_ * size_y_, -1.0f);
+  }
+
+  void Costmap2D::deleteObstacleStamps(){
+    delete[] obstacle_stamps_;
+    obstacle_stamps_ = NULL;
+    decay_cells_.clear();
+  }
+
+  void Costmap2D::decayObstacles(double now){
+    if(obstacle_stamps_ == NULL)
+      return;
+
+    //stamps are kept as floats relative to the first time we're given, which is plenty of precision for decay
+    if(obstacle_stamp_epoch_ < 0.0)
+      obstacle_stamp_epoch_ = now;
+
+    obstacle_time_ = (float) (now - obstacle_stamp_epoch_);
+    float expire_time = obstacle_time_ - (float) obstacle_decay_time_;
+
+    DirtyRegion forgotten;
+    unsigned int i = 0;
+    while(i < decay_cells_.size()){
+      unsigned int index = decay_cells_[i];
+      if(obstacle_stamps_[index] > expire_time){
+        ++i;
+        continue;
+      }
+
+      //stop tracking the cell
+      obstacle_stamps_[index] = -1.0f;
+      decay_cells_[i] = decay_cells_.back();
+      decay_cells_.pop_back();
+
+      //the obstacle may have already been cleared by raytracing
+      if(costmap_[index] != LETHAL_OBSTACLE)
+        continue;
+
+      forgetObstacle(index);
+
+      unsigned int mx, my;
+      indexToCells(index, mx, my);
+      forgotten.add(mx, my, mx, my);
+    }
+
+    if(!forgotten.dirty)
+      return;
+
+    //the inflation around the forgotten obstacles has to go with them... so we'll clear and reinflate around them
+    double ll_x, ll_y, ur_x, ur_y;
+    mapToWorld(forgotten.min_x, forgotten.min_y, ll_x, ll_y);
+    mapToWorld(forgotten.max_x, forgotten.max_y, ur_x, ur_y);
+    double mid_x = (ll_x + ur_x) / 2;
+    double mid_y = (ll_y + ur_y) / 2;
+    double clear_size_x = ur_x - ll_x + 2 * (inflation_radius_ + resolution_);
+    double clear_size_y = ur_y - ll_y + 2 * (inflation_radius_ + resolution_);
+
+    clearNonLethal(mid_x, mid_y, clear_size_x, clear_size_y);
+    reinflateWindow(mid_x, mid_y, clear_size_x + 2 * (inflation_radius_ + resolution_),
+        clear_size_y + 2 * (inflation_radius_ + resolution_), false);
+  }
+
+  void Costmap2D::forgetObstacle(unsigned int index){
+    //fall back to what the static map knows about the cell, keeping its obstacles and unknown space
+    unsigned char static_cost = static_map_[index];
+    if(static_cost == LETHAL_OBSTACLE || static_cost == NO_INFORMATION)
+      costmap_[index] = static_cost;
+    else
+      costmap_[index] = FREE_SPACE;
+  }
+
+  void Costmap2D::shiftObstacleStamps(int cell_ox, int cell_oy){
+    if(obstacle_stamps_ == NULL)
+      return;
+
+    std::vector<unsigned int> old_cells;
+    old_cells.swap(decay_cells_);
+
+    //pull the stamps out before we overwrite any of them
+    std::vector<float> old_stamps(old_cells.size());
+    for(unsigned int i = 0; i < old_cells.size(); ++i){
+      old_stamps[i] = obstacle_stamps_[old_cells[i]];
+      obstacle_stamps_[old_cells[i]] = -1.0f;
+    }
+
+    //and put back the ones that are still on the map in their new location
+    for(unsigned int i = 0; i < old_cells.size(); ++i){
+      unsigned int mx, my;
+      indexToCells(old_cells[i], mx, my);
+      int new_x = (int)mx - cell_ox;
+      int new_y = (int)my - cell_oy;
+      if(new_x < 0 || new_y < 0 || new_x >= (int)size_x_ || new_y >= (int)size_y_)
+        continue;
+
+      unsigned int index = getIndex(new_x, new_y);
+      obstacle_stamps_[index] = old_stamps[i];
+      decay_cells_.push_back(index);
+    }
+  }
+
 };
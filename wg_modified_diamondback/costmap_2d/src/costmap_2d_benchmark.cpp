@@ -0,0 +1,226 @@
+/*********************************************************************
+*
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+#include <costmap_2d/costmap_2d.h>
+#include <costmap_2d/voxel_costmap_2d.h>
+#include <costmap_2d/replay_log.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace costmap_2d;
+
+struct Stage {
+  Stage(const string& stage_name) : name(stage_name) {}
+  string name;
+  vector<double> samples;
+};
+
+double wallTime(){
+  struct timeval t;
+  gettimeofday(&t, NULL);
+  return t.tv_sec + double(t.tv_usec) / 1e6;
+}
+
+//the resident set size of the process in kilobytes
+long residentKB(){
+  long pages = 0, resident = 0;
+  FILE* statm = fopen("/proc/self/statm", "r");
+  if(statm == NULL)
+    return 0;
+  if(fscanf(statm, "%ld %ld", &pages, &resident) != 2)
+    resident = 0;
+  fclose(statm);
+  return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+double percentile(const vector<double>& sorted, double p){
+  if(sorted.empty())
+    return 0.0;
+  unsigned int rank = (unsigned int)(p * (sorted.size() - 1) + 0.5);
+  return sorted[rank];
+}
+
+void printStage(Stage& stage){
+  if(stage.samples.empty())
+    return;
+
+  sort(stage.samples.begin(), stage.samples.end());
+  double sum = 0.0;
+  for(unsigned int i = 0; i < stage.samples.size(); ++i)
+    sum += stage.samples[i];
+
+  //report in milliseconds
+  printf("%-16s %8u %9.3f %9.3f %9.3f %9.3f %9.3f\n", stage.name.c_str(), (unsigned int)stage.samples.size(),
+      1e3 * sum / stage.samples.size(), 1e3 * percentile(stage.samples, 0.5), 1e3 * percentile(stage.samples, 0.9),
+      1e3 * percentile(stage.samples, 0.99), 1e3 * stage.samples.back());
+}
+
+//build the costmap a log was recorded from, including its static map, or NULL if it can't be built
+Costmap2D* createCostmap(const string& map_type, const ReplayConfig& config){
+  Costmap2D* costmap = NULL;
+  if(map_type == "costmap"){
+    costmap = new Costmap2D(config.size_x, config.size_y, config.resolution, config.origin_x, config.origin_y,
+        config.inscribed_radius, config.circumscribed_radius, config.inflation_radius, config.obstacle_range,
+        config.max_obstacle_height, config.raytrace_range, config.weight, config.static_data, config.lethal_threshold,
+        config.track_unknown_space, config.unknown_cost_value);
+  }
+  else if(map_type == "voxel"){
+    if(config.z_voxels == 0){
+      fprintf(stderr, "The log was not recorded from a voxel costmap, so there are no voxel parameters to use\n");
+      return NULL;
+    }
+    costmap = new VoxelCostmap2D(config.size_x, config.size_y, config.z_voxels, config.resolution, config.z_resolution,
+        config.origin_x, config.origin_y, config.origin_z, config.inscribed_radius, config.circumscribed_radius,
+        config.inflation_radius, config.obstacle_range, config.raytrace_range, config.weight, config.static_data,
+        config.lethal_threshold, config.unknown_threshold, config.mark_threshold, config.unknown_cost_value);
+  }
+  else{
+    fprintf(stderr, "Unknown map type %s\n", map_type.c_str());
+    return NULL;
+  }
+
+  if(config.pyramid_levels > 0)
+    costmap->setPyramidLevels(config.pyramid_levels);
+  if(config.distance_field_max_distance > 0.0)
+    costmap->enableDistanceField(config.distance_field_max_distance);
+  if(config.obstacle_decay_time > 0.0)
+    costmap->setObstacleDecayTime(config.obstacle_decay_time);
+  return costmap;
+}
+
+int main(int argc, char** argv){
+  if(argc < 2){
+    fprintf(stderr, "Usage: %s <replay_log> [costmap|voxel] [passes]\n", argv[0]);
+    fprintf(stderr, "Replays a log recorded with the replay_log parameter of costmap_2d and reports update latencies\n");
+    return 1;
+  }
+
+  string log_file = argv[1];
+  int passes = argc > 3 ? atoi(argv[3]) : 1;
+
+  ReplayLogReader reader;
+  ReplayConfig config;
+  if(!reader.open(log_file, config))
+    return 1;
+
+  //allow the same data to be run through either type of costmap
+  string map_type = argc > 2 ? argv[2] : config.map_type;
+
+  long rss_start = residentKB();
+
+  Costmap2D* costmap = createCostmap(map_type, config);
+  if(costmap == NULL)
+    return 1;
+
+  long rss_costmap = residentKB();
+
+  Stage origin_stage("updateOrigin"), decay_stage("decayObstacles"), world_stage("updateWorld"),
+        pyramid_stage("updatePyramid"), distance_stage("updateDistance"), total_stage("total");
+  unsigned int num_points = 0;
+
+  ReplayUpdate update;
+  for(int pass = 0; pass < passes; ++pass){
+    //every pass starts from the freshly built costmap, otherwise the obstacles and decay stamps of the last pass would
+    //carry over and the rolling window would start wherever the last pass left it
+    if(pass > 0){
+      ReplayConfig pass_config;
+      if(!reader.open(log_file, pass_config))
+        return 1;
+      delete costmap;
+      costmap = createCostmap(map_type, config);
+    }
+
+    while(reader.read(update)){
+      for(unsigned int i = 0; i < update.observations.size(); ++i)
+        num_points += update.observations[i].cloud_.points.size();
+
+      double start_t = wallTime();
+      if(config.rolling_window){
+        double origin_x = update.robot_x - costmap->getSizeInMetersX() / 2;
+        double origin_y = update.robot_y - costmap->getSizeInMetersY() / 2;
+        costmap->updateOrigin(origin_x, origin_y);
+        origin_stage.samples.push_back(wallTime() - start_t);
+      }
+
+      double stage_t = wallTime();
+      if(config.obstacle_decay_time > 0.0){
+        costmap->decayObstacles(update.stamp);
+        decay_stage.samples.push_back(wallTime() - stage_t);
+      }
+
+      stage_t = wallTime();
+      costmap->updateWorld(update.robot_x, update.robot_y, update.observations, update.clearing_observations);
+      world_stage.samples.push_back(wallTime() - stage_t);
+
+      if(config.pyramid_levels > 0){
+        stage_t = wallTime();
+        costmap->updatePyramid();
+        pyramid_stage.samples.push_back(wallTime() - stage_t);
+      }
+
+      if(costmap->hasDistanceField()){
+        stage_t = wallTime();
+        costmap->updateDistanceField();
+        distance_stage.samples.push_back(wallTime() - stage_t);
+      }
+
+      total_stage.samples.push_back(wallTime() - start_t);
+    }
+  }
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  printf("map type %s, %u x %u cells at %.3f m, %u updates, %.1f marking points per update\n", map_type.c_str(),
+      config.size_x, config.size_y, config.resolution, (unsigned int)total_stage.samples.size(),
+      total_stage.samples.empty() ? 0.0 : double(num_points) / total_stage.samples.size());
+  printf("%-16s %8s %9s %9s %9s %9s %9s\n", "stage (ms)", "samples", "mean", "p50", "p90", "p99", "max");
+  printStage(origin_stage);
+  printStage(decay_stage);
+  printStage(world_stage);
+  printStage(pyramid_stage);
+  printStage(distance_stage);
+  printStage(total_stage);
+  printf("memory: costmap %ld KB, resident at end %ld KB, peak resident %ld KB\n", rss_costmap - rss_start, residentKB(), usage.ru_maxrss);
+
+  delete costmap;
+  return 0;
+}
@@ -48,6 +48,16 @@ namespace costmap_2d {
     return x < 0.0 ? -1.0 : 1.0;
   }
 
+  //FNV-1a over the occupancy data, used to detect a static map cache built from a different map
+  uint64_t occupancyChecksum(const nav_msgs::OccupancyGrid& map){
+    uint64_t hash = 14695981039346656037ULL;
+    for(unsigned int i = 0; i < map.data.size(); ++i){
+      hash ^= (unsigned char) map.data[i];
+      hash *= 1099511628211ULL;
+    }
+    return hash;
+  }
+
   Costmap2DROS::Costmap2DROS(std::string name, tf::TransformListener& tf) : name_(name), tf_(tf), costmap_(NULL), 
                              map_update_thread_(NULL), costmap_publisher_(NULL), stop_updates_(false), 
                              initialized_(true), stopped_(false), map_update_thread_shutdown_(false), 
@@ -92,6 +102,9 @@ namespace costmap_2d {
 
     private_nh.param("static_map", static_map, true);
 
+    //a pre-inflated copy of the static map lets us skip inflation when restarting on a large map
+    private_nh.param("static_map_cache", static_map_cache_, std::string(""));
+
     //check if we want a rolling window version of the costmap
     private_nh.param("rolling_window", rolling_window_, false);
 
@@ -312,6 +325,21 @@ namespace costmap_2d {
     bool track_unknown_space;
     private_nh.param("track_unknown_space", track_unknown_space, false);
 
+    //everything we need to rebuild this costmap offline if we're recording its updates
+    ReplayConfig replay_config;
+    replay_config.map_type = map_type;
+    replay_config.inscribed_radius = inscribed_radius;
+    replay_config.circumscribed_radius = circumscribed_radius;
+    replay_config.inflation_radius = inflation_radius;
+    replay_config.obstacle_range = obstacle_range;
+    replay_config.max_obstacle_height = max_obstacle_height;
+    replay_config.raytrace_range = raytrace_range;
+    replay_config.weight = cost_scale;
+    replay_config.lethal_threshold = lethal_threshold;
+    replay_config.track_unknown_space = track_unknown_space;
+    replay_config.unknown_cost_value = unknown_cost_value;
+    replay_config.rolling_window = rolling_window_;
+
     struct timeval start, end;
     double start_t, end_t, t_diff;
     gettimeofday(&start, NULL);
@@ -340,6 +368,12 @@ namespace costmap_2d {
         throw std::runtime_error("Values for z_voxels, unknown_threshold, and mark_threshold parameters must be positive.");
       }
 
+      replay_config.z_voxels = z_voxels;
+      replay_config.z_resolution = z_resolution;
+      replay_config.origin_z = map_origin_z;
+      replay_config.unknown_threshold = unknown_threshold;
+      replay_config.mark_threshold = mark_threshold;
+
       //make sure to lock the map data
       boost::recursive_mutex::scoped_lock lock(map_data_lock_);
       costmap_ = new VoxelCostmap2D(map_width, map_height, z_voxels, map_resolution, z_resolution, map_origin_x, map_origin_y, map_origin_z, inscribed_radius,
@@ -351,6 +385,71 @@ namespace costmap_2d {
       throw std::runtime_error("Unsuported map type");
     }
 
+    //if we're caching the static map, the costmap was created empty and we'll fill it from the cache if we can
+    if(static_map_msg_){
+      boost::recursive_mutex::scoped_lock lock(map_data_lock_);
+      uint64_t checksum = occupancyChecksum(*static_map_msg_);
+      if(costmap_->loadStaticMap(static_map_cache_, checksum)){
+        ROS_INFO("Loaded the inflated static map from %s", static_map_cache_.c_str());
+      }
+      else{
+        ROS_INFO("No usable static map cache at %s, inflating the static map and writing a new cache", static_map_cache_.c_str());
+        initFromMap(*static_map_msg_);
+        costmap_->replaceFullMap(map_origin_x, map_origin_y, map_width, map_height, input_data_);
+        costmap_->saveStaticMap(static_map_cache_, checksum);
+      }
+    }
+
+    //optionally keep max-pooled coarse levels of the costmap for hierarchical planning and fast region queries
+    int pyramid_levels;
+    private_nh.param("pyramid_levels", pyramid_levels, 0);
+    if(pyramid_levels > 0)
+      costmap_->setPyramidLevels(pyramid_levels);
+
+    //optionally keep the exact metric clearance of every cell from the nearest obstacle
+    bool distance_field;
+    private_nh.param("distance_field", distance_field, false);
+    if(distance_field){
+      double distance_field_max_distance;
+      private_nh.param("distance_field_max_distance", distance_field_max_distance, inflation_radius);
+      costmap_->enableDistanceField(distance_field_max_distance);
+    }
+
+    //optionally forget obstacles that haven't been seen in a while, which lets observation_persistence stay at zero
+    //without losing track of transient obstacles as soon as they drop out of view
+    double obstacle_decay_time;
+    private_nh.param("obstacle_decay_time", obstacle_decay_time, 0.0);
+    if(obstacle_decay_time > 0.0)
+      costmap_->setObstacleDecayTime(obstacle_decay_time);
+
+    //optionally record what the costmap is updated with so that costmap_2d_benchmark can replay it offline
+    std::string replay_log;
+    private_nh.param("replay_log", replay_log, std::string(""));
+    if(replay_log != ""){
+      replay_config.size_x = costmap_->getSizeInCellsX();
+      replay_config.size_y = costmap_->getSizeInCellsY();
+      replay_config.resolution = costmap_->getResolution();
+      replay_config.origin_x = costmap_->getOriginX();
+      replay_config.origin_y = costmap_->getOriginY();
+      replay_config.pyramid_levels = pyramid_levels;
+      replay_config.distance_field_max_distance = costmap_->getDistanceFieldMaxDistance();
+      replay_config.obstacle_decay_time = obstacle_decay_time;
+
+      //the replay has to start from the same static map, a cache hit never copied it out of the message
+      if(static_map_msg_ && input_data_.empty())
+        initFromMap(*static_map_msg_);
+      replay_config.static_data = input_data_;
+
+      if(replay_log_.open(replay_log, replay_config))
+        ROS_INFO("Recording costmap updates to %s", replay_log.c_str());
+    }
+
+    //when caching the static map we don't need to hold onto the map message or its data anymore
+    if(static_map_msg_){
+      static_map_msg_.reset();
+      std::vector<unsigned char>().swap(input_data_);
+    }
+
     gettimeofday(&end, NULL);
     start_t = start.tv_sec + double(start.tv_usec) / 1e6;
     end_t = end.tv_sec + double(end.tv_usec) / 1e6;
@@ -659,10 +758,20 @@ namespace costmap_2d {
       double origin_y = wy - costmap_->getSizeInMetersY() / 2;
       costmap_->updateOrigin(origin_x, origin_y);
     }
+    double update_stamp = ros::Time::now().toSec();
+    if(replay_log_.isOpen())
+      replay_log_.write(update_stamp, wx, wy, observations, clearing_observations);
+
+    //forget stale obstacles before we mark the ones we can see now
+    costmap_->decayObstacles(update_stamp);
     costmap_->updateWorld(wx, wy, observations, clearing_observations);
 
     //make sure to clear the robot footprint of obstacles at the end
     clearRobotFootprint();
+
+    //bring the coarse levels and the distance field up to date with everything that changed this cycle
+    costmap_->updatePyramid();
+    costmap_->updateDistanceField();
     
     if(save_debug_pgm_)
       costmap_->saveMap(name_ + ".pgm");
@@ -726,7 +835,15 @@ namespace costmap_2d {
 
   void Costmap2DROS::incomingMap(const nav_msgs::OccupancyGridConstPtr& new_map){
     if(!map_initialized_){
-      initFromMap(*new_map);
+      //when caching the static map we'll hold onto the message and only copy its data if the cache misses
+      if(!static_map_cache_.empty()){
+        boost::recursive_mutex::scoped_lock lock(map_data_lock_);
+        static_map_msg_ = new_map;
+        map_meta_data_ = new_map->info;
+        global_frame_ = tf::resolve(tf_prefix_, new_map->header.frame_id);
+      }
+      else
+        initFromMap(*new_map);
       map_initialized_ = true;
     }
     else if(costmap_initialized_)
@@ -815,11 +932,13 @@ namespace costmap_2d {
   void Costmap2DROS::getCostmapWindowCopy(double win_center_x, double win_center_y, double win_size_x, double win_size_y, Costmap2D& costmap) const {
     boost::recursive_mutex::scoped_lock lock(lock_);
 
-    //we need to compute legal bounds for the window and shrink it if necessary
-    double ll_x = std::min(std::max(win_center_x - win_size_x, costmap_->getOriginX()), costmap_->getSizeInMetersX());
-    double ll_y = std::min(std::max(win_center_y - win_size_y, costmap_->getOriginY()), costmap_->getSizeInMetersY());
-    double ur_x = std::min(std::max(win_center_x + win_size_x, costmap_->getOriginX()), costmap_->getSizeInMetersX());
-    double ur_y = std::min(std::max(win_center_y + win_size_y, costmap_->getOriginY()), costmap_->getSizeInMetersY());
+    //we need to compute legal bounds for the window and shrink it if necessary, the map ends at its origin plus its size
+    double end_x = costmap_->getOriginX() + costmap_->getSizeInMetersX();
+    double end_y = costmap_->getOriginY() + costmap_->getSizeInMetersY();
+    double ll_x = std::min(std::max(win_center_x - win_size_x, costmap_->getOriginX()), end_x);
+    double ll_y = std::min(std::max(win_center_y - win_size_y, costmap_->getOriginY()), end_y);
+    double ur_x = std::min(std::max(win_center_x + win_size_x, costmap_->getOriginX()), end_x);
+    double ur_y = std::min(std::max(win_center_y + win_size_y, costmap_->getOriginY()), end_y);
     double size_x = ur_x - ll_x;
     double size_y = ur_y - ll_y;
 
@@ -0,0 +1,291 @@
+/*********************************************************************
+*
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+#include <costmap_2d/replay_log.h>
+#include <ros/console.h>
+#include <cstring>
+
+#define REPLAY_LOG_MAGIC "costmap_2d_replay"
+#define REPLAY_LOG_VERSION 1
+
+using namespace std;
+
+namespace costmap_2d {
+  ReplayConfig::ReplayConfig() : map_type("costmap"), size_x(0), size_y(0), resolution(0.0), origin_x(0.0), origin_y(0.0),
+  inscribed_radius(0.0), circumscribed_radius(0.0), inflation_radius(0.0), obstacle_range(0.0), max_obstacle_height(0.0),
+  raytrace_range(0.0), weight(0.0), lethal_threshold(100), track_unknown_space(false), unknown_cost_value(0), z_voxels(0),
+  z_resolution(0.0), origin_z(0.0), unknown_threshold(0), mark_threshold(0), rolling_window(false), pyramid_levels(0),
+  distance_field_max_distance(0.0), obstacle_decay_time(0.0) {}
+
+  ReplayLogWriter::ReplayLogWriter() : file_(NULL) {}
+
+  ReplayLogWriter::~ReplayLogWriter(){
+    close();
+  }
+
+  bool ReplayLogWriter::open(const string& filename, const ReplayConfig& config){
+    close();
+
+    file_ = fopen(filename.c_str(), "w");
+    if(file_ == NULL){
+      ROS_ERROR("Could not open replay log %s for writing", filename.c_str());
+      return false;
+    }
+
+    //the header is one parameter per line so that it's easy to read and edit by hand
+    fprintf(file_, "%s %d\n", REPLAY_LOG_MAGIC, REPLAY_LOG_VERSION);
+    fprintf(file_, "map_type %s\n", config.map_type.c_str());
+    fprintf(file_, "size_x %u\n", config.size_x);
+    fprintf(file_, "size_y %u\n", config.size_y);
+    fprintf(file_, "resolution %.9g\n", config.resolution);
+    fprintf(file_, "origin_x %.9g\n", config.origin_x);
+    fprintf(file_, "origin_y %.9g\n", config.origin_y);
+    fprintf(file_, "inscribed_radius %.9g\n", config.inscribed_radius);
+    fprintf(file_, "circumscribed_radius %.9g\n", config.circumscribed_radius);
+    fprintf(file_, "inflation_radius %.9g\n", config.inflation_radius);
+    fprintf(file_, "obstacle_range %.9g\n", config.obstacle_range);
+    fprintf(file_, "max_obstacle_height %.9g\n", config.max_obstacle_height);
+    fprintf(file_, "raytrace_range %.9g\n", config.raytrace_range);
+    fprintf(file_, "weight %.9g\n", config.weight);
+    fprintf(file_, "lethal_threshold %u\n", config.lethal_threshold);
+    fprintf(file_, "track_unknown_space %d\n", config.track_unknown_space ? 1 : 0);
+    fprintf(file_, "unknown_cost_value %u\n", config.unknown_cost_value);
+    fprintf(file_, "z_voxels %u\n", config.z_voxels);
+    fprintf(file_, "z_resolution %.9g\n", config.z_resolution);
+    fprintf(file_, "origin_z %.9g\n", config.origin_z);
+    fprintf(file_, "unknown_threshold %u\n", config.unknown_threshold);
+    fprintf(file_, "mark_threshold %u\n", config.mark_threshold);
+    fprintf(file_, "rolling_window %d\n", config.rolling_window ? 1 : 0);
+    fprintf(file_, "pyramid_levels %u\n", config.pyramid_levels);
+    fprintf(file_, "distance_field_max_distance %.9g\n", config.distance_field_max_distance);
+    fprintf(file_, "obstacle_decay_time %.9g\n", config.obstacle_decay_time);
+
+    //the static map goes in as hex, one row of the map per line
+    if(!config.static_data.empty()){
+      fprintf(file_, "static_map %u\n", (unsigned int)config.static_data.size());
+      unsigned int row_size = config.size_x > 0 ? config.size_x : config.static_data.size();
+      for(unsigned int i = 0; i < config.static_data.size(); ++i){
+        fprintf(file_, "%02x", config.static_data[i]);
+        if((i + 1) % row_size == 0 || i + 1 == config.static_data.size())
+          fprintf(file_, "\n");
+      }
+    }
+    fprintf(file_, "end_config\n");
+    return true;
+  }
+
+  void ReplayLogWriter::write(double stamp, double robot_x, double robot_y, const vector<Observation>& observations,
+      const vector<Observation>& clearing_observations){
+    if(file_ == NULL)
+      return;
+
+    fprintf(file_, "update %.9f %.9g %.9g %u %u\n", stamp, robot_x, robot_y,
+        (unsigned int)observations.size(), (unsigned int)clearing_observations.size());
+
+    for(unsigned int i = 0; i < observations.size(); ++i)
+      writeObservation(observations[i]);
+
+    for(unsigned int i = 0; i < clearing_observations.size(); ++i)
+      writeObservation(clearing_observations[i]);
+  }
+
+  void ReplayLogWriter::writeObservation(const Observation& obs){
+    fprintf(file_, "observation %.9g %.9g %.9g %.9g %.9g %u\n", obs.origin_.x, obs.origin_.y, obs.origin_.z,
+        obs.obstacle_range_, obs.raytrace_range_, (unsigned int)obs.cloud_.points.size());
+
+    for(unsigned int i = 0; i < obs.cloud_.points.size(); ++i)
+      fprintf(file_, "%.9g %.9g %.9g\n", obs.cloud_.points[i].x, obs.cloud_.points[i].y, obs.cloud_.points[i].z);
+  }
+
+  void ReplayLogWriter::close(){
+    if(file_ != NULL){
+      fclose(file_);
+      file_ = NULL;
+    }
+  }
+
+  ReplayLogReader::ReplayLogReader() : file_(NULL) {}
+
+  ReplayLogReader::~ReplayLogReader(){
+    close();
+  }
+
+  bool ReplayLogReader::open(const string& filename, ReplayConfig& config){
+    close();
+
+    file_ = fopen(filename.c_str(), "r");
+    if(file_ == NULL){
+      ROS_ERROR("Could not open replay log %s for reading", filename.c_str());
+      return false;
+    }
+
+    char key[64];
+    int version;
+    if(fscanf(file_, "%63s %d", key, &version) != 2 || strcmp(key, REPLAY_LOG_MAGIC) != 0 || version != REPLAY_LOG_VERSION){
+      ROS_ERROR("%s is not a version %d costmap replay log", filename.c_str(), REPLAY_LOG_VERSION);
+      close();
+      return false;
+    }
+
+    config = ReplayConfig();
+    while(fscanf(file_, "%63s", key) == 1){
+      if(strcmp(key, "end_config") == 0){
+        if(!config.static_data.empty() && config.static_data.size() != config.size_x * config.size_y){
+          ROS_ERROR("The static map in replay log %s does not match the size of the costmap", filename.c_str());
+          close();
+          return false;
+        }
+        return true;
+      }
+
+      int ok = 0;
+      int flag = 0;
+      char value[64];
+      if(strcmp(key, "map_type") == 0){
+        ok = fscanf(file_, "%63s", value);
+        config.map_type = value;
+      }
+      else if(strcmp(key, "size_x") == 0) ok = fscanf(file_, "%u", &config.size_x);
+      else if(strcmp(key, "size_y") == 0) ok = fscanf(file_, "%u", &config.size_y);
+      else if(strcmp(key, "resolution") == 0) ok = fscanf(file_, "%lf", &config.resolution);
+      else if(strcmp(key, "origin_x") == 0) ok = fscanf(file_, "%lf", &config.origin_x);
+      else if(strcmp(key, "origin_y") == 0) ok = fscanf(file_, "%lf", &config.origin_y);
+      else if(strcmp(key, "inscribed_radius") == 0) ok = fscanf(file_, "%lf", &config.inscribed_radius);
+      else if(strcmp(key, "circumscribed_radius") == 0) ok = fscanf(file_, "%lf", &config.circumscribed_radius);
+      else if(strcmp(key, "inflation_radius") == 0) ok = fscanf(file_, "%lf", &config.inflation_radius);
+      else if(strcmp(key, "obstacle_range") == 0) ok = fscanf(file_, "%lf", &config.obstacle_range);
+      else if(strcmp(key, "max_obstacle_height") == 0) ok = fscanf(file_, "%lf", &config.max_obstacle_height);
+      else if(strcmp(key, "raytrace_range") == 0) ok = fscanf(file_, "%lf", &config.raytrace_range);
+      else if(strcmp(key, "weight") == 0) ok = fscanf(file_, "%lf", &config.weight);
+      else if(strcmp(key, "lethal_threshold") == 0) ok = fscanf(file_, "%u", &config.lethal_threshold);
+      else if(strcmp(key, "track_unknown_space") == 0){
+        ok = fscanf(file_, "%d", &flag);
+        config.track_unknown_space = flag != 0;
+      }
+      else if(strcmp(key, "unknown_cost_value") == 0) ok = fscanf(file_, "%u", &config.unknown_cost_value);
+      else if(strcmp(key, "z_voxels") == 0) ok = fscanf(file_, "%u", &config.z_voxels);
+      else if(strcmp(key, "z_resolution") == 0) ok = fscanf(file_, "%lf", &config.z_resolution);
+      else if(strcmp(key, "origin_z") == 0) ok = fscanf(file_, "%lf", &config.origin_z);
+      else if(strcmp(key, "unknown_threshold") == 0) ok = fscanf(file_, "%u", &config.unknown_threshold);
+      else if(strcmp(key, "mark_threshold") == 0) ok = fscanf(file_, "%u", &config.mark_threshold);
+      else if(strcmp(key, "rolling_window") == 0){
+        ok = fscanf(file_, "%d", &flag);
+        config.rolling_window = flag != 0;
+      }
+      else if(strcmp(key, "pyramid_levels") == 0) ok = fscanf(file_, "%u", &config.pyramid_levels);
+      else if(strcmp(key, "distance_field_max_distance") == 0) ok = fscanf(file_, "%lf", &config.distance_field_max_distance);
+      else if(strcmp(key, "obstacle_decay_time") == 0) ok = fscanf(file_, "%lf", &config.obstacle_decay_time);
+      else if(strcmp(key, "static_map") == 0){
+        unsigned int num_cells = 0;
+        ok = fscanf(file_, "%u", &num_cells);
+        config.static_data.resize(num_cells);
+        for(unsigned int i = 0; ok == 1 && i < num_cells; ++i){
+          unsigned int cell;
+          ok = fscanf(file_, " %2x", &cell);
+          config.static_data[i] = (unsigned char) cell;
+        }
+      }
+      else{
+        ROS_ERROR("Unknown parameter %s in the header of replay log %s", key, filename.c_str());
+        close();
+        return false;
+      }
+
+      if(ok != 1){
+        ROS_ERROR("Could not read the value of parameter %s in replay log %s", key, filename.c_str());
+        close();
+        return false;
+      }
+    }
+
+    ROS_ERROR("The header of replay log %s is truncated", filename.c_str());
+    close();
+    return false;
+  }
+
+  bool ReplayLogReader::read(ReplayUpdate& update){
+    if(file_ == NULL)
+      return false;
+
+    char key[64];
+    unsigned int num_marking, num_clearing;
+    if(fscanf(file_, "%63s %lf %lf %lf %u %u", key, &update.stamp, &update.robot_x, &update.robot_y, &num_marking, &num_clearing) != 6
+        || strcmp(key, "update") != 0)
+      return false;
+
+    update.observations.resize(num_marking);
+    for(unsigned int i = 0; i < num_marking; ++i){
+      if(!readObservation(update.observations[i]))
+        return false;
+    }
+
+    update.clearing_observations.resize(num_clearing);
+    for(unsigned int i = 0; i < num_clearing; ++i){
+      if(!readObservation(update.clearing_observations[i]))
+        return false;
+    }
+
+    return true;
+  }
+
+  bool ReplayLogReader::readObservation(Observation& obs){
+    char key[64];
+    unsigned int num_points;
+    if(fscanf(file_, "%63s %lf %lf %lf %lf %lf %u", key, &obs.origin_.x, &obs.origin_.y, &obs.origin_.z,
+          &obs.obstacle_range_, &obs.raytrace_range_, &num_points) != 7 || strcmp(key, "observation") != 0){
+      ROS_ERROR("Malformed observation in replay log");
+      return false;
+    }
+
+    obs.cloud_.points.resize(num_points);
+    for(unsigned int i = 0; i < num_points; ++i){
+      pcl::PointXYZ& point = obs.cloud_.points[i];
+      if(fscanf(file_, "%f %f %f", &point.x, &point.y, &point.z) != 3){
+        ROS_ERROR("Malformed point in replay log");
+        return false;
+      }
+    }
+    obs.cloud_.width = num_points;
+    obs.cloud_.height = 1;
+
+    return true;
+  }
+
+  void ReplayLogReader::close(){
+    if(file_ != NULL){
+      fclose(file_);
+      file_ = NULL;
+    }
+  }
+};
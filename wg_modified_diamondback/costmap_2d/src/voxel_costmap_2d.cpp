@@ -111,6 +111,9 @@ namespace costmap_2d{
     copyMapRegion(local_map, 0, 0, cell_size_x, costmap_, start_x, start_y, size_x_, cell_size_x, cell_size_y);
     copyMapRegion(local_voxel_map, 0, 0, cell_size_x, voxel_map, start_x, start_y, size_x_, cell_size_x, cell_size_y);
 
+    //everything outside the window may have changed
+    markDirty();
+
     //clean up
     delete[] local_map;
     delete[] local_voxel_map;
@@ -155,6 +158,7 @@ namespace costmap_2d{
 
           //push the relevant cell index back onto the inflation queue
           enqueue(index, mx, my, mx, my, inflation_queue);
+          stampObstacle(index);
         }
       }
     }
@@ -289,6 +293,9 @@ namespace costmap_2d{
     copyMapRegion(local_map, 0, 0, cell_size_x, costmap_, start_x, start_y, size_x_, cell_size_x, cell_size_y);
     copyMapRegion(local_voxel_map, 0, 0, cell_size_x, voxel_map, start_x, start_y, size_x_, cell_size_x, cell_size_y);
 
+    //the obstacles we've kept need to keep their stamps
+    shiftObstacleStamps(cell_ox, cell_oy);
+
     //make sure to clean up
     delete[] local_map;
     delete[] local_voxel_map;
@@ -339,6 +346,14 @@ namespace costmap_2d{
       current += size_x_ - (map_ex - map_sx) - 1;
       index += size_x_ - (map_ex - map_sx) - 1;
     }
+    markDirty(map_sx, map_sy, map_ex, map_ey);
+  }
+
+  void VoxelCostmap2D::forgetObstacle(unsigned int index){
+    Costmap2D::forgetObstacle(index);
+
+    //the marked voxels would otherwise put the obstacle right back the next time the column is marked
+    voxel_grid_.clearVoxelColumn(index);
   }
 
   void VoxelCostmap2D::getVoxelGridMessage(VoxelGrid& grid){
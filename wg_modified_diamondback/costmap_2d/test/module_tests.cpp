@@ -34,7 +34,9 @@
 
 #include <costmap_2d/costmap_2d.h>
 #include <costmap_2d/observation_buffer.h>
+#include <costmap_2d/replay_log.h>
 #include <set>
+#include <unistd.h>
 #include <gtest/gtest.h>
 #include <tf/transform_listener.h>
 
@@ -337,6 +339,27 @@ TEST(costmap, testWindowCopy){
     //printf("\n");
   }
 
+  //a window that doesn't start on a cell boundary still lines up with the cells of the map, and a window
+  //of the same size reuses the memory of the last one
+  const unsigned char* char_map = windowCopy.getCharMap();
+  windowCopy.copyCostmapWindow(map, 3.5, 1.5, 5.0, 5.0);
+  ASSERT_EQ(windowCopy.getSizeInCellsX(), (unsigned int)6);
+  ASSERT_EQ(windowCopy.getSizeInCellsY(), (unsigned int)6);
+  ASSERT_EQ(windowCopy.getCharMap(), char_map);
+  ASSERT_EQ(windowCopy.getOriginX(), 3.0);
+  ASSERT_EQ(windowCopy.getOriginY(), 1.0);
+  for(unsigned int i = 0; i < windowCopy.getSizeInCellsX(); ++i){
+    for(unsigned int j = 0; j < windowCopy.getSizeInCellsY(); ++j){
+      ASSERT_EQ(windowCopy.getCost(i, j), map.getCost(i + 3, j + 1));
+    }
+  }
+
+  //a window that ends right at the end of the map keeps its last cells
+  windowCopy.copyCostmapWindow(map, 4.0, 4.0, 6.0, 6.0);
+  ASSERT_EQ(windowCopy.getSizeInCellsX(), (unsigned int)6);
+  ASSERT_EQ(windowCopy.getSizeInCellsY(), (unsigned int)6);
+  ASSERT_EQ(windowCopy.getCost(5, 5), map.getCost(9, 9));
+
 }
 
 //test for updating costmaps with static data
@@ -409,6 +432,355 @@ TEST(costmap, testOverlapStaticMapUpdate){
 
 }
 
+//test for saving and loading the inflated static map from a cache file
+TEST(costmap, testStaticMapCache){
+  std::string cache_file = "/tmp/costmap_2d_static_map_cache_test.bin";
+  unlink(cache_file.c_str());
+
+  Costmap2D static_map(GRID_WIDTH, GRID_HEIGHT, RESOLUTION, 0.0, 0.0, ROBOT_RADIUS, ROBOT_RADIUS, ROBOT_RADIUS,
+      10.0, MAX_Z, 10.0, 25, MAP_10_BY_10, THRESHOLD);
+
+  ASSERT_TRUE(static_map.saveStaticMap(cache_file, 42));
+
+  //a costmap with no static data should pick up the inflated static map from the cache
+  Costmap2D map(GRID_WIDTH, GRID_HEIGHT, RESOLUTION, 0.0, 0.0, ROBOT_RADIUS, ROBOT_RADIUS, ROBOT_RADIUS,
+      10.0, MAX_Z, 10.0, 25, EMPTY_10_BY_10, THRESHOLD);
+
+  ASSERT_TRUE(map.loadStaticMap(cache_file, 42));
+  for(unsigned int i = 0; i < map.getSizeInCellsX(); ++i){
+    for(unsigned int j = 0; j < map.getSizeInCellsY(); ++j){
+      ASSERT_EQ(map.getCost(i, j), static_map.getCost(i, j));
+    }
+  }
+
+  //resetting the map outside of a window should go back to the cached static map
+  map.resetMapOutsideWindow(0.0, 0.0, 0.0, 0.0);
+  for(unsigned int i = 0; i < map.getSizeInCellsX(); ++i){
+    for(unsigned int j = 0; j < map.getSizeInCellsY(); ++j){
+      ASSERT_EQ(map.getCost(i, j), static_map.getCost(i, j));
+    }
+  }
+
+  //a cache built from different data, or for a costmap with different parameters, should be rejected
+  ASSERT_FALSE(map.loadStaticMap(cache_file, 43));
+
+  Costmap2D other_inflation(GRID_WIDTH, GRID_HEIGHT, RESOLUTION, 0.0, 0.0, ROBOT_RADIUS, ROBOT_RADIUS, 2 * ROBOT_RADIUS,
+      10.0, MAX_Z, 10.0, 25, EMPTY_10_BY_10, THRESHOLD);
+  ASSERT_FALSE(other_inflation.loadStaticMap(cache_file, 42));
+
+  Costmap2D other_size(5, 5, RESOLUTION, 0.0, 0.0, ROBOT_RADIUS, ROBOT_RADIUS, ROBOT_RADIUS,
+      10.0, MAX_Z, 10.0, 25, MAP_5_BY_5, THRESHOLD);
+  ASSERT_FALSE(other_size.loadStaticMap(cache_file, 42));
+
+  unlink(cache_file.c_str());
+}
+
+//check every coarse cell in the pyramid against the costmap cells it covers
+void checkPyramid(const Costmap2D& map){
+  for(unsigned int level = 1; level <= map.getPyramidLevels(); ++level){
+    unsigned int cell_span = 1 << level;
+    for(unsigned int cy = 0; cy < map.getPyramidSizeInCellsY(level); ++cy){
+      for(unsigned int cx = 0; cx < map.getPyramidSizeInCellsX(level); ++cx){
+        unsigned char expected = 0;
+        for(unsigned int j = cy * cell_span; j < std::min((cy + 1) * cell_span, map.getSizeInCellsY()); ++j){
+          for(unsigned int i = cx * cell_span; i < std::min((cx + 1) * cell_span, map.getSizeInCellsX()); ++i){
+            expected = std::max(expected, map.getCost(i, j));
+          }
+        }
+        ASSERT_EQ(map.getCoarseCost(level, cx, cy), expected);
+      }
+    }
+  }
+}
+
+//test for the max-pooled costmap pyramid
+TEST(costmap, testPyramid){
+  Costmap2D map(GRID_WIDTH, GRID_HEIGHT, RESOLUTION, 0.0, 0.0, ROBOT_RADIUS, ROBOT_RADIUS, ROBOT_RADIUS,
+      10.0, MAX_Z, 10.0, 25, EMPTY_10_BY_10, THRESHOLD);
+  map.setPyramidLevels(3);
+
+  ASSERT_EQ(map.getPyramidSizeInCellsX(1), (unsigned int)5);
+  ASSERT_EQ(map.getPyramidSizeInCellsX(2), (unsigned int)3);
+  ASSERT_EQ(map.getPyramidSizeInCellsX(3), (unsigned int)2);
+  checkPyramid(map);
+
+  //add an obstacle and make sure the pyramid picks up the inflated costs
+  pcl::PointCloud<pcl::PointXYZ> cloud;
+  cloud.points.resize(1);
+  cloud.points[0].x = 7;
+  cloud.points[0].y = 2;
+  cloud.points[0].z = MAX_Z;
+
+  geometry_msgs::Point p;
+  p.x = 0.0;
+  p.y = 0.0;
+  p.z = MAX_Z;
+
+  Observation obs(p, cloud, 100.0, 100.0);
+  std::vector<Observation> obsBuf;
+  obsBuf.push_back(obs);
+
+  map.updateWorld(0, 0, obsBuf, obsBuf);
+  map.updatePyramid();
+  checkPyramid(map);
+  ASSERT_EQ(map.getCoarseCost(3, 0, 0), costmap_2d::LETHAL_OBSTACLE);
+
+  //lowering a single cell's cost should propagate up through the levels
+  map.setCost(7, 2, costmap_2d::FREE_SPACE);
+  map.updatePyramid();
+  checkPyramid(map);
+
+  //box queries should give an upper bound on the cells in the box and be exact for a single cell
+  unsigned char cost;
+  unsigned char map_max = 0;
+  for(unsigned int i = 0; i < map.getSizeInCellsX(); ++i){
+    for(unsigned int j = 0; j < map.getSizeInCellsY(); ++j){
+      map_max = std::max(map_max, map.getCost(i, j));
+    }
+  }
+  ASSERT_TRUE(map.getMaxCostInBox(0.0, 0.0, 9.5, 9.5, cost));
+  ASSERT_EQ(cost, map_max);
+  ASSERT_TRUE(map.getMaxCostInBox(6.5, 2.5, 6.5, 2.5, cost));
+  ASSERT_EQ(cost, map.getCost(6, 2));
+  ASSERT_TRUE(map.getMaxCostInBox(5.2, 1.2, 8.8, 3.8, cost));
+  for(unsigned int i = 5; i <= 8; ++i){
+    for(unsigned int j = 1; j <= 3; ++j){
+      ASSERT_GE(cost, map.getCost(i, j));
+    }
+  }
+  ASSERT_FALSE(map.getMaxCostInBox(-5.0, -5.0, -1.0, -1.0, cost));
+
+  //copies of the costmap should carry the pyramid along with them
+  Costmap2D map_copy(map);
+  ASSERT_EQ(map_copy.getPyramidLevels(), (unsigned int)3);
+  checkPyramid(map_copy);
+}
+
+//check the distance field against a brute force search for the nearest cell on the other side of every obstacle boundary
+void checkDistanceField(const Costmap2D& map){
+  double max_distance = map.getDistanceFieldMaxDistance();
+  for(unsigned int j = 0; j < map.getSizeInCellsY(); ++j){
+    for(unsigned int i = 0; i < map.getSizeInCellsX(); ++i){
+      bool lethal = map.getCost(i, j) == costmap_2d::LETHAL_OBSTACLE;
+      double expected = max_distance;
+      for(unsigned int y = 0; y < map.getSizeInCellsY(); ++y){
+        for(unsigned int x = 0; x < map.getSizeInCellsX(); ++x){
+          if((map.getCost(x, y) == costmap_2d::LETHAL_OBSTACLE) != lethal){
+            double dx = (double)x - i;
+            double dy = (double)y - j;
+            expected = std::min(expected, sqrt(dx * dx + dy * dy) * map.getResolution());
+          }
+        }
+      }
+      if(lethal)
+        expected = -expected;
+      ASSERT_NEAR(map.getDistance(i, j), expected, 1e-5);
+    }
+  }
+}
+
+//test for the signed distance field
+TEST(costmap, testDistanceField){
+  Costmap2D map(GRID_WIDTH, GRID_HEIGHT, RESOLUTION, 0.0, 0.0, ROBOT_RADIUS, ROBOT_RADIUS, ROBOT_RADIUS,
+      10.0, MAX_Z, 10.0, 25, MAP_10_BY_10, THRESHOLD);
+  ASSERT_FALSE(map.hasDistanceField());
+  map.enableDistanceField(20.0);
+  ASSERT_TRUE(map.hasDistanceField());
+  checkDistanceField(map);
+
+  //changes shouldn't show up until the field is updated
+  double before = map.getDistance(0, 0);
+  map.setCost(1, 0, costmap_2d::LETHAL_OBSTACLE);
+  ASSERT_NEAR(map.getDistance(0, 0), before, 1e-5);
+  map.updateDistanceField();
+  checkDistanceField(map);
+
+  //copies of the costmap should carry the distance field along with them
+  Costmap2D map_copy(map);
+  ASSERT_TRUE(map_copy.hasDistanceField());
+  checkDistanceField(map_copy);
+
+  map.disableDistanceField();
+  ASSERT_FALSE(map.hasDistanceField());
+
+  //on a larger map with a short maximum distance, updates only touch a window around the change
+  std::vector<unsigned char> empty_map(40 * 40, 0);
+  Costmap2D big_map(40, 40, 0.5, 0.0, 0.0, 0.5, 0.5, 0.5, 10.0, MAX_Z, 10.0, 25, empty_map, THRESHOLD);
+  big_map.enableDistanceField(1.5);
+  checkDistanceField(big_map);
+
+  big_map.setCost(5, 5, costmap_2d::LETHAL_OBSTACLE);
+  big_map.setCost(6, 5, costmap_2d::LETHAL_OBSTACLE);
+  big_map.setCost(7, 5, costmap_2d::LETHAL_OBSTACLE);
+  big_map.updateDistanceField();
+  checkDistanceField(big_map);
+
+  big_map.setCost(30, 32, costmap_2d::LETHAL_OBSTACLE);
+  big_map.setCost(6, 5, costmap_2d::FREE_SPACE);
+  big_map.updateDistanceField();
+  checkDistanceField(big_map);
+}
+
+//test that windows of a costmap take its pyramid and distance field along with them
+TEST(costmap, testWindowCopyDerivedMaps){
+  Costmap2D map(GRID_WIDTH, GRID_HEIGHT, RESOLUTION, 0.0, 0.0, ROBOT_RADIUS, ROBOT_RADIUS, ROBOT_RADIUS,
+      10.0, MAX_Z, 10.0, 25, MAP_10_BY_10, THRESHOLD);
+  map.setPyramidLevels(2);
+  map.enableDistanceField(20.0);
+
+  //the distances near the edges of the window still see the obstacles outside of it
+  Costmap2D windowCopy;
+  windowCopy.copyCostmapWindow(map, 2.0, 2.0, 6.0, 6.0);
+  ASSERT_EQ(windowCopy.getPyramidLevels(), (unsigned int)2);
+  ASSERT_TRUE(windowCopy.hasDistanceField());
+  ASSERT_EQ(windowCopy.getDistanceFieldMaxDistance(), 20.0);
+  checkPyramid(windowCopy);
+  for(unsigned int i = 0; i < windowCopy.getSizeInCellsX(); ++i){
+    for(unsigned int j = 0; j < windowCopy.getSizeInCellsY(); ++j){
+      ASSERT_EQ(windowCopy.getDistance(i, j), map.getDistance(i + 2, j + 2));
+    }
+  }
+
+  //a window of the same size picks up changes to the map
+  map.setCost(4, 4, costmap_2d::LETHAL_OBSTACLE);
+  map.updatePyramid();
+  map.updateDistanceField();
+  windowCopy.copyCostmapWindow(map, 3.0, 1.0, 6.0, 6.0);
+  checkPyramid(windowCopy);
+  for(unsigned int i = 0; i < windowCopy.getSizeInCellsX(); ++i){
+    for(unsigned int j = 0; j < windowCopy.getSizeInCellsY(); ++j){
+      ASSERT_EQ(windowCopy.getDistance(i, j), map.getDistance(i + 3, j + 1));
+    }
+  }
+
+  //and drops the derived maps when the map does
+  map.setPyramidLevels(0);
+  map.disableDistanceField();
+  windowCopy.copyCostmapWindow(map, 2.0, 2.0, 6.0, 6.0);
+  ASSERT_EQ(windowCopy.getPyramidLevels(), (unsigned int)0);
+  ASSERT_FALSE(windowCopy.hasDistanceField());
+}
+
+//test for obstacles decaying out of the costmap when they aren't re-observed
+TEST(costmap, testObstacleDecay){
+  Costmap2D map(GRID_WIDTH, GRID_HEIGHT, RESOLUTION, 0.0, 0.0, ROBOT_RADIUS, ROBOT_RADIUS, ROBOT_RADIUS,
+      10.0, MAX_Z, 10.0, 25, MAP_10_BY_10, THRESHOLD);
+  Costmap2D reference(map);
+  map.setObstacleDecayTime(1.0);
+  ASSERT_EQ(map.getObstacleDecayTime(), 1.0);
+
+  //observe an obstacle in free space and one on top of a wall in the static map
+  pcl::PointCloud<pcl::PointXYZ> cloud;
+  cloud.points.resize(2);
+  cloud.points[0].x = 1;
+  cloud.points[0].y = 1;
+  cloud.points[0].z = MAX_Z;
+  cloud.points[1].x = 8;
+  cloud.points[1].y = 2;
+  cloud.points[1].z = MAX_Z;
+
+  geometry_msgs::Point p;
+  p.x = 0.0;
+  p.y = 0.0;
+  p.z = MAX_Z;
+
+  Observation obs(p, cloud, 100.0, 100.0);
+  std::vector<Observation> obsBuf, emptyBuf;
+  obsBuf.push_back(obs);
+
+  map.decayObstacles(100.0);
+  map.updateWorld(0, 0, obsBuf, emptyBuf);
+  ASSERT_EQ(map.getCost(1, 1), costmap_2d::LETHAL_OBSTACLE);
+
+  //re-observing the obstacle should keep it around past the original decay time
+  map.decayObstacles(100.6);
+  map.updateWorld(0, 0, obsBuf, emptyBuf);
+  map.decayObstacles(101.2);
+  ASSERT_EQ(map.getCost(1, 1), costmap_2d::LETHAL_OBSTACLE);
+
+  //once it decays the costmap should look like we never saw it, but the wall stays
+  map.decayObstacles(101.7);
+  ASSERT_EQ(map.getCost(8, 2), costmap_2d::LETHAL_OBSTACLE);
+  for(unsigned int i = 0; i < map.getSizeInCellsX(); ++i){
+    for(unsigned int j = 0; j < map.getSizeInCellsY(); ++j){
+      ASSERT_EQ(map.getCost(i, j), reference.getCost(i, j));
+    }
+  }
+
+  //obstacles should keep their stamps when the origin of the map moves
+  map.decayObstacles(102.0);
+  map.updateWorld(0, 0, obsBuf, emptyBuf);
+  map.updateOrigin(1.0, 0.0);
+  ASSERT_EQ(map.getCost(0, 1), costmap_2d::LETHAL_OBSTACLE);
+  map.decayObstacles(102.5);
+  ASSERT_EQ(map.getCost(0, 1), costmap_2d::LETHAL_OBSTACLE);
+  map.decayObstacles(103.5);
+  ASSERT_NE(map.getCost(0, 1), costmap_2d::LETHAL_OBSTACLE);
+}
+
+//test that a replay log reads back what was written to it
+TEST(costmap, testReplayLog){
+  std::string log_file = "/tmp/costmap_2d_replay_log_test.log";
+
+  ReplayConfig config;
+  config.size_x = GRID_WIDTH;
+  config.size_y = GRID_HEIGHT;
+  config.resolution = RESOLUTION;
+  config.inflation_radius = ROBOT_RADIUS;
+  config.rolling_window = true;
+  config.static_data = MAP_10_BY_10;
+
+  pcl::PointCloud<pcl::PointXYZ> cloud;
+  cloud.points.resize(2);
+  cloud.points[0].x = 1.5;
+  cloud.points[0].y = 2.25;
+  cloud.points[0].z = 0.5;
+  cloud.points[1].x = 1234.5678;
+  cloud.points[1].y = 4.0;
+  cloud.points[1].z = 0.0;
+
+  geometry_msgs::Point p;
+  p.x = 0.5;
+  p.y = 0.5;
+  p.z = 1.0;
+
+  std::vector<Observation> observations, clearing_observations;
+  observations.push_back(Observation(p, cloud, 2.5, 3.0));
+
+  ReplayLogWriter writer;
+  ASSERT_TRUE(writer.open(log_file, config));
+  writer.write(10.0, 1.0, 2.0, observations, clearing_observations);
+  writer.write(10.5, 1.5, 2.0, observations, observations);
+  writer.close();
+
+  ReplayLogReader reader;
+  ReplayConfig read_config;
+  ASSERT_TRUE(reader.open(log_file, read_config));
+  ASSERT_EQ(read_config.size_x, GRID_WIDTH);
+  ASSERT_EQ(read_config.map_type, std::string("costmap"));
+  ASSERT_EQ(read_config.inflation_radius, ROBOT_RADIUS);
+  ASSERT_TRUE(read_config.rolling_window);
+  ASSERT_TRUE(read_config.static_data == MAP_10_BY_10);
+
+  ReplayUpdate update;
+  ASSERT_TRUE(reader.read(update));
+  ASSERT_EQ(update.stamp, 10.0);
+  ASSERT_EQ(update.observations.size(), (unsigned int)1);
+  ASSERT_EQ(update.clearing_observations.size(), (unsigned int)0);
+  ASSERT_EQ(update.observations[0].cloud_.points.size(), (unsigned int)2);
+  ASSERT_EQ(update.observations[0].cloud_.points[0].y, 2.25);
+  ASSERT_EQ(update.observations[0].cloud_.points[1].x, cloud.points[1].x);
+  ASSERT_EQ(update.observations[0].origin_.z, 1.0);
+  ASSERT_EQ(update.observations[0].raytrace_range_, 3.0);
+
+  ASSERT_TRUE(reader.read(update));
+  ASSERT_EQ(update.robot_x, 1.5);
+  ASSERT_EQ(update.clearing_observations.size(), (unsigned int)1);
+  ASSERT_FALSE(reader.read(update));
+
+  unlink(log_file.c_str());
+}
+
 /**
  * Test for ray tracing free space
  */
@@ -45,6 +45,10 @@
 #include <stdint.h>
 #include <string.h>
 #include <stdio.h>
+#include <vector>
+#include <queue>
+#include <functional>
+#include <boost/thread.hpp>
 
 // cost defs
 #define COST_UNKNOWN_ROS 255		// 255 is unknown cost
@@ -63,9 +67,20 @@
 // potential defs
 #define POT_HIGH 1.0e10		// unassigned cell potential
 
-// priority buffers
+// initial size of the priority buffers, they grow as needed
 #define PRIORITYBUFSIZE 10000
 
+// smallest priority block that is worth splitting across threads
+#define PROPPARALLELMIN 1000
+
+// neighbors a cell pushes in a parallel block update, and whether it
+//   pushes them to the overflow block
+#define PROPLEFT 1
+#define PROPRIGHT 2
+#define PROPUP 4
+#define PROPDOWN 8
+#define PROPOVER 16
+
 
 namespace navfn {
   /**
@@ -82,12 +97,31 @@ positions at about 1/2 cell resolution; else returns 0.
 
 */
 
-  int create_nav_plan_astar(const COSTTYPE *costmap, int nx, int ny,
+  int create_nav_plan_astar(COSTTYPE *costmap, int nx, int ny,
       int* goal, int* start,
       float *plan, int nplan);
 
 
 
+  /**
+   * @struct NavFnWave
+   * @brief The propagation state of one wavefront, so that NavFn can propagate two in turn
+   */
+  struct NavFnWave
+  {
+    float *potarr;		/**< potential array */
+    bool *pending;		/**< pending cells during propagation */
+    int *pb1, *pb2, *pb3;	/**< storage buffers for priority blocks */
+    int *curP, *nextP, *overP;	/**< priority buffer block ptrs */
+    int curPe, nextPe, overPe;	/**< end points of arrays */
+    int pbSize;			/**< size of each priority buffer */
+    float curT;			/**< current threshold */
+    float curInc;		/**< current threshold increment */
+    int levelMax;		/**< largest block at the current threshold */
+    int potLo, potHi;		/**< range of cells whose potential has been set */
+    int goal[2];		/**< cell the wavefront is seeded from */
+  };
+
   /**
    * @class NavFn
    * @brief Navigation function class. Holds buffers for costmap, navfn map. Maps are pixel-based. Origin is upper left, x is right, y is down. 
@@ -105,7 +139,7 @@ positions at about 1/2 cell resolution; else returns 0.
       ~NavFn();
 
       /**
-       * @brief  Sets or resets the size of the map
+       * @brief  Sets or resets the size of the map. The buffers are only reallocated when the size changes, otherwise they are kept for the next plan
        * @param nx The x size of the map 
        * @param ny The y size of the map 
        */
@@ -113,13 +147,19 @@ positions at about 1/2 cell resolution; else returns 0.
       int nx, ny, ns;		/**< size of grid, in pixels */
 
       /**
-       * @brief  Set up the cost array for the planner, usually from ROS  
+       * @brief  Set up the cost array for the planner, usually from ROS. Only the rows that differ from the last costmap passed in are translated... 
+       * if costarr is written directly, call invalidateCostmap() before the next call
        * @param cmap The costmap 
        * @param isROS Whether or not the costmap is coming in in ROS format
        * @param allow_unknown Whether or not the planner should be allowed to plan through unknown space
        */
       void setCostmap(const COSTTYPE *cmap, bool isROS=true, bool allow_unknown = true); /**< sets up the cost map */
 
+      /**
+       * @brief  Forget the last costmap passed to setCostmap so that the next call translates the whole map
+       */
+      void invalidateCostmap();
+
       /**
        * @brief  Calculates a plan using the A* heuristic, returns true if one is found
        * @return True if a plan is found, false otherwise
@@ -131,6 +171,51 @@ positions at about 1/2 cell resolution; else returns 0.
        */
       bool calcNavFnDijkstra(bool atStart = false);	/**< calculates the full navigation function */
 
+      /**
+       * @brief  Restricts calcNavFnDijkstra(true) to an ellipse around the start and goal, which is doubled in size 
+       * when no path is found inside it, before falling back to the whole map
+       * @param scale The sum of the distances to the start and goal allowed, as a multiple of the start-goal distance... 0 to disable
+       * @param margin Extra room added to the ellipse, in cells
+       */
+      void setCorridor(float scale, int margin);
+      float corridorScale;		/**< corridor size, 0 if disabled */
+      int corridorMargin;		/**< extra corridor width, in cells */
+      std::vector<int> corridorLo, corridorHi; /**< span of each row inside the current corridor */
+
+      /**
+       * @brief  Sets cells that calcNavFnDijkstra(true) has to reach besides the start before it stops, so that 
+       * one propagation can answer several goals... the corridor is not used while there are any
+       * @param cells The indices of the cells, empty for just the start
+       */
+      void setTargets(const std::vector<int>& cells);
+      std::vector<int> targetCells;	/**< cells the propagation has to reach besides the start */
+      unsigned int targetNext;	/**< first target not yet known to be reached */
+      bool targetsReached();	/**< whether all the targets have a potential */
+
+      /**
+       * @brief  Finds the cell with a potential closest to a cell, searching rings of cells around it outward... 
+       * stops once no ring further out can hold a closer cell
+       * @param x The x coordinate of the cell to search around, which may be off the map
+       * @param y The y coordinate of the cell to search around, which may be off the map
+       * @param radius The largest ring to search, in cells
+       * @return The index of the closest cell with a potential, -1 if there is none
+       */
+      int findReachedCell(int x, int y, int radius);
+
+      /**
+       * @brief  Calculates a plan by propagating from the goal and the start in turn until the wavefronts meet
+       * @return True if a plan is found, false otherwise
+       */
+      bool calcNavFnBidirectional();	/**< calculates a plan with two wavefronts */
+
+      /**
+       * @brief  Calculates a plan by repairing the navigation function left by the last call, returns true if one is found. 
+       * Only cells whose cost changed since then, and the cells depending on them, are updated... the field is rebuilt 
+       * when the goal moves. The potential is the cost to the goal, so the path runs from the start to the goal.
+       * @return True if a plan is found, false otherwise
+       */
+      bool calcNavFnIncremental();	/**< calculates a plan, reusing the last navigation function */
+
       /**
        * @brief  Accessor for the x-coordinates of a path
        * @return The x-coordinates of a path
@@ -162,14 +247,46 @@ positions at about 1/2 cell resolution; else returns 0.
       bool    *pending;		/**< pending cells during propagation */
       int nobs;			/**< number of obstacle cells */
 
+      /** persistent workspace */
+      COSTTYPE *rawarr;		/**< copy of the last costmap given to setCostmap, used to find changed rows */
+      bool rawValid;		/**< whether rawarr and nobs match the cost array */
+      bool rawIsROS, rawAllowUnknown; /**< translation flags used for rawarr */
+      int potLo, potHi;		/**< range of cells whose potential has been set since the last reset */
+      int gradLo, gradHi;		/**< range of cells whose gradient has been set since the last reset */
+
+      /** cost translation */
+      COSTTYPE costLut[256];	/**< navfn cost of each costmap value */
+      bool costLutValid, costLutUnknown; /**< whether costLut is set, and whether it treats unknown space as free */
+      std::vector<COSTTYPE> costRow;	/**< previous costs of the row being translated */
+      void setCostLut(bool unknown_free); /**< fills costLut */
+      void translateCosts(const COSTTYPE *cmap, COSTTYPE *cm, int n); /**< translates <n> costmap values to costs */
+      int countObs(const COSTTYPE *cm, int n); /**< number of obstacle costs among <n> */
+
       /** block priority buffers */
       int *pb1, *pb2, *pb3;		/**< storage buffers for priority blocks */
       int *curP, *nextP, *overP;	/**< priority buffer block ptrs */
       int curPe, nextPe, overPe; /**< end points of arrays */
+      int pbSize;			/**< size of each priority buffer, grown when a push would overflow it */
+      void growPriorityBuffers();	/**< doubles the size of the priority buffers, keeping their contents */
 
       /** block priority thresholds */
       float curT;			/**< current threshold */
       float priInc;			/**< priority threshold increment */
+      float curInc;			/**< increment in use by the Dijkstra propagation, starts at priInc */
+      int levelMax;			/**< largest block seen at the current threshold */
+
+      /**
+       * @brief  Lets the Dijkstra propagation adapt the threshold increment so that priority blocks hold about <target> cells... 
+       * a larger increment means fewer cycles, a smaller one fewer redundant updates; it never goes below priInc
+       * @param target The priority block size to aim for, 0 to always use priInc
+       */
+      void setBlockTarget(int target);
+      int blockTarget;		/**< target priority level size, 0 if the increment is fixed */
+
+      /** propagation statistics, from the last Dijkstra or A* propagation */
+      int statCycles;		/**< cycles used */
+      int statCells;		/**< cells taken from priority blocks */
+      int statMaxBlock;		/**< largest priority block */
 
       /** goal and start positions */
       /**
@@ -210,7 +327,8 @@ positions at about 1/2 cell resolution; else returns 0.
        */
       void updateCellAstar(int n);	/**< updates the cell at index <n>, uses A* heuristic */
 
-      void setupNavFn(bool keepit = false); /**< resets all nav fn arrays for propagation */
+      void setupNavFn(bool keepit = false); /**< resets the nav fn arrays touched by the last propagation */
+      void setCostBorder();	/**< sets the outer border of the cost array to obstacles */
 
       /**
        * @brief  Run propagation for <cycles> iterations, or until start is reached using breadth-first Dijkstra method
@@ -219,6 +337,42 @@ positions at about 1/2 cell resolution; else returns 0.
        * @return true if the start point is reached
        */
       bool propNavFnDijkstra(int cycles, bool atStart = false); /**< returns true if start point found or full prop */
+
+      /**
+       * @brief  Process the current priority block and move on to the next one
+       * @param other The potential array of the opposite wavefront, checked for meeting cells if not NULL
+       */
+      void propNavFnCycle(const float *other = NULL);
+
+      /** corridor and bidirectional propagation */
+      void markCorridor(float scale);	/**< blocks cells outside the corridor by marking them pending */
+      void clearCorridor();		/**< unblocks the cells outside the corridor */
+      NavFnWave waveB;		/**< the wavefront not being propagated, from the start in calcNavFnBidirectional() */
+      void swapWave();		/**< swaps the current wavefront with waveB */
+      float meetPot;		/**< lowest sum of potentials at a cell reached by both wavefronts */
+      int meetCell;			/**< cell where meetPot was found, -1 if none */
+      float queuedPot(const float *other, float &seam);		/**< lowest potential a cell queued in the current wavefront can get, <seam> is the lowest sum with <other> over those cells */
+
+      /** parallel propagation */
+      /**
+       * @brief  Sets the number of threads used to process large priority blocks in propNavFnDijkstra()
+       * @param n The number of threads, 1 to propagate serially
+       */
+      void setPropagationThreads(int n);
+      int propThreads;		/**< number of threads processing a priority block, including the caller */
+      std::vector<boost::thread*> propWorkers; /**< worker threads, propThreads-1 of them */
+      boost::barrier *propBarrier;	/**< synchronizes the phases of a parallel block update */
+      bool propQuit;		/**< tells the workers to exit */
+      int *propBlock;		/**< priority block being processed */
+      int propBlockN;		/**< number of cells in propBlock */
+      float *propPot;		/**< new potential of each cell in propBlock, POT_HIGH if unchanged */
+      unsigned char *propMask;	/**< neighbors each cell in propBlock pushes, PROPLEFT etc. */
+      int propSize;		/**< size of propPot and propMask, the largest pbSize of both wavefronts */
+      bool *propDirty;		/**< cells lowered so far while applying a block */
+
+      void propWorker(int t);	/**< worker thread loop */
+      void propBlockParallel();	/**< processes the current priority block across the threads */
+      void propSliceUpdate(int t); /**< computes new potentials and pushes for slice <t> of the block */
       /**
        * @brief  Run propagation for <cycles> iterations, or until start is reached using the best-first A* method with Euclidean distance heuristic
        * @param cycles The maximum number of iterations to run for
@@ -226,6 +380,32 @@ positions at about 1/2 cell resolution; else returns 0.
        */
       bool propNavFnAstar(int cycles); /**< returns true if start point found */
 
+      /** incremental propagation (LPA*) */
+      typedef std::pair<float,int> IncEntry;	/**< priority queue entry, key and cell */
+      typedef std::priority_queue<IncEntry, std::vector<IncEntry>, std::greater<IncEntry> > IncQueue;
+      float *rhsarr;		/**< one-step lookahead potentials, potarr holds the settled values */
+      bool incValid;		/**< whether potarr and rhsarr hold an incremental navigation function */
+      int incGoal;			/**< goal cell the incremental navigation function was seeded from */
+      std::vector<int> incChanged;	/**< cells whose cost changed since the last incremental propagation */
+      IncQueue incQueue;		/**< inconsistent cells, ordered by key */
+
+      /**
+       * @brief  Resets the incremental navigation function from a Dijkstra propagation seeded at the current goal
+       */
+      void setupNavFnIncremental();
+
+      /**
+       * @brief  Recomputes the lookahead potential of cell n from its neighbors, queueing it if it is inconsistent
+       * @param n The index to update
+       */
+      void updateVertex(int n);
+
+      /**
+       * @brief  Run incremental propagation until the start cell and its surroundings are consistent
+       * @return true if the start point is reached
+       */
+      bool propNavFnIncremental(); /**< returns true if start point found */
+
       /** gradient and paths */
       float *gradx, *grady;		/**< gradient arrays, size of potential array */
       float *pathx, *pathy;		/**< path points, as subpixel cell coordinates */
@@ -245,6 +425,17 @@ positions at about 1/2 cell resolution; else returns 0.
       float gradCell(int n);	/**< calculates gradient at cell <n>, returns norm */
       float pathStep;		/**< step size for following gradient */
 
+      /**
+       * @brief  Straightens the last path found, replacing stretches of it by lines that go through no costlier 
+       * cells than the stretch itself, with points every pathStep along them
+       * @return The length of the smoothed path
+       */
+      int smoothPath();
+      bool lineClear(float x0, float y0, float x1, float y1, COSTTYPE maxc); /**< whether the line stays in cells of cost <maxc> or less */
+      COSTTYPE pathCost(float x, float y); /**< cost of the cell a path point is in */
+      void addPathLine(float x0, float y0, float x1, float y1); /**< adds points along a line, excluding its start, to smoothX/Y */
+      std::vector<float> smoothX, smoothY; /**< smoothed path, kept to avoid reallocation */
+
       /** display callback */
       void display(void fn(NavFn *nav), int n = 100); /**< <n> is the number of cycles between updates  */
       int displayInt;		/**< save second argument of display() above */
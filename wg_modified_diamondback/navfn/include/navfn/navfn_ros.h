@@ -115,14 +115,14 @@ namespace navfn {
       /**
        * @brief Get the potential, or naviagation cost, at a given point in the world (Note: You should call computePotential first)
        * @param world_point The point to get the potential for 
-       * @return The navigation function's value at that point in the world
+       * @return The navigation function's value at that point in the world, DBL_MAX if the point is off the map or the last plan was incremental
        */
       double getPointPotential(const geometry_msgs::Point& world_point);
 
       /**
        * @brief Check for a valid potential value at a given point in the world (Note: You should call computePotential first)
        * @param world_point The point to get the potential for 
-       * @return True if the navigation function is valid at that point in the world, false otherwise
+       * @return True if the navigation function is valid at that point in the world, false otherwise or if the last plan was incremental
        */
       bool validPointPotential(const geometry_msgs::Point& world_point);
 
@@ -130,7 +130,7 @@ namespace navfn {
        * @brief Check for a valid potential value at a given point in the world (Note: You should call computePotential first)
        * @param world_point The point to get the potential for 
        * @param tolerance The tolerance on searching around the world_point specified
-       * @return True if the navigation function is valid at that point in the world, false otherwise
+       * @return True if the navigation function is valid at that point in the world, false otherwise or if the last plan was incremental
        */
       bool validPointPotential(const geometry_msgs::Point& world_point, double tolerance);
 
@@ -154,7 +154,9 @@ namespace navfn {
       double inscribed_radius_, circumscribed_radius_, inflation_radius_;
       ros::Publisher plan_pub_;
       pcl_ros::Publisher<PotarrPoint> potarr_pub_;
-      bool initialized_, allow_unknown_, visualize_potential_;
+      pcl::PointCloud<PotarrPoint> pot_area_;
+      bool initialized_, allow_unknown_, visualize_potential_, use_incremental_, bidirectional_, smooth_path_;
+      int potential_stride_;
 
 
     private:
@@ -165,6 +167,48 @@ namespace navfn {
       }
 
       void mapToWorld(double mx, double my, double& wx, double& wy);
+
+      /**
+       * @brief  Convert the path last computed by the planner to a plan in the global frame
+       * @param reverse Whether the path runs from the goal to the start and needs to be reversed
+       * @param plan The plan... filled with the path
+       */
+      void getPlanFromPath(bool reverse, std::vector<geometry_msgs::PoseStamped>& plan);
+
+      //the incremental planner seeds the potential at the goal, so it can't be queried for paths from the start
+      bool potential_at_goal_;
+
+      /**
+       * @brief  Copy the costmap for a plan from the start pose, clear the robot's cell and hand the costs to the planner
+       * @param start The start pose
+       * @param map_start The cell of the start pose... filled in
+       * @return True if the start pose is in the global frame and on the map, false otherwise
+       */
+      bool setupPlanner(const geometry_msgs::PoseStamped& start, int map_start[2]);
+
+      /**
+       * @brief  Publish the potential of the cells the last propagation reached, for every potential_stride_-th cell
+       */
+      void publishPotential();
+
+      /**
+       * @brief  Find the cell with a potential closest to a point in the world, searching outward from the point's cell
+       * @param world_point The point to search around, which may be off the map
+       * @param tolerance How far from the point to search, in meters
+       * @param mx The x coordinate of the cell found
+       * @param my The y coordinate of the cell found
+       * @return True if a cell with a potential was found, false otherwise
+       */
+      bool getReachedCell(const geometry_msgs::Point& world_point, double tolerance, int& mx, int& my);
+
+      /**
+       * @brief  Extract a plan to the goal, or to the closest point within tolerance of it, from the computed potential
+       * @param goal The goal pose
+       * @param tolerance The tolerance on the goal point
+       * @param plan The plan... filled with the path and the goal, empty if none is found
+       * @return True if a plan was found, false otherwise
+       */
+      bool getPlanNearGoal(const geometry_msgs::PoseStamped& goal, double tolerance, std::vector<geometry_msgs::PoseStamped>& plan);
       void clearRobotCell(const tf::Stamped<tf::Pose>& global_pose, unsigned int mx, unsigned int my);
       costmap_2d::Costmap2D costmap_;
       double planner_window_x_, planner_window_y_, default_tolerance_;
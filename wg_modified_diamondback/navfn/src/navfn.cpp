@@ -45,6 +45,9 @@
 
 #include <navfn/navfn.h>
 #include <ros/console.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 namespace navfn {
 
@@ -114,16 +117,50 @@ namespace navfn {
     potarr = NULL;
     pending = NULL;
     gradx = grady = NULL;
+    rawarr = NULL;
+    costLutValid = false;
+    rhsarr = NULL;
+    propDirty = NULL;
+    waveB.potarr = NULL;
+    waveB.pending = NULL;
+    waveB.pb1 = waveB.pb2 = waveB.pb3 = NULL;
+    incValid = false;
+    incGoal = -1;
+    nx = ny = ns = 0;
+    nobs = 0;
     setNavArr(xs,ys);
 
     // priority buffers
-    pb1 = new int[PRIORITYBUFSIZE];
-    pb2 = new int[PRIORITYBUFSIZE];
-    pb3 = new int[PRIORITYBUFSIZE];
+    pbSize = PRIORITYBUFSIZE;
+    pb1 = new int[pbSize];
+    pb2 = new int[pbSize];
+    pb3 = new int[pbSize];
+    curP = nextP = overP = NULL;
+    statCycles = statCells = statMaxBlock = 0;
+
+    // no corridor
+    corridorScale = 0;
+    targetNext = 0;
+    corridorMargin = 0;
+    meetPot = POT_HIGH;
+    meetCell = -1;
+
+    // parallel propagation is off until asked for
+    propThreads = 1;
+    propBarrier = NULL;
+    propQuit = false;
+    propBlock = NULL;
+    propBlockN = 0;
+    propSize = pbSize;
+    propPot = new float[propSize];
+    propMask = new unsigned char[propSize];
 
     // for Dijkstra (breadth-first), set to COST_NEUTRAL
     // for A* (best-first), set to COST_NEUTRAL
     priInc = 2*COST_NEUTRAL;	
+    curInc = priInc;
+    levelMax = 0;
+    blockTarget = 0;
 
     // goal and start
     goal[0] = goal[1] = 0;
@@ -142,6 +179,13 @@ namespace navfn {
 
   NavFn::~NavFn()
   {
+    setPropagationThreads(1);	// stop the workers
+    if(propPot)
+      delete[] propPot;
+    if(propMask)
+      delete[] propMask;
+    if(propDirty)
+      delete[] propDirty;
     if(obsarr)
       delete[] obsarr;
     if(costarr)
@@ -154,6 +198,20 @@ namespace navfn {
       delete[] gradx;
     if(grady)
       delete[] grady;
+    if(rawarr)
+      delete[] rawarr;
+    if(rhsarr)
+      delete[] rhsarr;
+    if(waveB.potarr)
+      delete[] waveB.potarr;
+    if(waveB.pending)
+      delete[] waveB.pending;
+    if(waveB.pb1)
+      delete[] waveB.pb1;
+    if(waveB.pb2)
+      delete[] waveB.pb2;
+    if(waveB.pb3)
+      delete[] waveB.pb3;
     if(pathx)
       delete[] pathx;
     if(pathy)
@@ -194,6 +252,11 @@ namespace navfn {
   void
     NavFn::setNavArr(int xs, int ys)
     {
+      // keep the workspace if the size hasn't changed, setupNavFn() only
+      //   resets the cells that were used by the last propagation
+      if (xs == nx && ys == ny && potarr != NULL)
+        return;
+
       ROS_DEBUG("[NavFn] Array is %d x %d\n", xs, ys);
 
       nx = xs;
@@ -213,6 +276,20 @@ namespace navfn {
         delete[] gradx;
       if(grady)
         delete[] grady;
+      if(rawarr)
+        delete[] rawarr;
+      if(rhsarr)
+        delete[] rhsarr;
+      rhsarr = NULL;		// allocated by the first incremental plan
+      if(waveB.potarr)
+        delete[] waveB.potarr;
+      if(waveB.pending)
+        delete[] waveB.pending;
+      waveB.potarr = NULL;	// allocated by the first bidirectional plan
+      waveB.pending = NULL;
+      if(propDirty)
+        delete[] propDirty;
+      propDirty = NULL;		// allocated by the first parallel block
 
       obsarr = new COSTTYPE[ns];	// obstacles, 255 is obstacle
       memset(obsarr, 0, ns*sizeof(COSTTYPE));
@@ -223,6 +300,22 @@ namespace navfn {
       memset(pending, 0, ns*sizeof(bool));
       gradx = new float[ns];
       grady = new float[ns];
+      rawarr = new COSTTYPE[ns];
+
+      // everything needs a reset before the first propagation
+      potLo = gradLo = 0;
+      potHi = gradHi = ns-1;
+      curPe = nextPe = overPe = 0;
+      rawValid = false;
+      nobs = 0;
+      incValid = false;
+    }
+
+
+  void
+    NavFn::invalidateCostmap()
+    {
+      rawValid = false;
     }
 
 
@@ -233,68 +326,188 @@ namespace navfn {
   void
     NavFn::setCostmap(const COSTTYPE *cmap, bool isROS, bool allow_unknown)
     {
-      COSTTYPE *cm = costarr;
-      if (isROS)			// ROS-type cost array
+      // only rows that changed since the last call need translating,
+      //   unless the flags changed or costarr was set some other way
+      bool full = !rawValid || isROS != rawIsROS || allow_unknown != rawAllowUnknown;
+      if (full)
+        nobs = 0;
+
+      // a PGM map has no unknown space, and gets an obstacle border
+      bool unknown_free = allow_unknown || !isROS;
+      if (!costLutValid || unknown_free != costLutUnknown)
+        setCostLut(unknown_free);
+      int border = isROS ? 0 : 7;
+      int bx = std::min(border, nx);
+
+      if (incValid)
+        costRow.resize(nx);
+
+      COSTTYPE *raw = rawarr;
+      for (int i=0; i<ny; i++, cmap+=nx, raw+=nx)
       {
-        for (int i=0; i<ny; i++)
+        if (!full && memcmp(cmap, raw, nx*sizeof(COSTTYPE)) == 0)
+          continue;
+        memcpy(raw, cmap, nx*sizeof(COSTTYPE));
+
+        COSTTYPE *cm = costarr + i*nx;
+        if (incValid)
+          memcpy(&costRow[0], cm, nx*sizeof(COSTTYPE));
+        if (!full)
+          nobs -= countObs(cm, nx);
+
+        if (i < border || i > ny-1-border)
+        {
+          for (int j=0; j<nx; j++)
+            cm[j] = COST_OBS;
+        }
+        else
         {
-          int k=i*nx;
-          for (int j=0; j<nx; j++, k++, cmap++, cm++)
+          translateCosts(cmap, cm, nx);
+          for (int j=0; j<bx; j++)
           {
-            *cm = COST_OBS;
-            int v = *cmap;
-            if (v < COST_OBS_ROS)
-            {
-              v = COST_NEUTRAL+COST_FACTOR*v;
-              if (v >= COST_OBS)
-                v = COST_OBS-1;
-              *cm = v;
-            }
-            else if(v == COST_UNKNOWN_ROS && allow_unknown)
-            {
-              v = COST_OBS-1;
-              *cm = v;
-            }
+            cm[j] = COST_OBS;
+            cm[nx-1-j] = COST_OBS;
           }
         }
+
+        nobs += countObs(cm, nx);
+        if (incValid)
+        {
+          for (int j=0; j<nx; j++)
+            if (cm[j] != costRow[j])
+              incChanged.push_back(i*nx+j);
+        }
       }
 
-      else				// not a ROS map, just a PGM
+      rawValid = true;
+      rawIsROS = isROS;
+      rawAllowUnknown = allow_unknown;
+    }
+
+  // translation table from costmap values to navfn costs
+
+  void
+    NavFn::setCostLut(bool unknown_free)
+    {
+      for (int v=0; v<256; v++)
       {
-        for (int i=0; i<ny; i++)
+        int c = COST_OBS;
+        if (v < COST_OBS_ROS)
         {
-          int k=i*nx;
-          for (int j=0; j<nx; j++, k++, cmap++, cm++)
-          {
-            *cm = COST_OBS;
-            if (i<7 || i > ny-8 || j<7 || j > nx-8)
-              continue;	// don't do borders
-            int v = *cmap;
-            if (v < COST_OBS_ROS)
-            {
-              v = COST_NEUTRAL+COST_FACTOR*v;
-              if (v >= COST_OBS)
-                v = COST_OBS-1;
-              *cm = v;
-            }
-            else if(v == COST_UNKNOWN_ROS)
-            {
-              v = COST_OBS-1;
-              *cm = v;
-            }
-          }
+          c = COST_NEUTRAL+COST_FACTOR*v;
+          if (c >= COST_OBS)
+            c = COST_OBS-1;
+        }
+        else if (v == COST_UNKNOWN_ROS && unknown_free)
+          c = COST_OBS-1;
+        costLut[v] = c;
+      }
+      costLutValid = true;
+      costLutUnknown = unknown_free;
+    }
+
+
+  // translate <n> costmap values to navfn costs, 16 at a time with SSE2
+  //   when COSTTYPE is a byte... same result as the table
+
+  void
+    NavFn::translateCosts(const COSTTYPE *cmap, COSTTYPE *cm, int n)
+    {
+      int j = 0;
+#ifdef __SSE2__
+      if (sizeof(COSTTYPE) == 1)
+      {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i factor = _mm_set1_epi16(COST_FACTOR);
+        const __m128i neutral = _mm_set1_epi16(COST_NEUTRAL);
+        const __m128i obs = _mm_set1_epi8((char)COST_OBS);
+        const __m128i obs1 = _mm_set1_epi8((char)(COST_OBS-1));
+        const __m128i lethal = _mm_set1_epi8((char)COST_OBS_ROS);
+        const __m128i unknown = _mm_set1_epi8((char)COST_UNKNOWN_ROS);
+        const __m128i unknown_free = costLutUnknown ? _mm_set1_epi8((char)0xff) : zero;
+        for (; j+16 <= n; j+=16)
+        {
+          __m128i v = _mm_loadu_si128((const __m128i *)(cmap+j));
+
+          // COST_NEUTRAL+COST_FACTOR*v in 16 bits, saturated back to
+          //   bytes and capped at COST_OBS-1
+          __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(v, zero), factor), neutral);
+          __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(v, zero), factor), neutral);
+          __m128i c = _mm_min_epu8(_mm_packus_epi16(lo, hi), obs1);
+
+          // lethal and unknown values
+          __m128i is_lethal = _mm_cmpeq_epi8(_mm_max_epu8(v, lethal), v);
+          __m128i is_free_unknown = _mm_and_si128(_mm_cmpeq_epi8(v, unknown), unknown_free);
+          __m128i is_obs = _mm_andnot_si128(is_free_unknown, is_lethal);
+          c = _mm_or_si128(_mm_andnot_si128(is_lethal, c),
+                           _mm_or_si128(_mm_and_si128(is_obs, obs), _mm_and_si128(is_free_unknown, obs1)));
+
+          _mm_storeu_si128((__m128i *)(cm+j), c);
         }
+      }
+#endif
+      for (; j<n; j++)
+      {
+        int v = cmap[j];
+        cm[j] = v < 256 ? costLut[v] : COST_OBS;
+      }
+    }
+
 
+  // count the obstacle cells among <n> costs
+
+  int
+    NavFn::countObs(const COSTTYPE *cm, int n)
+    {
+      int count = 0;
+      int j = 0;
+#ifdef __SSE2__
+      if (sizeof(COSTTYPE) == 1)
+      {
+        const __m128i obs = _mm_set1_epi8((char)COST_OBS);
+        for (; j+16 <= n; j+=16)
+        {
+          __m128i v = _mm_loadu_si128((const __m128i *)(cm+j));
+          count += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(v, obs), v)));
+        }
       }
+#endif
+      for (; j<n; j++)
+        if (cm[j] >= COST_OBS)
+          count++;
+      return count;
     }
 
+
   bool
     NavFn::calcNavFnDijkstra(bool atStart)
     {
-      setupNavFn(true);
+      int cycles = std::max(nx*ny/20,nx+ny);
+      int startCell = start[1]*nx + start[0];
+      bool found = false;
+
+      // try the corridor first, growing it a couple of times
+      if (atStart && corridorScale > 0 && targetCells.empty())
+      {
+        float scale = corridorScale;
+        for (int i=0; i<3 && !found; i++, scale*=2)
+        {
+          setupNavFn(true);
+          markCorridor(scale);
+          propNavFnDijkstra(cycles,atStart);
+          clearCorridor();
+          found = potarr[startCell] < POT_HIGH;
+          if (!found)
+            ROS_DEBUG("[NavFn] No path in corridor of scale %0.1f\n", scale);
+        }
+      }
 
       // calculate the nav fn and path
-      propNavFnDijkstra(std::max(nx*ny/20,nx+ny),atStart);
+      if (!found)
+      {
+        setupNavFn(true);
+        propNavFnDijkstra(cycles,atStart);
+      }
 
       // path
       int len = calcPath(nx*4);
@@ -341,6 +554,56 @@ namespace navfn {
     }
 
 
+  //
+  // calculate navigation function incrementally, reusing the
+  //   potentials from the last call when the goal hasn't moved
+  //
+
+  bool
+    NavFn::calcNavFnIncremental()
+    {
+      setCostBorder();
+
+      int k = goal[0] + goal[1]*nx;
+      if (!incValid || k != incGoal)
+        setupNavFnIncremental();
+      else
+      {
+        // repair the cells whose cost changed
+        for (unsigned int i=0; i<incChanged.size(); i++)
+          updateVertex(incChanged[i]);
+        ROS_DEBUG("[NavFn] Repairing %d changed cells\n", (int)incChanged.size());
+      }
+      incChanged.clear();
+
+      // gradients are only valid for one set of potentials
+      for (int i=gradLo; i<=gradHi; i++)
+        gradx[i] = grady[i] = 0.0;
+      gradLo = ns;
+      gradHi = -1;
+
+      // calculate the nav fn and path
+      if (!propNavFnIncremental())
+      {
+        ROS_DEBUG("[NavFn] No path found\n");
+        return false;
+      }
+
+      int len = calcPath(nx*4);
+
+      if (len > 0)			// found plan
+      {
+        ROS_DEBUG("[NavFn] Path found, %d steps\n", len);
+        return true;
+      }
+      else
+      {
+        ROS_DEBUG("[NavFn] No path found\n");
+        return false;
+      }
+    }
+
+
   //
   // returning values
   //
@@ -381,15 +644,60 @@ namespace navfn {
 
 
   // inserting onto the priority blocks
+// a cell is in at most one buffer, so they never need to grow past ns
 #define push_cur(n)  { if (n>=0 && n<ns && !pending[n] && \
-    costarr[n]<COST_OBS && curPe<PRIORITYBUFSIZE) \
-  { curP[curPe++]=n; pending[n]=true; }}
+    costarr[n]<COST_OBS) \
+  { if (curPe>=pbSize) growPriorityBuffers(); \
+    curP[curPe++]=n; pending[n]=true; }}
 #define push_next(n) { if (n>=0 && n<ns && !pending[n] && \
-    costarr[n]<COST_OBS && nextPe<PRIORITYBUFSIZE) \
-  { nextP[nextPe++]=n; pending[n]=true; }}
+    costarr[n]<COST_OBS) \
+  { if (nextPe>=pbSize) growPriorityBuffers(); \
+    nextP[nextPe++]=n; pending[n]=true; }}
 #define push_over(n) { if (n>=0 && n<ns && !pending[n] && \
-    costarr[n]<COST_OBS && overPe<PRIORITYBUFSIZE) \
-  { overP[overPe++]=n; pending[n]=true; }}
+    costarr[n]<COST_OBS) \
+  { if (overPe>=pbSize) growPriorityBuffers(); \
+    overP[overPe++]=n; pending[n]=true; }}
+
+
+  // grow the priority buffers, the block pointers follow their buffers
+
+  void
+    NavFn::growPriorityBuffers()
+    {
+      int size = std::min(2*pbSize, std::max(ns, pbSize+1));
+      ROS_DEBUG("[NavFn] Growing priority buffers to %d\n", size);
+
+      int **bufs[3] = { &pb1, &pb2, &pb3 };
+      for (int b=0; b<3; b++)
+      {
+        int *old = *bufs[b];
+        int *buf = new int[size];
+        memcpy(buf, old, pbSize*sizeof(int));
+        if (curP == old) curP = buf;
+        if (nextP == old) nextP = buf;
+        if (overP == old) overP = buf;
+        if (propBlock == old) propBlock = buf;
+        delete[] old;
+        *bufs[b] = buf;
+      }
+
+      // the block scratch is shared by both wavefronts of a bidirectional
+      //   search, so it has to fit the larger one and never shrinks
+      if (size > propSize)
+      {
+        float *pot = new float[size];
+        memcpy(pot, propPot, propSize*sizeof(float));
+        delete[] propPot;
+        propPot = pot;
+        unsigned char *mask = new unsigned char[size];
+        memcpy(mask, propMask, propSize*sizeof(unsigned char));
+        delete[] propMask;
+        propMask = mask;
+        propSize = size;
+      }
+
+      pbSize = size;
+    }
 
 
   // Set up navigation potential arrays for new propagation
@@ -397,52 +705,99 @@ namespace navfn {
   void
     NavFn::setupNavFn(bool keepit)
     {
-      // reset values in propagation arrays
-      for (int i=0; i<ns; i++)
-      {
+      // reset values in propagation arrays... only the cells touched by the
+      //   last propagation can differ from their initial values
+      for (int i=potLo; i<=potHi; i++)
         potarr[i] = POT_HIGH;
-        if (!keepit) costarr[i] = COST_NEUTRAL;
+      for (int i=gradLo; i<=gradHi; i++)
         gradx[i] = grady[i] = 0.0;
+      potLo = gradLo = ns;
+      potHi = gradHi = -1;
+
+      if (!keepit)
+      {
+        for (int i=0; i<ns; i++)
+          costarr[i] = COST_NEUTRAL;
+        rawValid = false;
+      }
+
+      // the cost array was set directly, so count its obstacles
+      if (!rawValid)
+      {
+        COSTTYPE *pc = costarr;
+        int ntot = 0;
+        for (int i=0; i<ns; i++, pc++)
+        {
+          if (*pc >= COST_OBS)
+            ntot++;			// number of cells that are obstacles
+        }
+        nobs = ntot;
       }
 
       // outer bounds of cost array
-      COSTTYPE *pc;
-      pc = costarr;
-      for (int i=0; i<nx; i++)
-        *pc++ = COST_OBS;
-      pc = costarr + (ny-1)*nx;
-      for (int i=0; i<nx; i++)
-        *pc++ = COST_OBS;
-      pc = costarr;
-      for (int i=0; i<ny; i++, pc+=nx)
-        *pc = COST_OBS;
-      pc = costarr + nx - 1;
-      for (int i=0; i<ny; i++, pc+=nx)
-        *pc = COST_OBS;
+      setCostBorder();
+
+      // the potentials no longer belong to an incremental propagation
+      incValid = false;
+
+      // clear pending flags left in the priority buffers by the last
+      //   propagation, no other cells can be pending
+      for (int i=0; i<curPe; i++)
+        pending[curP[i]] = false;
+      for (int i=0; i<nextPe; i++)
+        pending[nextP[i]] = false;
+      for (int i=0; i<overPe; i++)
+        pending[overP[i]] = false;
 
       // priority buffers
       curT = COST_OBS;
+      curInc = priInc;
+      levelMax = 0;
+      targetNext = 0;
       curP = pb1; 
       curPe = 0;
       nextP = pb2;
       nextPe = 0;
       overP = pb3;
       overPe = 0;
-      memset(pending, 0, ns*sizeof(bool));
 
       // set goal
       int k = goal[0] + goal[1]*nx;
       initCost(k,0);
+    }
 
-      // find # of obstacle cells
+
+  // put an obstacle border around the cost array, so propagation never
+  //   has to check bounds
+
+  void
+    NavFn::setCostBorder()
+    {
+      COSTTYPE *pc;
+      pc = costarr;
+      for (int i=0; i<nx; i++, pc++)
+      {
+        if (*pc < COST_OBS) nobs++;
+        *pc = COST_OBS;
+      }
+      pc = costarr + (ny-1)*nx;
+      for (int i=0; i<nx; i++, pc++)
+      {
+        if (*pc < COST_OBS) nobs++;
+        *pc = COST_OBS;
+      }
       pc = costarr;
-      int ntot = 0;
-      for (int i=0; i<ns; i++, pc++)
+      for (int i=0; i<ny; i++, pc+=nx)
+      {
+        if (*pc < COST_OBS) nobs++;
+        *pc = COST_OBS;
+      }
+      pc = costarr + nx - 1;
+      for (int i=0; i<ny; i++, pc+=nx)
       {
-        if (*pc >= COST_OBS)
-          ntot++;			// number of cells that are obstacles
+        if (*pc < COST_OBS) nobs++;
+        *pc = COST_OBS;
       }
-      nobs = ntot;
     }
 
 
@@ -452,6 +807,8 @@ namespace navfn {
     NavFn::initCost(int k, float v)
     {
       potarr[k] = v;
+      if (k < potLo) potLo = k;
+      if (k > potHi) potHi = k;
       push_cur(k+1);
       push_cur(k-1);
       push_cur(k-nx);
@@ -522,6 +879,8 @@ namespace navfn {
           float ue = INVSQRT2*(float)costarr[n-nx];
           float de = INVSQRT2*(float)costarr[n+nx];
           potarr[n] = pot;
+          if (n < potLo) potLo = n;
+          if (n > potHi) potHi = n;
           if (pot < curT)	// low-cost buffer block 
           {
             if (l > pot+le) push_next(n-1);
@@ -614,6 +973,8 @@ namespace navfn {
           dist = sqrtf(dist)*(float)COST_NEUTRAL;
 
           potarr[n] = pot;
+          if (n < potLo) potLo = n;
+          if (n > potHi) potHi = n;
           pot += dist;
           if (pot < curT)	// low-cost buffer block 
           {
@@ -666,50 +1027,660 @@ namespace navfn {
         if (curPe > nwv)
           nwv = curPe;
 
-        // reset pending flags on current priority buffer
-        int *pb = curP;
-        int i = curPe;			
-        while (i-- > 0)		
-          pending[*(pb++)] = false;
-
-        // process current priority buffer
-        pb = curP; 
-        i = curPe;
-        while (i-- > 0)		
-          updateCell(*pb++);
+        propNavFnCycle();
 
         if (displayInt > 0 &&  (cycle % displayInt) == 0)
           displayFn(this);
 
-        // swap priority blocks curP <=> nextP
-        curPe = nextPe;
-        nextPe = 0;
+        // check if we've hit the Start cell, and any other targets
+        if (atStart)
+          if (potarr[startCell] < POT_HIGH && targetsReached())
+            break;
+      }
+
+      statCycles = cycle;
+      statCells = nc;
+      statMaxBlock = nwv;
+
+      ROS_DEBUG("[NavFn] Used %d cycles, %d cells visited (%d%%), priority buf max %d of %d\n", 
+          cycle,nc,(int)((nc*100.0)/(ns-nobs)),nwv,pbSize);
+
+      if (cycle < cycles) return true; // finished up here
+      else return false;
+    }
+
+
+  // process one priority block of the Dijkstra propagation
+
+  void
+    NavFn::propNavFnCycle(const float *other)
+    {
+      if (curPe > levelMax)
+        levelMax = curPe;
+
+      // reset pending flags on current priority buffer
+      for (int i=0; i<curPe; i++)
+        pending[curP[i]] = false;
+
+      // process current priority buffer, indexing it as the buffers may
+      //   grow while it is processed
+      if (propThreads > 1 && curPe >= PROPPARALLELMIN)
+        propBlockParallel();
+      else
+      {
+        for (int i=0; i<curPe; i++)
+          updateCell(curP[i]);
+      }
+
+      // look for cells the other wavefront has reached
+      if (other)
+      {
+        for (int i=0; i<curPe; i++)
+        {
+          int n = curP[i];
+          if (potarr[n] < POT_HIGH && other[n] < POT_HIGH && potarr[n] + other[n] < meetPot)
+          {
+            meetPot = potarr[n] + other[n];
+            meetCell = n;
+          }
+        }
+      }
+
+      // swap priority blocks curP <=> nextP
+      curPe = nextPe;
+      nextPe = 0;
+      int *pb = curP;		// swap buffers
+      curP = nextP;
+      nextP = pb;
+
+      // see if we're done with this priority level
+      if (curPe == 0)
+      {
+        // steer the block sizes of the next level toward the target,
+        //   going no lower than priInc, below which a level is just
+        //   the whole wavefront in a single block
+        if (blockTarget > 0)
+        {
+          if (levelMax > blockTarget)
+            curInc = std::max(curInc*0.8f, priInc);
+          else if (levelMax < blockTarget/2)
+            curInc = std::min(curInc*1.25f, 16*priInc);
+        }
+        levelMax = 0;
+
+        curT += curInc;	// increment priority threshold
+        curPe = overPe;	// set current to overflow block
+        overPe = 0;
         pb = curP;		// swap buffers
-        curP = nextP;
-        nextP = pb;
+        curP = overP;
+        overP = pb;
+      }
+    }
 
-        // see if we're done with this priority level
-        if (curPe == 0)
+
+  void
+    NavFn::setBlockTarget(int target)
+    {
+      blockTarget = target > 0 ? target : 0;
+    }
+
+
+  //
+  // corridor search
+  // cells outside an ellipse with the start and goal as foci are marked
+  //   pending, so the push macros never put them in a priority block
+  //
+
+  void
+    NavFn::setCorridor(float scale, int margin)
+    {
+      corridorScale = scale;
+      corridorMargin = margin;
+    }
+
+
+  void
+    NavFn::markCorridor(float scale)
+    {
+      corridorLo.resize(ny);
+      corridorHi.resize(ny);
+
+      // ellipse axes, from the distance between the foci
+      float cx = 0.5*(start[0] + goal[0]);
+      float cy = 0.5*(start[1] + goal[1]);
+      float fx = start[0] - goal[0];
+      float fy = start[1] - goal[1];
+      float fd = sqrtf(fx*fx + fy*fy);
+      float a = 0.5*(scale*fd) + corridorMargin + 1; // semi-major axis
+      float b2 = a*a - 0.25*fd*fd;	// semi-minor axis, squared
+      float ux = 1.0, uy = 0.0;
+      if (fd > 0)
+      {
+        ux = fx/fd;
+        uy = fy/fd;
+      }
+
+      // each row crosses the ellipse in one span, from the roots of
+      //   (along/a)^2 + (across/b)^2 = 1
+      float qa = ux*ux/(a*a) + uy*uy/b2;
+      for (int y=0; y<ny; y++)
+      {
+        float k = y - cy;
+        float qb = 2*k*ux*uy*(1.0/(a*a) - 1.0/b2);
+        float qc = k*k*(uy*uy/(a*a) + ux*ux/b2) - 1.0;
+        float disc = qb*qb - 4*qa*qc;
+        int lo = nx, hi = -1;
+        if (disc >= 0)
         {
-          curT += priInc;	// increment priority threshold
-          curPe = overPe;	// set current to overflow block
-          overPe = 0;
-          pb = curP;		// swap buffers
-          curP = overP;
-          overP = pb;
+          float sq = sqrtf(disc);
+          lo = (int)floorf(cx + (-qb - sq)/(2*qa));
+          hi = (int)ceilf(cx + (-qb + sq)/(2*qa));
+          if (lo < 0) lo = 0;
+          if (hi > nx-1) hi = nx-1;
         }
+        corridorLo[y] = lo;
+        corridorHi[y] = hi;
 
-        // check if we've hit the Start cell
-        if (atStart)
-          if (potarr[startCell] < POT_HIGH)
+        bool *pp = pending + y*nx;
+        if (lo > hi)
+          memset(pp, 1, nx*sizeof(bool));
+        else
+        {
+          memset(pp, 1, lo*sizeof(bool));
+          memset(pp + hi + 1, 1, (nx-1-hi)*sizeof(bool));
+        }
+      }
+
+      ROS_DEBUG("[NavFn] Corridor of scale %0.1f, semi-axes %0.1f and %0.1f cells\n", scale, a, sqrtf(b2));
+    }
+
+
+  void
+    NavFn::clearCorridor()
+    {
+      for (int y=0; y<ny; y++)
+      {
+        int lo = corridorLo[y], hi = corridorHi[y];
+        bool *pp = pending + y*nx;
+        if (lo > hi)
+          memset(pp, 0, nx*sizeof(bool));
+        else
+        {
+          memset(pp, 0, lo*sizeof(bool));
+          memset(pp + hi + 1, 0, (nx-1-hi)*sizeof(bool));
+        }
+      }
+    }
+
+
+  //
+  // targets for a propagation that answers several goals
+  //
+
+  void
+    NavFn::setTargets(const std::vector<int>& cells)
+    {
+      targetCells = cells;
+      targetNext = 0;
+    }
+
+
+  bool
+    NavFn::targetsReached()
+    {
+      // potentials only go down, so a target once reached stays reached
+      while (targetNext < targetCells.size() && potarr[targetCells[targetNext]] < POT_HIGH)
+        targetNext++;
+      return targetNext == targetCells.size();
+    }
+
+
+  //
+  // closest cell with a potential, searched ring by ring
+  // a cell on ring d is at least d cells away, so the search can stop
+  //   at the first ring further out than the best cell found
+  //
+
+  int
+    NavFn::findReachedCell(int x, int y, int radius)
+    {
+      int best = -1;
+      int bestD = 0;
+
+      // rings that miss the map entirely are skipped
+      int d = std::max(std::max(-x, x-(nx-1)), std::max(-y, y-(ny-1)));
+      if (d < 0) d = 0;
+
+      for (; d <= radius; d++)
+      {
+        if (best >= 0 && d*d > bestD)
+          break;
+
+        int y0 = std::max(y-d, 0);
+        int y1 = std::min(y+d, ny-1);
+        for (int j=y0; j<=y1; j++)
+        {
+          // the top and bottom rows of the ring are whole, the others just their ends
+          int step = (j == y-d || j == y+d) ? 1 : 2*d;
+          for (int i=x-d; i<=x+d; i+=step)
+          {
+            if (i < 0 || i >= nx)
+              continue;
+            int n = j*nx + i;
+            if (potarr[n] >= POT_HIGH)
+              continue;
+            int dd = (i-x)*(i-x) + (j-y)*(j-y);
+            if (best < 0 || dd < bestD || (dd == bestD && n < best))
+            {
+              best = n;
+              bestD = dd;
+            }
+          }
+        }
+      }
+
+      return best;
+    }
+
+
+  //
+  // bidirectional search
+  // one wavefront from the goal, one from the start, one block each in
+  //   turn, until no cell still to come can lower the best meeting cell
+  // the path is followed down both potentials from the meeting cell
+  //
+
+  void
+    NavFn::swapWave()
+    {
+      std::swap(potarr, waveB.potarr);
+      std::swap(pending, waveB.pending);
+      std::swap(pb1, waveB.pb1);
+      std::swap(pb2, waveB.pb2);
+      std::swap(pb3, waveB.pb3);
+      std::swap(curP, waveB.curP);
+      std::swap(nextP, waveB.nextP);
+      std::swap(overP, waveB.overP);
+      std::swap(curPe, waveB.curPe);
+      std::swap(nextPe, waveB.nextPe);
+      std::swap(overPe, waveB.overPe);
+      std::swap(pbSize, waveB.pbSize);
+      std::swap(curT, waveB.curT);
+      std::swap(curInc, waveB.curInc);
+      std::swap(levelMax, waveB.levelMax);
+      std::swap(potLo, waveB.potLo);
+      std::swap(potHi, waveB.potHi);
+      std::swap(goal[0], waveB.goal[0]);
+      std::swap(goal[1], waveB.goal[1]);
+    }
+
+
+  // lowest potential a cell still queued in the current wavefront can get
+
+  float
+    NavFn::queuedPot(const float *other, float &seam)
+    {
+      float lo = POT_HIGH;
+      seam = POT_HIGH;
+      int *bufs[3] = { curP, nextP, overP };
+      int ends[3] = { curPe, nextPe, overPe };
+      for (int b=0; b<3; b++)
+        for (int i=0; i<ends[b]; i++)
+        {
+          int n = bufs[b][i];
+
+          // same calculation as updateCell()
+          float u,d,l,r;
+          l = potarr[n-1];
+          r = potarr[n+1];
+          u = potarr[n-nx];
+          d = potarr[n+nx];
+
+          float ta, tc;
+          if (l<r) tc=l; else tc=r;
+          if (u<d) ta=u; else ta=d;
+
+          float hf = (float)costarr[n]; // traversability factor
+          float dc = tc-ta;		// relative cost between ta,tc
+          if (dc < 0) 		// ta is lowest
+          {
+            dc = -dc;
+            ta = tc;
+          }
+
+          float pot;
+          if (dc >= hf)		// if too large, use ta-only update
+            pot = ta+hf;
+          else			// two-neighbor interpolation update
+          {
+            float d = dc/hf;
+            float v = -0.2301*d*d + 0.5307*d + 0.7040;
+            pot = ta + hf*v;
+          }
+
+          if (potarr[n] < pot) pot = potarr[n];
+          if (pot < lo) lo = pot;
+          if (other[n] < POT_HIGH && pot + other[n] < seam) seam = pot + other[n];
+        }
+      return lo;
+    }
+
+
+  bool
+    NavFn::calcNavFnBidirectional()
+    {
+      if (waveB.potarr == NULL)
+      {
+        waveB.potarr = new float[ns];
+        waveB.pending = new bool[ns];
+        memset(waveB.pending, 0, ns*sizeof(bool));
+        waveB.potLo = 0;	// needs a full reset
+        waveB.potHi = ns-1;
+        waveB.curPe = waveB.nextPe = waveB.overPe = 0;
+        waveB.curP = waveB.nextP = waveB.overP = NULL;
+      }
+      if (waveB.pb1 == NULL)
+      {
+        waveB.pbSize = PRIORITYBUFSIZE;
+        waveB.pb1 = new int[waveB.pbSize];
+        waveB.pb2 = new int[waveB.pbSize];
+        waveB.pb3 = new int[waveB.pbSize];
+      }
+
+      // set up both wavefronts
+      setupNavFn(true);
+      waveB.goal[0] = start[0];
+      waveB.goal[1] = start[1];
+      swapWave();
+      setupNavFn(true);
+      swapWave();
+
+      meetPot = POT_HIGH;
+      meetCell = -1;
+      int cycles = std::max(nx*ny/20,nx+ny);
+      int cycle = 0;
+      int nwv = 0;			// max priority block size
+      for (; cycle < cycles; cycle++)
+      {
+        if (curPe == 0 && nextPe == 0)
+          break;
+        if (curPe > nwv) nwv = curPe;
+        propNavFnCycle(waveB.potarr);
+
+        swapWave();
+        bool done = curPe == 0 && nextPe == 0;
+        if (!done)
+        {
+          if (curPe > nwv) nwv = curPe;
+          propNavFnCycle(waveB.potarr);
+        }
+        swapWave();
+        if (done)
+          break;
+
+        // every potential still to come is built on a queued cell, so no
+        //   cell can lower the meeting potential once the lowest queued
+        //   potentials of both wavefronts add up to it; the thresholds
+        //   are a cheap first check, cells from the overflow block can
+        //   be below them; queued cells the other wavefront already
+        //   reached (the seam) must not add up to less either
+        if (meetCell >= 0 && (curT - curInc) + (waveB.curT - waveB.curInc) >= meetPot)
+        {
+          float seam, seamB;
+          float lo = queuedPot(waveB.potarr, seam);
+          swapWave();
+          lo += queuedPot(waveB.potarr, seamB);
+          swapWave();
+          if (lo >= meetPot && seam >= meetPot && seamB >= meetPot)
             break;
+        }
       }
 
-      ROS_DEBUG("[NavFn] Used %d cycles, %d cells visited (%d%%), priority buf max %d\n", 
-          cycle,nc,(int)((nc*100.0)/(ns-nobs)),nwv);
+      statCycles = cycle;
+      statMaxBlock = nwv;
 
-      if (cycle < cycles) return true; // finished up here
-      else return false;
+      ROS_DEBUG("[NavFn] Bidirectional search used %d cycles, meeting potential %0.1f\n", cycle, meetPot);
+
+      if (meetCell < 0)
+      {
+        ROS_DEBUG("[NavFn] No path found\n");
+        return false;
+      }
+      last_path_cost_ = meetPot;
+
+      // from the meeting cell down to the start, in the start's wavefront
+      int meet[2];
+      meet[0] = meetCell%nx;
+      meet[1] = meetCell/nx;
+      for (int i=gradLo; i<=gradHi; i++)
+        gradx[i] = grady[i] = 0.0;
+      gradLo = ns;
+      gradHi = -1;
+      swapWave();
+      int len = calcPath(nx*4, meet);
+      swapWave();
+      std::vector<float> bx(pathx, pathx+len), by(pathy, pathy+len);
+
+      // and from the meeting cell down to the goal
+      for (int i=gradLo; i<=gradHi; i++)
+        gradx[i] = grady[i] = 0.0;
+      gradLo = ns;
+      gradHi = -1;
+      int lenA = len > 0 ? calcPath(nx*4, meet) : 0;
+      if (lenA <= 0)
+      {
+        npath = 0;
+        ROS_DEBUG("[NavFn] No path found\n");
+        return false;
+      }
+
+      // join them into one path from the start to the goal
+      if (npathbuf < len + lenA)
+      {
+        float *px = new float[len + lenA];
+        float *py = new float[len + lenA];
+        memcpy(px, pathx, lenA*sizeof(float));
+        memcpy(py, pathy, lenA*sizeof(float));
+        delete[] pathx;
+        delete[] pathy;
+        pathx = px;
+        pathy = py;
+        npathbuf = len + lenA;
+      }
+      memmove(pathx + len - 1, pathx, lenA*sizeof(float));
+      memmove(pathy + len - 1, pathy, lenA*sizeof(float));
+      for (int i=0; i<len; i++)
+      {
+        pathx[i] = bx[len-1-i];
+        pathy[i] = by[len-1-i];
+      }
+      npath = len + lenA - 1;	// the meeting cell is in both
+
+      ROS_DEBUG("[NavFn] Path found, %d steps\n", npath);
+      return true;
+    }
+
+
+  //
+  // parallel processing of a priority block
+  // each thread takes a contiguous slice of the block and computes its
+  //   cells from the potentials as they were before the block, then the
+  //   calling thread applies them in block order
+  // the result is the same as the serial update, for any number of threads
+  //
+
+  void
+    NavFn::setPropagationThreads(int n)
+    {
+      if (n < 1)
+        n = 1;
+
+      // stop the current workers
+      if (propBarrier)
+      {
+        propQuit = true;
+        propBarrier->wait();
+        for (unsigned int i=0; i<propWorkers.size(); i++)
+        {
+          propWorkers[i]->join();
+          delete propWorkers[i];
+        }
+        propWorkers.clear();
+        delete propBarrier;
+        propBarrier = NULL;
+        propQuit = false;
+      }
+
+      propThreads = n;
+      if (n == 1)
+        return;
+
+      ROS_DEBUG("[NavFn] Propagating with %d threads\n", n);
+      propBarrier = new boost::barrier(n);
+      for (int t=1; t<n; t++)
+        propWorkers.push_back(new boost::thread(boost::bind(&NavFn::propWorker, this, t)));
+    }
+
+
+  void
+    NavFn::propWorker(int t)
+    {
+      while (true)
+      {
+        propBarrier->wait();	// wait for a block
+        if (propQuit)
+          return;
+        propSliceUpdate(t);
+        propBarrier->wait();	// block done
+      }
+    }
+
+
+  // the serial update sees the cells earlier in the block already
+  //   lowered, so cells next to one of them are redone the serial way;
+  //   the rest got the same result from the old potentials
+
+  void
+    NavFn::propBlockParallel()
+    {
+      propBlock = curP;
+      propBlockN = curPe;
+      if (propDirty == NULL)
+      {
+        propDirty = new bool[ns];
+        memset(propDirty, 0, ns*sizeof(bool));
+      }
+
+      // the calling thread takes slice 0
+      propBarrier->wait();
+      propSliceUpdate(0);
+      propBarrier->wait();
+
+      // apply the new potentials and pushes, in the order the serial
+      //   update would make them; pushes can grow the buffers, so
+      //   everything is indexed through the members
+      for (int i=0; i<propBlockN; i++)
+      {
+        int n = propBlock[i];
+        if (propDirty[n-1] || propDirty[n+1] || propDirty[n-nx] || propDirty[n+nx])
+        {
+          float pot = potarr[n];
+          updateCell(n);
+          propDirty[n] = potarr[n] < pot;
+        }
+        else if (propPot[i] < POT_HIGH)
+        {
+          int m = propMask[i];
+          potarr[n] = propPot[i];
+          if (n < potLo) potLo = n;
+          if (n > potHi) potHi = n;
+          if (m & PROPOVER)
+          {
+            if (m & PROPLEFT) push_over(n-1);
+            if (m & PROPRIGHT) push_over(n+1);
+            if (m & PROPUP) push_over(n-nx);
+            if (m & PROPDOWN) push_over(n+nx);
+          }
+          else
+          {
+            if (m & PROPLEFT) push_next(n-1);
+            if (m & PROPRIGHT) push_next(n+1);
+            if (m & PROPUP) push_next(n-nx);
+            if (m & PROPDOWN) push_next(n+nx);
+          }
+          propDirty[n] = true;
+        }
+      }
+
+      for (int i=0; i<propBlockN; i++)
+        propDirty[propBlock[i]] = false;
+    }
+
+
+  // same calculation as updateCell(), but only reads potarr
+
+  void
+    NavFn::propSliceUpdate(int t)
+    {
+      int i0 = (int)((long)propBlockN*t/propThreads);
+      int i1 = (int)((long)propBlockN*(t+1)/propThreads);
+
+      for (int i=i0; i<i1; i++)
+      {
+        int n = propBlock[i];
+        propPot[i] = POT_HIGH;
+        propMask[i] = 0;
+        if (costarr[n] >= COST_OBS)	// don't propagate into obstacles
+          continue;
+
+        // get neighbors
+        float u,d,l,r;
+        l = potarr[n-1];
+        r = potarr[n+1];		
+        u = potarr[n-nx];
+        d = potarr[n+nx];
+
+        // find lowest, and its lowest neighbor
+        float ta, tc;
+        if (l<r) tc=l; else tc=r;
+        if (u<d) ta=u; else ta=d;
+
+        // do planar wave update
+        float hf = (float)costarr[n]; // traversability factor
+        float dc = tc-ta;		// relative cost between ta,tc
+        if (dc < 0) 		// ta is lowest
+        {
+          dc = -dc;
+          ta = tc;
+        }
+
+        // calculate new potential
+        float pot;
+        if (dc >= hf)		// if too large, use ta-only update
+          pot = ta+hf;
+        else			// two-neighbor interpolation update
+        {
+          float d = dc/hf;
+          float v = -0.2301*d*d + 0.5307*d + 0.7040;
+          pot = ta + hf*v;
+        }
+
+        // note affected neighbors for the priority blocks
+        if (pot < potarr[n])
+        {
+          float le = INVSQRT2*(float)costarr[n-1];
+          float re = INVSQRT2*(float)costarr[n+1];
+          float ue = INVSQRT2*(float)costarr[n-nx];
+          float de = INVSQRT2*(float)costarr[n+nx];
+          unsigned char m = pot < curT ? 0 : PROPOVER;
+          if (l > pot+le) m |= PROPLEFT;
+          if (r > pot+re) m |= PROPRIGHT;
+          if (u > pot+ue) m |= PROPUP;
+          if (d > pot+de) m |= PROPDOWN;
+          propPot[i] = pot;
+          propMask[i] = m;
+        }
+      }
     }
 
 
@@ -750,16 +1721,13 @@ namespace navfn {
           nwv = curPe;
 
         // reset pending flags on current priority buffer
-        int *pb = curP;
-        int i = curPe;			
-        while (i-- > 0)		
-          pending[*(pb++)] = false;
+        for (int i=0; i<curPe; i++)
+          pending[curP[i]] = false;
 
-        // process current priority buffer
-        pb = curP; 
-        i = curPe;
-        while (i-- > 0)		
-          updateCellAstar(*pb++);
+        // process current priority buffer, indexing it as the buffers may
+        //   grow while it is processed
+        for (int i=0; i<curPe; i++)
+          updateCellAstar(curP[i]);
 
         if (displayInt > 0 &&  (cycle % displayInt) == 0)
           displayFn(this);
@@ -767,7 +1735,7 @@ namespace navfn {
         // swap priority blocks curP <=> nextP
         curPe = nextPe;
         nextPe = 0;
-        pb = curP;		// swap buffers
+        int *pb = curP;		// swap buffers
         curP = nextP;
         nextP = pb;
 
@@ -790,8 +1758,12 @@ namespace navfn {
 
       last_path_cost_ = potarr[startCell];
 
-      ROS_DEBUG("[NavFn] Used %d cycles, %d cells visited (%d%%), priority buf max %d\n", 
-          cycle,nc,(int)((nc*100.0)/(ns-nobs)),nwv);
+      statCycles = cycle;
+      statCells = nc;
+      statMaxBlock = nwv;
+
+      ROS_DEBUG("[NavFn] Used %d cycles, %d cells visited (%d%%), priority buf max %d of %d\n", 
+          cycle,nc,(int)((nc*100.0)/(ns-nobs)),nwv,pbSize);
 
 
       if (potarr[startCell] < POT_HIGH) return true; // finished up here
@@ -805,6 +1777,146 @@ namespace navfn {
   }
 
 
+  //
+  // incremental propagation function
+  // Lifelong Planning A* with a zero heuristic, i.e. an incremental
+  //   Dijkstra ordered by potential
+  // potarr holds the settled potentials, rhsarr the potentials computed
+  //   from the neighbors; cells where they differ are in the queue
+  // the planar-wave update only depends on neighbors with lower
+  //   potentials, so cells settle in key order just as in Dijkstra
+  // a moving start only changes where the propagation stops
+  //
+
+  void
+    NavFn::setupNavFnIncremental()
+    {
+      if (rhsarr == NULL)
+        rhsarr = new float[ns];
+
+      // the bucketed Dijkstra wave is much cheaper than settling every
+      //   cell through the queue, so a fresh navigation function comes
+      //   from it and is then taken over by the incremental propagation
+      setupNavFn(true);
+      propNavFnDijkstra(std::max(nx*ny/20,nx+ny), true);
+
+      // cells the wave has settled are consistent
+      memcpy(rhsarr, potarr, ns*sizeof(float));
+      incQueue = IncQueue();
+      incChanged.clear();
+      incGoal = goal[0] + goal[1]*nx;
+
+      // cells still waiting in the priority buffers are not
+      for (int i=0; i<curPe; i++)
+        updateVertex(curP[i]);
+      for (int i=0; i<nextPe; i++)
+        updateVertex(nextP[i]);
+      for (int i=0; i<overPe; i++)
+        updateVertex(overP[i]);
+      incValid = true;
+    }
+
+
+  inline void
+    NavFn::updateVertex(int n)
+    {
+      if (n == incGoal)
+        return;
+
+      float rhs = POT_HIGH;
+      if (costarr[n] < COST_OBS)	// don't propagate into obstacles
+      {
+        // same planar-wave update as updateCell()
+        float u,d,l,r;
+        l = potarr[n-1];
+        r = potarr[n+1];
+        u = potarr[n-nx];
+        d = potarr[n+nx];
+
+        float ta, tc;
+        if (l<r) tc=l; else tc=r;
+        if (u<d) ta=u; else ta=d;
+
+        if (ta < POT_HIGH || tc < POT_HIGH)
+        {
+          float hf = (float)costarr[n]; // traversability factor
+          float dc = tc-ta;		// relative cost between ta,tc
+          if (dc < 0) 		// ta is lowest
+          {
+            dc = -dc;
+            ta = tc;
+          }
+
+          if (dc >= hf)		// if too large, use ta-only update
+            rhs = ta+hf;
+          else			// two-neighbor interpolation update
+          {
+            float d = dc/hf;
+            float v = -0.2301*d*d + 0.5307*d + 0.7040;
+            rhs = ta + hf*v;
+          }
+        }
+      }
+
+      rhsarr[n] = rhs;
+      float g = potarr[n];
+      if (g != rhs)
+        incQueue.push(IncEntry(g < rhs ? g : rhs, n));
+    }
+
+
+  // update the neighbors of a cell that changed potential
+#define update_vertex(n) { if (n>=0 && n<ns && costarr[n]<COST_OBS) updateVertex(n); }
+
+  bool
+    NavFn::propNavFnIncremental()
+    {
+      int nc = 0;			// number of cells settled or reset
+      int startCell = start[1]*nx + start[0];
+
+      while (!incQueue.empty())
+      {
+        IncEntry top = incQueue.top();
+
+        // stop once the start is settled and everything that the path
+        //   gradient can look at around it is too
+        if (potarr[startCell] == rhsarr[startCell] &&
+            top.first > potarr[startCell] + 2*COST_OBS)
+          break;
+
+        incQueue.pop();
+        int n = top.second;
+        float g = potarr[n];
+        float rhs = rhsarr[n];
+        if (g == rhs || top.first != (g < rhs ? g : rhs))
+          continue;		// stale entry
+
+        nc++;
+        if (g > rhs)		// lowered, settle it
+        {
+          potarr[n] = rhs;
+          if (n < potLo) potLo = n;
+          if (n > potHi) potHi = n;
+        }
+        else			// raised, reset it and let it be recomputed
+        {
+          potarr[n] = POT_HIGH;
+          updateVertex(n);
+        }
+        update_vertex(n-1);
+        update_vertex(n+1);
+        update_vertex(n-nx);
+        update_vertex(n+nx);
+      }
+
+      last_path_cost_ = potarr[startCell];
+
+      ROS_DEBUG("[NavFn] Incremental update of %d cells, %d queued\n", nc, (int)incQueue.size());
+
+      return potarr[startCell] < POT_HIGH;
+    }
+
+
   //
   // Path construction
   // Find gradient at array points, interpolate path
@@ -970,6 +2082,100 @@ namespace navfn {
     }
 
 
+  //
+  // path smoothing
+  // follows the path from an anchor point as far as a straight line
+  //   stays in cells no costlier than those the path itself goes through,
+  //   then starts again from the last point reached
+  // the lines get points every pathStep, so the path stays dense
+  //
+
+#define SMOOTHMAXPTS 200		// longest stretch replaced by one line, in points
+
+  int
+    NavFn::smoothPath()
+    {
+      if (npath < 3)
+        return npath;
+
+      smoothX.clear();
+      smoothY.clear();
+      smoothX.push_back(pathx[0]);
+      smoothY.push_back(pathy[0]);
+
+      int a = 0;			// anchor point
+      COSTTYPE maxc = pathCost(pathx[0],pathy[0]);
+      for (int j=1; j<npath; j++)
+      {
+        COSTTYPE c = pathCost(pathx[j],pathy[j]);
+        if (c > maxc) maxc = c;
+        if (j-a > 1 && (j-a > SMOOTHMAXPTS || 
+                        !lineClear(pathx[a],pathy[a],pathx[j],pathy[j],maxc)))
+        {
+          addPathLine(pathx[a],pathy[a],pathx[j-1],pathy[j-1]);
+          a = j-1;
+          maxc = std::max(pathCost(pathx[a],pathy[a]), c);
+        }
+      }
+      addPathLine(pathx[a],pathy[a],pathx[npath-1],pathy[npath-1]);
+
+      // copy back
+      int n = smoothX.size();
+      if (npathbuf < n)
+      {
+        delete [] pathx;
+        delete [] pathy;
+        pathx = new float[n];
+        pathy = new float[n];
+        npathbuf = n;
+      }
+      memcpy(pathx, &smoothX[0], n*sizeof(float));
+      memcpy(pathy, &smoothY[0], n*sizeof(float));
+      npath = n;
+
+      ROS_DEBUG("[Path] Smoothed path has %d points\n", npath);
+      return npath;
+    }
+
+
+  COSTTYPE
+    NavFn::pathCost(float x, float y)
+    {
+      return costarr[(int)(y+0.5)*nx + (int)(x+0.5)];
+    }
+
+
+  bool
+    NavFn::lineClear(float x0, float y0, float x1, float y1, COSTTYPE maxc)
+    {
+      // check the points addPathLine() would put on the line, and halfway between them
+      float dx = x1-x0;
+      float dy = y1-y0;
+      int k = (int)ceil(sqrtf(dx*dx+dy*dy)/pathStep);
+      if (k < 1) k = 1;
+      for (int i=1; i<=k; i++)
+        if (pathCost(x0 + dx*i/k, y0 + dy*i/k) > maxc ||
+            pathCost(x0 + dx*(i-0.5f)/k, y0 + dy*(i-0.5f)/k) > maxc)
+          return false;
+      return true;
+    }
+
+
+  void
+    NavFn::addPathLine(float x0, float y0, float x1, float y1)
+    {
+      float dx = x1-x0;
+      float dy = y1-y0;
+      int k = (int)ceil(sqrtf(dx*dx+dy*dy)/pathStep);
+      if (k < 1) k = 1;
+      for (int i=1; i<=k; i++)
+      {
+        smoothX.push_back(x0 + dx*i/k);
+        smoothY.push_back(y0 + dy*i/k);
+      }
+    }
+
+
   //
   // gradient calculations
   //
@@ -979,7 +2185,7 @@ namespace navfn {
   float				
     NavFn::gradCell(int n)
     {
-      if (gradx[n]+grady[n] > 0.0)	// check this cell
+      if (gradx[n] != 0.0 || grady[n] != 0.0)	// already calculated since the potential was reset
         return 1.0;			
 
       if (n < nx || n > ns-nx)	// would be out of bounds
@@ -1025,6 +2231,8 @@ namespace navfn {
         norm = 1.0/norm;
         gradx[n] = norm*dx;
         grady[n] = norm*dy;
+        if (n < gradLo) gradLo = n;
+        if (n > gradHi) gradHi = n;
       }
       return norm;
     }
@@ -0,0 +1,329 @@
+//
+// headless benchmark of the nav fn planner
+// loads costmaps from PGM files or static map caches written by
+//   costmap_2d, plans between random start and goal cells with
+//   create_nav_plan_astar(), calcNavFnDijkstra() and calcNavFnAstar(),
+//   and reports latency percentiles, cells expanded, path length
+//   and path cost for each
+//
+
+#include <navfn/navfn.h>
+#include <costmap_2d/costmap_2d.h>
+#include <sys/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+using namespace navfn;
+
+double get_ms()
+{
+  struct timeval t0;
+  gettimeofday(&t0,NULL);
+  double ret = t0.tv_sec * 1000.0;
+  ret += ((double)t0.tv_usec)*0.001;
+  return ret;
+}
+
+
+// reads an 8-bit PGM, binary (P5) or ASCII (P2)
+// <occupancy> is true for map_server style images, where dark cells
+//   are obstacles and 0xCC is unknown; otherwise the gray values are
+//   taken to be ROS costs, as written by NavFn::savemap()
+
+#define unknown_gray 0xCC	// seems to be the value of "unknown" in maps
+
+bool
+readPGM(const char *fname, bool occupancy, std::vector<COSTTYPE> &cmap, int *width, int *height)
+{
+  FILE *fp = fopen(fname,"rb");
+  if (!fp)
+    return false;
+
+  char magic[3] = {0,0,0};
+  int nx, ny, maxval;
+  if (fscanf(fp,"%2s",magic) != 1 || (strcmp(magic,"P5") && strcmp(magic,"P2")))
+  {
+    fclose(fp);
+    return false;
+  }
+
+  // skip comments between the header fields
+  int vals[3];
+  for (int i=0; i<3; i++)
+  {
+    int c;
+    while ((c = fgetc(fp)) != EOF && (c == '#' || isspace(c)))
+      if (c == '#')
+        while ((c = fgetc(fp)) != EOF && c != '\n');
+    ungetc(c,fp);
+    if (fscanf(fp,"%d",&vals[i]) != 1)
+    {
+      fclose(fp);
+      return false;
+    }
+  }
+  nx = vals[0];
+  ny = vals[1];
+  maxval = vals[2];
+  fgetc(fp);			// the single whitespace before the data
+
+  if (nx <= 0 || ny <= 0 || maxval <= 0 || maxval > 255)
+  {
+    fclose(fp);
+    return false;
+  }
+
+  cmap.resize(nx*ny);
+  bool ok = true;
+  if (magic[1] == '5')
+    ok = fread(&cmap[0],1,nx*ny,fp) == (size_t)(nx*ny);
+  else
+    for (int i=0; i<nx*ny && ok; i++)
+    {
+      int v;
+      ok = fscanf(fp,"%d",&v) == 1;
+      cmap[i] = v;
+    }
+  fclose(fp);
+
+  if (ok && occupancy)
+    for (int i=0; i<nx*ny; i++)
+    {
+      if (cmap[i] < unknown_gray)
+        cmap[i] = COST_OBS_ROS;
+      else if (cmap[i] == unknown_gray)
+        cmap[i] = COST_UNKNOWN_ROS;
+      else
+        cmap[i] = 0;
+    }
+
+  *width = nx;
+  *height = ny;
+  return ok;
+}
+
+
+// reads a static map cache, a costmap_2d::StaticMapFileHeader followed
+//   by the inflated static map
+
+bool
+readStaticMap(const char *fname, std::vector<COSTTYPE> &cmap, int *width, int *height)
+{
+  FILE *fp = fopen(fname,"rb");
+  if (!fp)
+    return false;
+
+  costmap_2d::StaticMapFileHeader header;
+  bool ok = fread(&header,sizeof(header),1,fp) == 1 &&
+    memcmp(header.magic,"CMAPSTAT",sizeof(header.magic)) == 0;
+  if (ok)
+  {
+    cmap.resize(header.size_x*header.size_y);
+    ok = fread(&cmap[0],1,cmap.size(),fp) == cmap.size();
+  }
+  fclose(fp);
+
+  *width = header.size_x;
+  *height = header.size_y;
+  return ok;
+}
+
+
+// results of one planner over all the queries on a map
+
+struct BenchResult
+{
+  const char *name;
+  std::vector<double> ms;	// planning time of each query
+  int found;			// queries with a path
+  double cells;			// cells taken from the priority blocks
+  double length;		// path length, in cells
+  double cost;			// path cost, the cost of the cells integrated along the path
+};
+
+
+// length and cost of a path of x,y points, in cells
+
+void
+pathStats(const float *x, const float *y, int n, const COSTTYPE *cm, int nx, double *length, double *cost)
+{
+  *length = *cost = 0;
+  for (int i=1; i<n; i++)
+  {
+    double d = hypot(x[i]-x[i-1], y[i]-y[i-1]);
+    int cx = (int)((x[i]+x[i-1])*0.5 + 0.5);
+    int cy = (int)((y[i]+y[i-1])*0.5 + 0.5);
+    *length += d;
+    *cost += d*cm[cy*nx+cx];
+  }
+}
+
+
+double
+percentile(std::vector<double> v, double p)
+{
+  if (v.empty())
+    return 0;
+  std::sort(v.begin(), v.end());
+  int i = (int)(p*(v.size()-1) + 0.5);
+  return v[i];
+}
+
+
+void
+report(const BenchResult &r, int queries)
+{
+  double sum = 0;
+  for (unsigned int i=0; i<r.ms.size(); i++)
+    sum += r.ms[i];
+  printf("[Bench]   %-24s found %d/%d  ms mean %.2f p50 %.2f p90 %.2f p99 %.2f max %.2f",
+         r.name, r.found, queries, sum/queries, percentile(r.ms,0.5), percentile(r.ms,0.9),
+         percentile(r.ms,0.99), percentile(r.ms,1.0));
+  if (r.cells >= 0)
+    printf("  cells %.0f", r.cells/queries);
+  else
+    printf("  cells -");
+  if (r.found > 0)
+    printf("  length %.1f  cost %.0f", r.length/r.found, r.cost/r.found);
+  printf("\n");
+}
+
+
+int main(int argc, char **argv)
+{
+  int queries = 1000;		// start/goal pairs per map
+  int seed = 1;
+  bool occupancy = false;	// PGMs are occupancy images rather than costs
+  std::vector<std::string> maps;
+
+  for (int i=1; i<argc; i++)
+  {
+    if (!strcmp(argv[i],"-n") && i+1 < argc)
+      queries = atoi(argv[++i]);
+    else if (!strcmp(argv[i],"-s") && i+1 < argc)
+      seed = atoi(argv[++i]);
+    else if (!strcmp(argv[i],"-o"))
+      occupancy = true;
+    else
+      maps.push_back(argv[i]);
+  }
+
+  if (maps.empty() || queries < 1)
+  {
+    printf("usage: %s [-n queries] [-s seed] [-o] map.pgm|map.cache ...\n", argv[0]);
+    printf("  PGM gray values are ROS costs, or occupancy with -o; other files are costmap_2d static map caches\n");
+    return 1;
+  }
+
+  for (unsigned int m=0; m<maps.size(); m++)
+  {
+    const char *fname = maps[m].c_str();
+    std::vector<COSTTYPE> cmap;
+    int nx, ny;
+    bool pgm = maps[m].size() > 4 && maps[m].substr(maps[m].size()-4) == ".pgm";
+    bool ok = pgm ? readPGM(fname,occupancy,cmap,&nx,&ny) : readStaticMap(fname,cmap,&nx,&ny);
+    if (!ok)
+    {
+      printf("[Bench] Can't read map %s\n", fname);
+      continue;
+    }
+
+    // translated costs for create_nav_plan_astar(), which takes the
+    //   buffer over and frees it when its planner is resized, so
+    //   each map gets its own copy that is never freed here
+    NavFn dijkstra(nx,ny);
+    NavFn astar(nx,ny);
+    dijkstra.setCostmap(&cmap[0], true, true);
+    astar.setCostmap(&cmap[0], true, true);
+    COSTTYPE *cm = new COSTTYPE[nx*ny];
+    memcpy(cm, dijkstra.costarr, nx*ny*sizeof(COSTTYPE));
+
+    // free cells away from the border to plan between
+    std::vector<int> freeCells;
+    for (int y=2; y<ny-2; y++)
+      for (int x=2; x<nx-2; x++)
+        if (cmap[y*nx+x] < COST_OBS_ROS-1)
+          freeCells.push_back(y*nx+x);
+    if (freeCells.size() < 2)
+    {
+      printf("[Bench] No free cells in map %s\n", fname);
+      continue;
+    }
+
+    printf("[Bench] %s: %d x %d, %d free cells, %d queries\n", fname, nx, ny, (int)freeCells.size(), queries);
+
+    BenchResult res[3];
+    res[0].name = "create_nav_plan_astar";
+    res[1].name = "calcNavFnDijkstra";
+    res[2].name = "calcNavFnAstar";
+    for (int k=0; k<3; k++)
+    {
+      res[k].found = 0;
+      res[k].cells = k == 0 ? -1 : 0;
+      res[k].length = res[k].cost = 0;
+    }
+
+    int nplan = std::max(nx,ny)*4;
+    std::vector<float> plan(2*nplan);
+    std::vector<float> px(nplan), py(nplan);
+
+    srand(seed);
+    for (int q=0; q<queries; q++)
+    {
+      int s = freeCells[rand()%freeCells.size()];
+      int g = freeCells[rand()%freeCells.size()];
+      int start[2] = { s%nx, s/nx };
+      int goal[2] = { g%nx, g/nx };
+      double length, cost;
+
+      // the C interface
+      double t0 = get_ms();
+      int len = create_nav_plan_astar(cm, nx, ny, goal, start, &plan[0], nplan);
+      res[0].ms.push_back(get_ms()-t0);
+      if (len > 0)
+      {
+        for (int i=0; i<len; i++)
+        {
+          px[i] = plan[i*2];
+          py[i] = plan[i*2+1];
+        }
+        pathStats(&px[0], &py[0], len, cm, nx, &length, &cost);
+        res[0].found++;
+        res[0].length += length;
+        res[0].cost += cost;
+      }
+
+      // Dijkstra and A*, on planners that keep their costs between queries
+      NavFn *navs[2] = { &dijkstra, &astar };
+      for (int k=1; k<3; k++)
+      {
+        NavFn *nav = navs[k-1];
+        nav->setGoal(goal);
+        nav->setStart(start);
+        t0 = get_ms();
+        bool found = k == 1 ? nav->calcNavFnDijkstra(true) : nav->calcNavFnAstar();
+        res[k].ms.push_back(get_ms()-t0);
+        res[k].cells += nav->statCells;
+        if (found)
+        {
+          pathStats(nav->getPathX(), nav->getPathY(), nav->getPathLen(), nav->costarr, nx, &length, &cost);
+          res[k].found++;
+          res[k].length += length;
+          res[k].cost += cost;
+        }
+      }
+    }
+
+    for (int k=0; k<3; k++)
+      report(res[k], queries);
+  }
+
+  return 0;
+}
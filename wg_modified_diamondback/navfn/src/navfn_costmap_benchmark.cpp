@@ -0,0 +1,126 @@
+//
+// timing test of NavFn::setCostmap()
+// translates a random costmap, checks the result against the per-cell
+//   translation and reports the time for full and partial updates
+//
+
+#include <navfn/navfn.h>
+#include <sys/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <vector>
+
+using namespace navfn;
+
+double get_ms()
+{
+  struct timeval t0;
+  gettimeofday(&t0,NULL);
+  double ret = t0.tv_sec * 1000.0;
+  ret += ((double)t0.tv_usec)*0.001;
+  return ret;
+}
+
+// the per-cell translation, as setCostmap() used to do it
+void
+refCostmap(const COSTTYPE *cmap, COSTTYPE *cm, int nx, int ny, bool isROS, bool allow_unknown)
+{
+  for (int i=0; i<ny; i++)
+    for (int j=0; j<nx; j++, cmap++, cm++)
+    {
+      *cm = COST_OBS;
+      if (!isROS && (i<7 || i > ny-8 || j<7 || j > nx-8))
+        continue;
+      int v = *cmap;
+      if (v < COST_OBS_ROS)
+      {
+        v = COST_NEUTRAL+COST_FACTOR*v;
+        if (v >= COST_OBS)
+          v = COST_OBS-1;
+        *cm = v;
+      }
+      else if (v == COST_UNKNOWN_ROS && (allow_unknown || !isROS))
+        *cm = COST_OBS-1;
+    }
+}
+
+int main(int argc, char **argv)
+{
+  int size = 4000;		// cells on a side
+  int reps = 20;		// translations timed
+
+  if (argc > 1)
+    size = atoi(argv[1]);
+  if (argc > 2)
+    reps = atoi(argv[2]);
+
+  if (size < 16 || reps < 1)
+  {
+    printf("usage: %s [size] [reps]\n", argv[0]);
+    return 1;
+  }
+
+  int nx = size, ny = size;
+  srand(1);
+
+  // all cost values show up, weighted toward free space
+  std::vector<COSTTYPE> cmap(nx*ny);
+  for (int i=0; i<nx*ny; i++)
+  {
+    int r = rand()%10;
+    cmap[i] = r < 5 ? 0 : (r < 9 ? rand()%256 : COST_OBS_ROS + rand()%3);
+  }
+  std::vector<COSTTYPE> ref(nx*ny);
+
+  NavFn nav(nx,ny);
+  bool ok = true;
+
+  for (int mode=0; mode<3; mode++)
+  {
+    bool isROS = mode < 2;
+    bool allow_unknown = mode == 0;
+
+    // reference timing
+    double t0 = get_ms();
+    for (int r=0; r<reps; r++)
+      refCostmap(&cmap[0], &ref[0], nx, ny, isROS, allow_unknown);
+    double t1 = get_ms();
+
+    // full translation each time
+    for (int r=0; r<reps; r++)
+    {
+      nav.invalidateCostmap();
+      nav.setCostmap(&cmap[0], isROS, allow_unknown);
+    }
+    double t2 = get_ms();
+
+    if (memcmp(nav.costarr, &ref[0], nx*ny*sizeof(COSTTYPE)) != 0)
+    {
+      printf("[Costmap] translation differs from reference, isROS %d allow_unknown %d\n", isROS, allow_unknown);
+      ok = false;
+    }
+
+    // a few changed rows each time
+    double tp = 0;
+    for (int r=0; r<reps; r++)
+    {
+      for (int c=0; c<8; c++)
+        cmap[(rand()%ny)*nx + rand()%nx] = rand()%256;
+      double ta = get_ms();
+      nav.setCostmap(&cmap[0], isROS, allow_unknown);
+      tp += get_ms()-ta;
+    }
+    refCostmap(&cmap[0], &ref[0], nx, ny, isROS, allow_unknown);
+    if (memcmp(nav.costarr, &ref[0], nx*ny*sizeof(COSTTYPE)) != 0)
+    {
+      printf("[Costmap] partial update differs from reference, isROS %d allow_unknown %d\n", isROS, allow_unknown);
+      ok = false;
+    }
+
+    printf("[Costmap] %d x %d, isROS %d allow_unknown %d: per-cell %.2f ms  full %.2f ms  partial %.3f ms\n",
+           nx, ny, isROS, allow_unknown, (t1-t0)/reps, (t2-t1)/reps, tp/reps);
+  }
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,164 @@
+//
+// timing test of incremental replanning against planning from scratch
+// builds a random building-like map, then repeatedly moves the robot
+//   along its plan and changes a few cells near it, the way the
+//   costmap changes between replans in move_base
+//
+
+#include <navfn/navfn.h>
+#include <sys/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <vector>
+
+using namespace navfn;
+
+double get_ms()
+{
+  struct timeval t0;
+  gettimeofday(&t0,NULL);
+  double ret = t0.tv_sec * 1000.0;
+  ret += ((double)t0.tv_usec)*0.001;
+  return ret;
+}
+
+// fill a box of the ROS costmap with a value
+void
+setBox(std::vector<COSTTYPE> &cmap, int nx, int ny, int x0, int y0, int w, int h, COSTTYPE v)
+{
+  for (int y=y0; y<y0+h && y<ny; y++)
+    for (int x=x0; x<x0+w && x<nx; x++)
+      if (x >= 0 && y >= 0)
+        cmap[y*nx+x] = v;
+}
+
+int main(int argc, char **argv)
+{
+  int size = 2000;		// cells on a side
+  int replans = 50;		// number of replans
+  int changes = 4;		// obstacles changed per replan
+
+  if (argc > 1)
+    size = atoi(argv[1]);
+  if (argc > 2)
+    replans = atoi(argv[2]);
+  if (argc > 3)
+    changes = atoi(argv[3]);
+
+  if (size < 100 || replans < 1 || changes < 0)
+  {
+    printf("usage: %s [size] [replans] [changes]\n", argv[0]);
+    return 1;
+  }
+
+  int nx = size, ny = size;
+  srand(1);
+
+  // rooms with doorways, plus some clutter and inflation-like costs
+  std::vector<COSTTYPE> cmap(nx*ny, 0);
+  for (int x=100; x<nx; x+=100)
+    setBox(cmap, nx, ny, x, 0, 2, ny, COST_OBS_ROS);
+  for (int y=100; y<ny; y+=100)
+    setBox(cmap, nx, ny, 0, y, nx, 2, COST_OBS_ROS);
+  for (int x=100; x<nx; x+=100)
+    for (int y=0; y<ny; y+=100)
+    {
+      setBox(cmap, nx, ny, x, y+20+rand()%50, 2, 12, 0);
+      setBox(cmap, nx, ny, y+20+rand()%50, x, 12, 2, 0);
+    }
+  for (int i=0; i<nx*ny/2000; i++)
+    setBox(cmap, nx, ny, rand()%nx, rand()%ny, 2+rand()%6, 2+rand()%6, COST_OBS_ROS);
+  for (int i=0; i<nx*ny; i++)
+    if (cmap[i] == 0)
+      cmap[i] = rand()%20;
+
+  int start[2], goal[2];
+  start[0] = start[1] = 50;
+  goal[0] = goal[1] = size-50;
+  setBox(cmap, nx, ny, start[0]-2, start[1]-2, 5, 5, 0);
+  setBox(cmap, nx, ny, goal[0]-2, goal[1]-2, 5, 5, 0);
+
+  NavFn full(nx,ny);
+  NavFn inc(nx,ny);
+
+  double t_full = 0, t_inc = 0, t_first = 0;
+  double max_diff = 0;
+  int n_full = 0, n_inc = 0, n_same = 0;
+
+  for (int r=0; r<=replans; r++)
+  {
+    if (r > 0)
+    {
+      // toggle a few small obstacles around the robot
+      for (int c=0; c<changes; c++)
+      {
+        int x = start[0] + rand()%80 - 40;
+        int y = start[1] + rand()%80 - 40;
+        setBox(cmap, nx, ny, x, y, 4, 4, (rand()%2) ? COST_OBS_ROS : 0);
+      }
+      setBox(cmap, nx, ny, start[0]-1, start[1]-1, 3, 3, 0);
+    }
+
+    // from scratch, seeded at the goal like the incremental plan so
+    //   that both compute the same navigation function
+    double t0 = get_ms();
+    full.setNavArr(nx,ny);
+    full.setCostmap(&cmap[0], true, true);
+    full.setStart(start);
+    full.setGoal(goal);
+    bool full_ok = full.calcNavFnDijkstra(true);
+    double t1 = get_ms();
+
+    // incremental
+    inc.setNavArr(nx,ny);
+    inc.setCostmap(&cmap[0], true, true);
+    inc.setStart(start);
+    inc.setGoal(goal);
+    bool inc_ok = inc.calcNavFnIncremental();
+    double t2 = get_ms();
+
+    if (r == 0)
+      t_first = t2-t1;
+    else
+    {
+      t_full += t1-t0;
+      t_inc += t2-t1;
+    }
+    if (full_ok) n_full++;
+    if (inc_ok) n_inc++;
+    if (full_ok == inc_ok) n_same++;
+
+    // the potential at the start is the cost of the path
+    int startCell = start[1]*nx + start[0];
+    float full_cost = full.potarr[startCell];
+    float inc_cost = inc.potarr[startCell];
+    if (full_ok && inc_ok)
+    {
+      double diff = fabs(inc_cost - full_cost) / full_cost;
+      if (diff > max_diff) max_diff = diff;
+    }
+
+    printf("[Replan %d] start %d,%d  scratch: %s %d pts cost %.0f %.1f ms  incremental: %s %d pts cost %.0f %.1f ms\n",
+           r, start[0], start[1], full_ok ? "ok" : "fail", full.getPathLen(), full_cost, t1-t0,
+           inc_ok ? "ok" : "fail", inc.getPathLen(), inc_cost, t2-t1);
+
+    if (!inc_ok)
+      break;
+
+    // move the robot a bit along the plan
+    int k = inc.getPathLen() > 20 ? 20 : inc.getPathLen()-1;
+    start[0] = (int)(inc.getPathX()[k] + 0.5);
+    start[1] = (int)(inc.getPathY()[k] + 0.5);
+  }
+
+  printf("\nMap %d x %d, %d replans, %d changes per replan\n", nx, ny, replans, changes);
+  printf("First incremental plan: %.1f ms\n", t_first);
+  printf("Replanning from scratch: %.2f ms/plan (%d found)\n", t_full/replans, n_full);
+  printf("Incremental replanning:  %.2f ms/plan (%d found)\n", t_inc/replans, n_inc);
+  printf("Agreement on success: %d of %d\n", n_same, replans+1);
+  printf("Largest path cost difference: %.3f%%\n", 100.0*max_diff);
+
+  return 0;
+}
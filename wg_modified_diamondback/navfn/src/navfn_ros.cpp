@@ -43,10 +43,10 @@ PLUGINLIB_DECLARE_CLASS(navfn, NavfnROS, navfn::NavfnROS, nav_core::BaseGlobalPl
 namespace navfn {
 
   NavfnROS::NavfnROS() 
-    : costmap_ros_(NULL),  planner_(), initialized_(false), allow_unknown_(true), costmap_publisher_(NULL) {}
+    : costmap_ros_(NULL),  planner_(), initialized_(false), allow_unknown_(true), use_incremental_(false), bidirectional_(false), smooth_path_(false), potential_stride_(1), potential_at_goal_(false), costmap_publisher_(NULL) {}
 
   NavfnROS::NavfnROS(std::string name, costmap_2d::Costmap2DROS* costmap_ros) 
-    : costmap_ros_(NULL),  planner_(), initialized_(false), allow_unknown_(true) {
+    : costmap_ros_(NULL),  planner_(), initialized_(false), allow_unknown_(true), use_incremental_(false), bidirectional_(false), smooth_path_(false), potential_stride_(1), potential_at_goal_(false) {
       //initialize the planner
       initialize(name, costmap_ros);
   }
@@ -69,10 +69,36 @@ namespace navfn {
       if(visualize_potential_)
         potarr_pub_.advertise(private_nh, "potential", 1);
 
+      //the potential can be sent for every n-th cell in each direction only, to keep the cloud small
+      private_nh.param("visualize_potential_stride", potential_stride_, 1);
+      if(potential_stride_ < 1)
+        potential_stride_ = 1;
+
       private_nh.param("allow_unknown", allow_unknown_, true);
       private_nh.param("planner_window_x", planner_window_x_, 0.0);
       private_nh.param("planner_window_y", planner_window_y_, 0.0);
       private_nh.param("default_tolerance", default_tolerance_, 0.0);
+      private_nh.param("use_incremental", use_incremental_, false);
+
+      //large priority blocks can be split across threads when propagating the navigation function
+      int propagation_threads;
+      private_nh.param("propagation_threads", propagation_threads, 1);
+      planner_->setPropagationThreads(propagation_threads);
+
+      //the priority threshold increment can adapt to keep priority levels near a target size, 0 keeps it fixed
+      int priority_block_target;
+      private_nh.param("priority_block_target", priority_block_target, 0);
+      planner_->setBlockTarget(priority_block_target);
+
+      //long plans can be limited to an ellipse around the start and goal, or searched from both ends
+      double corridor_scale, corridor_margin;
+      private_nh.param("corridor_scale", corridor_scale, 0.0);
+      private_nh.param("corridor_margin", corridor_margin, 1.0);
+      planner_->setCorridor(corridor_scale, (int) (corridor_margin / costmap_ros_->getResolution()));
+      private_nh.param("bidirectional", bidirectional_, false);
+
+      //paths can be straightened where that doesn't take them through costlier cells
+      private_nh.param("smooth_path", smooth_path_, false);
         
       double costmap_pub_freq;
       private_nh.param("planner_costmap_publish_frequency", costmap_pub_freq, 0.0);
@@ -110,25 +136,28 @@ namespace navfn {
       return false;
     }
 
-    double resolution = costmap_ros_->getResolution();
-    geometry_msgs::Point p;
-    p = world_point;
+    if(potential_at_goal_){
+      ROS_ERROR("The potential of the incremental planner is seeded at the goal, call computePotential before querying it");
+      return false;
+    }
 
-    p.y = world_point.y - tolerance;
+    int mx, my;
+    return getReachedCell(world_point, tolerance, mx, my);
+  }
 
-    while(p.y <= world_point.y + tolerance){
-      p.x = world_point.x - tolerance;
-      while(p.x <= world_point.x + tolerance){
-        double potential = getPointPotential(p);
-        if(potential < POT_HIGH){
-          return true;
-        }
-        p.x += resolution;
-      }
-      p.y += resolution;
-    }
+  bool NavfnROS::getReachedCell(const geometry_msgs::Point& world_point, double tolerance, int& mx, int& my){
+    //the search is centered on the cell the point falls in, even when that cell is off the map
+    double resolution = costmap_.getResolution();
+    int cx = (int) floor((world_point.x - costmap_.getOriginX()) / resolution);
+    int cy = (int) floor((world_point.y - costmap_.getOriginY()) / resolution);
+
+    int cell = planner_->findReachedCell(cx, cy, (int) (tolerance / resolution));
+    if(cell < 0)
+      return false;
 
-    return false;
+    mx = cell % planner_->nx;
+    my = cell / planner_->nx;
+    return true;
   }
 
   double NavfnROS::getPointPotential(const geometry_msgs::Point& world_point){
@@ -137,6 +166,11 @@ namespace navfn {
       return -1.0;
     }
 
+    if(potential_at_goal_){
+      ROS_ERROR("The potential of the incremental planner is seeded at the goal, call computePotential before querying it");
+      return DBL_MAX;
+    }
+
     unsigned int mx, my;
     if(!costmap_.worldToMap(world_point.x, world_point.y, mx, my))
       return DBL_MAX;
@@ -172,6 +206,7 @@ namespace navfn {
 
     planner_->setStart(map_start);
     planner_->setGoal(map_goal);
+    potential_at_goal_ = false;
 
     return planner_->calcNavFnDijkstra();
   }
@@ -259,11 +294,6 @@ namespace navfn {
     //clear the plan, just in case
     plan.clear();
 
-    //make sure that we have the latest copy of the costmap and that we clear the footprint of obstacles
-    getCostmap(costmap_);
-
-    ros::NodeHandle n;
-
     //until tf can handle transforming things that are way in the past... we'll require the goal to be in our global frame
     if(tf::resolve(tf_prefix_, goal.header.frame_id) != tf::resolve(tf_prefix_, costmap_ros_->getGlobalFrameID())){
       ROS_ERROR("The goal pose passed to this planner must be in the %s frame.  It is instead in the %s frame.", 
@@ -271,38 +301,16 @@ namespace navfn {
       return false;
     }
 
-    if(tf::resolve(tf_prefix_, start.header.frame_id) != tf::resolve(tf_prefix_, costmap_ros_->getGlobalFrameID())){
-      ROS_ERROR("The start pose passed to this planner must be in the %s frame.  It is instead in the %s frame.", 
-                tf::resolve(tf_prefix_, costmap_ros_->getGlobalFrameID()).c_str(), tf::resolve(tf_prefix_, start.header.frame_id).c_str());
+    int map_start[2];
+    if(!setupPlanner(start, map_start))
       return false;
-    }
 
-    double wx = start.pose.position.x;
-    double wy = start.pose.position.y;
+    double wx = goal.pose.position.x;
+    double wy = goal.pose.position.y;
 
     unsigned int mx, my;
-    if(!costmap_.worldToMap(wx, wy, mx, my)){
-      ROS_WARN("The robot's start position is off the global costmap. Planning will always fail, are you sure the robot has been properly localized?");
-      return false;
-    }
-
-    //clear the starting cell within the costmap because we know it can't be an obstacle
-    tf::Stamped<tf::Pose> start_pose;
-    tf::poseStampedMsgToTF(start, start_pose);
-    clearRobotCell(start_pose, mx, my);
-
-    //make sure to resize the underlying array that Navfn uses
-    planner_->setNavArr(costmap_.getSizeInCellsX(), costmap_.getSizeInCellsY());
-    planner_->setCostmap(costmap_.getCharMap(), true, allow_unknown_);
-
-    int map_start[2];
-    map_start[0] = mx;
-    map_start[1] = my;
-
-    wx = goal.pose.position.x;
-    wy = goal.pose.position.y;
-
-    if(!costmap_.worldToMap(wx, wy, mx, my)){
+    bool goal_on_map = costmap_.worldToMap(wx, wy, mx, my);
+    if(!goal_on_map){
       if(tolerance <= 0.0){
         ROS_WARN("The goal sent to the navfn planner is off the global costmap. Planning will always fail to this goal.");
         return false;
@@ -315,80 +323,116 @@ namespace navfn {
     map_goal[0] = mx;
     map_goal[1] = my;
 
-    planner_->setStart(map_goal);
-    planner_->setGoal(map_start);
+    //the incremental planner keeps its potential seeded at the goal, so that only the changed costs
+    //and the moved start have to be dealt with on the next call
+    if(use_incremental_ && goal_on_map){
+      planner_->setStart(map_start);
+      planner_->setGoal(map_goal);
+      potential_at_goal_ = true;
 
-    //bool success = planner_->calcNavFnAstar();
-    planner_->calcNavFnDijkstra(true);
-
-    double resolution = costmap_ros_->getResolution();
-    geometry_msgs::PoseStamped p, best_pose;
-    p = goal;
-
-    bool found_legal = false;
-    double best_sdist = DBL_MAX;
-
-    p.pose.position.y = goal.pose.position.y - tolerance;
-
-    while(p.pose.position.y <= goal.pose.position.y + tolerance){
-      p.pose.position.x = goal.pose.position.x - tolerance;
-      while(p.pose.position.x <= goal.pose.position.x + tolerance){
-        double potential = getPointPotential(p.pose.position);
-        double sdist = sq_distance(p, goal);
-        if(potential < POT_HIGH && sdist < best_sdist){
-          best_sdist = sdist;
-          best_pose = p;
-          found_legal = true;
-        }
-        p.pose.position.x += resolution;
-      }
-      p.pose.position.y += resolution;
-    }
+      if(planner_->calcNavFnIncremental()){
+        //the path runs from the start to the goal
+        getPlanFromPath(false, plan);
+
+        if(visualize_potential_)
+          publishPotential();
 
-    if(found_legal){
-      //extract the plan
-      if(getPlanFromPotential(best_pose, plan)){
         //make sure the goal we push on has the same timestamp as the rest of the plan
-        geometry_msgs::PoseStamped goal_copy = best_pose;
+        geometry_msgs::PoseStamped goal_copy = goal;
         goal_copy.header.stamp = ros::Time::now();
         plan.push_back(goal_copy);
+
+        publishPlan(plan, 0.0, 1.0, 0.0, 0.0);
+        return true;
       }
-      else{
-        ROS_ERROR("Failed to get a plan from potential when a legal potential was found. This shouldn't happen.");
+
+      if(tolerance <= 0.0){
+        publishPlan(plan, 0.0, 1.0, 0.0, 0.0);
+        return false;
       }
+
+      //the goal itself can't be reached, so fall back to a full search for a legal goal within tolerance
     }
 
-    if (visualize_potential_){
-      //publish potential array
-      pcl::PointCloud<PotarrPoint> pot_area;
-      pot_area.header.frame_id = costmap_ros_->getGlobalFrameID();
-      pot_area.points.clear();
-      pot_area.header.stamp = ros::Time::now();
-
-      PotarrPoint pt;
-      float *pp = planner_->potarr;
-      double pot_x, pot_y;
-      for (unsigned int i = 0; i < (unsigned int)planner_->ny*planner_->nx ; i++)
-      {
-        if (pp[i] < 10e7)
-        {
-          mapToWorld(i%planner_->nx, i/planner_->nx, pot_x, pot_y);
-          pt.x = pot_x;
-          pt.y = pot_y;
-          pt.z = pp[i]/pp[planner_->start[1]*planner_->nx + planner_->start[0]]*20;
-          pt.pot_value = pp[i];
-          pot_area.push_back(pt);
-        }
-      }
-      potarr_pub_.publish(pot_area);
+    planner_->setStart(map_goal);
+    planner_->setGoal(map_start);
+    potential_at_goal_ = false;
+
+    //bool success = planner_->calcNavFnAstar();
+    if(bidirectional_ && goal_on_map && planner_->calcNavFnBidirectional()){
+      //the path runs from the goal back to the start
+      getPlanFromPath(true, plan);
+
+      //only the robot's wavefront is published, it stopped where it met the one from the goal
+      if(visualize_potential_)
+        publishPotential();
+
+      //make sure the goal we push on has the same timestamp as the rest of the plan
+      geometry_msgs::PoseStamped goal_copy = goal;
+      goal_copy.header.stamp = ros::Time::now();
+      plan.push_back(goal_copy);
+
+      publishPlan(plan, 0.0, 1.0, 0.0, 0.0);
+      return true;
     }
 
+    //the bidirectional search only knows about the exact goal, so tolerance needs the full search...
+    //a goal off the map is never reached, so the whole map is searched for the closest legal goal
+    planner_->calcNavFnDijkstra(goal_on_map);
+
+    getPlanNearGoal(goal, tolerance, plan);
+
+    if (visualize_potential_)
+      publishPotential();
+
     //publish the plan for visualization purposes
     publishPlan(plan, 0.0, 1.0, 0.0, 0.0);
 
     return !plan.empty();
   }
 
+  void NavfnROS::publishPotential(){
+    //only the rows the propagation set potentials in are looked at, rather than the whole map
+    int nx = planner_->nx;
+    int stride = potential_stride_;
+    float *pp = planner_->potarr;
+
+    //rows and columns are picked on a fixed grid, so the same cells are sent from one plan to the next
+    int y0 = (planner_->potLo / nx + stride - 1) / stride * stride;
+    int y1 = planner_->potHi / nx;
+
+    //the cloud is kept between plans so that its points don't have to be reallocated
+    pot_area_.header.frame_id = costmap_ros_->getGlobalFrameID();
+    pot_area_.header.stamp = ros::Time::now();
+    pot_area_.points.clear();
+    if(y1 >= y0)
+      pot_area_.points.reserve(((y1 - y0) / stride + 1) * ((nx - 1) / stride + 1));
+
+    double resolution = costmap_.getResolution();
+    //a bidirectional search may not have reached the far end, the cost of its path is used instead
+    float top = pp[planner_->start[1] * nx + planner_->start[0]];
+    if(top >= POT_HIGH)
+      top = planner_->getLastPathCost();
+    float scale = 20.0 / top;
+
+    PotarrPoint pt;
+    for(int y = y0; y <= y1; y += stride){
+      float *row = pp + y * nx;
+      pt.y = costmap_.getOriginY() + y * resolution;
+      for(int x = 0; x < nx; x += stride){
+        if(row[x] < 10e7){
+          pt.x = costmap_.getOriginX() + x * resolution;
+          pt.z = row[x] * scale;
+          pt.pot_value = row[x];
+          pot_area_.points.push_back(pt);
+        }
+      }
+    }
+
+    //the publisher writes the points straight into the outgoing message
+    potarr_pub_.publish(pot_area_);
+  }
+
   void NavfnROS::publishPlan(const std::vector<geometry_msgs::PoseStamped>& path, double r, double g, double b, double a){
     if(!initialized_){
       ROS_ERROR("This planner has not been initialized yet, but it is being used, please call initialize() before use");
@@ -413,6 +457,66 @@ namespace navfn {
     plan_pub_.publish(gui_path);
   }
 
+  bool NavfnROS::setupPlanner(const geometry_msgs::PoseStamped& start, int map_start[2]){
+    //make sure that we have the latest copy of the costmap and that we clear the footprint of obstacles
+    getCostmap(costmap_);
+
+    if(tf::resolve(tf_prefix_, start.header.frame_id) != tf::resolve(tf_prefix_, costmap_ros_->getGlobalFrameID())){
+      ROS_ERROR("The start pose passed to this planner must be in the %s frame.  It is instead in the %s frame.", 
+                tf::resolve(tf_prefix_, costmap_ros_->getGlobalFrameID()).c_str(), tf::resolve(tf_prefix_, start.header.frame_id).c_str());
+      return false;
+    }
+
+    double wx = start.pose.position.x;
+    double wy = start.pose.position.y;
+
+    unsigned int mx, my;
+    if(!costmap_.worldToMap(wx, wy, mx, my)){
+      ROS_WARN("The robot's start position is off the global costmap. Planning will always fail, are you sure the robot has been properly localized?");
+      return false;
+    }
+
+    //clear the starting cell within the costmap because we know it can't be an obstacle
+    tf::Stamped<tf::Pose> start_pose;
+    tf::poseStampedMsgToTF(start, start_pose);
+    clearRobotCell(start_pose, mx, my);
+
+    //make sure to resize the underlying array that Navfn uses
+    planner_->setNavArr(costmap_.getSizeInCellsX(), costmap_.getSizeInCellsY());
+    planner_->setCostmap(costmap_.getCharMap(), true, allow_unknown_);
+
+    map_start[0] = mx;
+    map_start[1] = my;
+    return true;
+  }
+
+  bool NavfnROS::getPlanNearGoal(const geometry_msgs::PoseStamped& goal, double tolerance, std::vector<geometry_msgs::PoseStamped>& plan){
+    int mx, my;
+    if(!getReachedCell(goal.pose.position, tolerance, mx, my))
+      return false;
+
+    //plan to the goal itself if its cell was reached, otherwise to the center of the closest cell that was
+    geometry_msgs::PoseStamped best_pose = goal;
+    unsigned int gx, gy;
+    if(!costmap_.worldToMap(goal.pose.position.x, goal.pose.position.y, gx, gy) || (int) gx != mx || (int) gy != my){
+      best_pose.pose.position.x = costmap_.getOriginX() + (mx + 0.5) * costmap_.getResolution();
+      best_pose.pose.position.y = costmap_.getOriginY() + (my + 0.5) * costmap_.getResolution();
+    }
+
+    //extract the plan
+    if(getPlanFromPotential(best_pose, plan)){
+      //make sure the goal we push on has the same timestamp as the rest of the plan
+      geometry_msgs::PoseStamped goal_copy = best_pose;
+      goal_copy.header.stamp = ros::Time::now();
+      plan.push_back(goal_copy);
+    }
+    else{
+      ROS_ERROR("Failed to get a plan from potential when a legal potential was found. This shouldn't happen.");
+    }
+
+    return !plan.empty();
+  }
+
   bool NavfnROS::getPlanFromPotential(const geometry_msgs::PoseStamped& goal, std::vector<geometry_msgs::PoseStamped>& plan){
     if(!initialized_){
       ROS_ERROR("This planner has not been initialized yet, but it is being used, please call initialize() before use");
@@ -432,6 +536,11 @@ namespace navfn {
     double wx = goal.pose.position.x;
     double wy = goal.pose.position.y;
 
+    if(potential_at_goal_){
+      ROS_ERROR("The potential of the incremental planner is seeded at the goal, call computePotential before planning from it");
+      return false;
+    }
+
     //the potential has already been computed, so we won't update our copy of the costmap
     unsigned int mx, my;
     if(!costmap_.worldToMap(wx, wy, mx, my)){
@@ -447,32 +556,39 @@ namespace navfn {
 
     planner_->calcPath(costmap_ros_->getSizeInCellsX() * 4);
 
-    //extract the plan
+    //extract the plan, the path runs from the goal back to the start
+    getPlanFromPath(true, plan);
+
+    //publish the plan for visualization purposes
+    publishPlan(plan, 0.0, 1.0, 0.0, 0.0);
+    return !plan.empty();
+  }
+
+  void NavfnROS::getPlanFromPath(bool reverse, std::vector<geometry_msgs::PoseStamped>& plan){
+    if(smooth_path_)
+      planner_->smoothPath();
+
     float *x = planner_->getPathX();
     float *y = planner_->getPathY();
     int len = planner_->getPathLen();
-    ros::Time plan_time = ros::Time::now();
-    std::string global_frame = costmap_ros_->getGlobalFrameID();
-    for(int i = len - 1; i >= 0; --i){
+
+    //every pose is a copy of this one with the position changed, so the header is only filled in once
+    geometry_msgs::PoseStamped pose;
+    pose.header.stamp = ros::Time::now();
+    pose.header.frame_id = costmap_ros_->getGlobalFrameID();
+    pose.pose.position.z = 0.0;
+    pose.pose.orientation.x = 0.0;
+    pose.pose.orientation.y = 0.0;
+    pose.pose.orientation.z = 0.0;
+    pose.pose.orientation.w = 1.0;
+
+    plan.reserve(plan.size() + len + 1);
+    for(int j = 0; j < len; ++j){
+      int i = reverse ? len - 1 - j : j;
+
       //convert the plan to world coordinates
-      double world_x, world_y;
-      mapToWorld(x[i], y[i], world_x, world_y);
-
-      geometry_msgs::PoseStamped pose;
-      pose.header.stamp = plan_time;
-      pose.header.frame_id = global_frame;
-      pose.pose.position.x = world_x;
-      pose.pose.position.y = world_y;
-      pose.pose.position.z = 0.0;
-      pose.pose.orientation.x = 0.0;
-      pose.pose.orientation.y = 0.0;
-      pose.pose.orientation.z = 0.0;
-      pose.pose.orientation.w = 1.0;
+      mapToWorld(x[i], y[i], pose.pose.position.x, pose.pose.position.y);
       plan.push_back(pose);
     }
-
-    //publish the plan for visualization purposes
-    publishPlan(plan, 0.0, 1.0, 0.0, 0.0);
-    return !plan.empty();
   }
 };
@@ -0,0 +1,328 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+#include <gtest/gtest.h>
+#include <navfn/navfn.h>
+#include <math.h>
+#include <stdlib.h>
+#include <vector>
+
+using namespace navfn;
+
+// fill a box of the ROS costmap with a value
+void setBox(std::vector<COSTTYPE>& cmap, int nx, int ny, int x0, int y0, int w, int h, COSTTYPE v){
+  for(int y = std::max(y0, 0); y < y0 + h && y < ny; ++y)
+    for(int x = std::max(x0, 0); x < x0 + w && x < nx; ++x)
+      cmap[y * nx + x] = v;
+}
+
+// rooms with doorways, some clutter, and random costs in free space
+std::vector<COSTTYPE> makeMap(int nx, int ny, unsigned int seed){
+  srand(seed);
+  std::vector<COSTTYPE> cmap(nx * ny, 0);
+  for(int x = 50; x < nx; x += 50)
+    setBox(cmap, nx, ny, x, 0, 2, ny, COST_OBS_ROS);
+  for(int y = 50; y < ny; y += 50)
+    setBox(cmap, nx, ny, 0, y, nx, 2, COST_OBS_ROS);
+  for(int x = 50; x < nx; x += 50)
+    for(int y = 0; y < ny; y += 50){
+      setBox(cmap, nx, ny, x, y + 10 + rand() % 25, 2, 8, 0);
+      setBox(cmap, nx, ny, y + 10 + rand() % 25, x, 8, 2, 0);
+    }
+  for(int i = 0; i < nx * ny / 1000; ++i)
+    setBox(cmap, nx, ny, rand() % nx, rand() % ny, 2 + rand() % 4, 2 + rand() % 4, COST_OBS_ROS);
+  for(int i = 0; i < nx * ny; ++i)
+    if(cmap[i] == 0)
+      cmap[i] = rand() % 20;
+  return cmap;
+}
+
+// plan from scratch with the navigation function seeded at the goal
+bool planScratch(NavFn& nav, const std::vector<COSTTYPE>& cmap, int* start, int* goal){
+  nav.setCostmap(&cmap[0], true, true);
+  nav.setStart(start);
+  nav.setGoal(goal);
+  return nav.calcNavFnDijkstra(true);
+}
+
+float startPotential(NavFn& nav){
+  return nav.potarr[nav.start[1] * nav.nx + nav.start[0]];
+}
+
+TEST(NavFn, incrementalReplan){
+  int nx = 200, ny = 200;
+  std::vector<COSTTYPE> cmap = makeMap(nx, ny, 1);
+  int start[2] = {25, 25};
+  int goal[2] = {175, 175};
+  setBox(cmap, nx, ny, start[0] - 2, start[1] - 2, 5, 5, 0);
+  setBox(cmap, nx, ny, goal[0] - 2, goal[1] - 2, 5, 5, 0);
+
+  NavFn inc(nx, ny);
+  for(int r = 0; r < 10; ++r){
+    if(r > 0){
+      //toggle obstacles around the robot and on its path, then move it along the path
+      for(int c = 0; c < 4; ++c)
+        setBox(cmap, nx, ny, start[0] + rand() % 40 - 20, start[1] + rand() % 40 - 20, 4, 4, (rand() % 2) ? COST_OBS_ROS : 0);
+      int k = inc.getPathLen() / 2;
+      setBox(cmap, nx, ny, (int) inc.getPathX()[k] - 2, (int) inc.getPathY()[k] - 2, 5, 5, COST_OBS_ROS);
+      k = std::min(inc.getPathLen() - 1, 10);
+      start[0] = (int) (inc.getPathX()[k] + 0.5);
+      start[1] = (int) (inc.getPathY()[k] + 0.5);
+      setBox(cmap, nx, ny, start[0] - 1, start[1] - 1, 3, 3, 0);
+    }
+
+    inc.setCostmap(&cmap[0], true, true);
+    inc.setStart(start);
+    inc.setGoal(goal);
+    ASSERT_TRUE(inc.calcNavFnIncremental());
+
+    //the repaired navigation function has to give the same path cost as one computed from scratch
+    NavFn scratch(nx, ny);
+    ASSERT_TRUE(planScratch(scratch, cmap, start, goal));
+    EXPECT_NEAR(startPotential(inc), startPotential(scratch), 0.01 * startPotential(scratch));
+  }
+}
+
+TEST(NavFn, parallelPropagation){
+  int nx = 400, ny = 400;
+  std::vector<COSTTYPE> cmap = makeMap(nx, ny, 2);
+  int start[2] = {10, 10};
+  int goal[2] = {200, 200};
+  setBox(cmap, nx, ny, goal[0] - 2, goal[1] - 2, 5, 5, 0);
+
+  NavFn serial(nx, ny);
+  serial.setCostmap(&cmap[0], true, true);
+  serial.setStart(start);
+  serial.setGoal(goal);
+  serial.calcNavFnDijkstra(false);
+
+  //the blocks have to be large enough to be split, and the result can't depend on how they are split
+  for(int threads = 2; threads <= 4; ++threads){
+    NavFn parallel(nx, ny);
+    parallel.setPropagationThreads(threads);
+    parallel.setCostmap(&cmap[0], true, true);
+    parallel.setStart(start);
+    parallel.setGoal(goal);
+    parallel.calcNavFnDijkstra(false);
+    ASSERT_GE(parallel.statMaxBlock, PROPPARALLELMIN);
+
+    for(int i = 0; i < nx * ny; ++i)
+      ASSERT_FLOAT_EQ(serial.potarr[i], parallel.potarr[i]);
+    EXPECT_EQ(serial.getPathLen(), parallel.getPathLen());
+  }
+}
+
+TEST(NavFn, corridorAndBidirectional){
+  int nx = 300, ny = 300;
+  std::vector<COSTTYPE> cmap = makeMap(nx, ny, 3);
+
+  NavFn dijkstra(nx, ny), corridor(nx, ny), bidirectional(nx, ny);
+  corridor.setCorridor(1.2, 10);
+  int planned = 0;
+  for(int i = 0; i < 10; ++i){
+    int start[2] = {5 + rand() % (nx - 10), 5 + rand() % (ny - 10)};
+    int goal[2] = {5 + rand() % (nx - 10), 5 + rand() % (ny - 10)};
+    cmap[start[1] * nx + start[0]] = 0;
+    cmap[goal[1] * nx + goal[0]] = 0;
+
+    if(!planScratch(dijkstra, cmap, start, goal))
+      continue;
+    float cost = startPotential(dijkstra);
+    planned++;
+
+    //the corridor search has to find the same path as the full search, or fall back to it
+    ASSERT_TRUE(planScratch(corridor, cmap, start, goal));
+    EXPECT_NEAR(startPotential(corridor), cost, 0.01 * cost);
+
+    //the two wavefronts meet in the middle, which costs a little more than one wavefront going all the way
+    bidirectional.setCostmap(&cmap[0], true, true);
+    bidirectional.setStart(start);
+    bidirectional.setGoal(goal);
+    ASSERT_TRUE(bidirectional.calcNavFnBidirectional());
+    EXPECT_NEAR(bidirectional.getLastPathCost(), cost, 0.01 * cost);
+    EXPECT_GT(bidirectional.getPathLen(), 0);
+  }
+  EXPECT_GT(planned, 5);
+}
+
+TEST(NavFn, workspaceReuse){
+  int nx = 200, ny = 200;
+  std::vector<COSTTYPE> cmap = makeMap(nx, ny, 4);
+  int start[2] = {20, 20}, goal[2] = {180, 170};
+  int start2[2] = {150, 30}, goal2[2] = {40, 120};
+  setBox(cmap, nx, ny, 15, 15, 10, 10, 0);
+  setBox(cmap, nx, ny, 175, 165, 10, 10, 0);
+  setBox(cmap, nx, ny, 145, 25, 10, 10, 0);
+  setBox(cmap, nx, ny, 35, 115, 10, 10, 0);
+
+  //only the cells between potLo and potHi get a potential, everything else keeps its initial value
+  NavFn reused(nx, ny);
+  ASSERT_TRUE(planScratch(reused, cmap, start, goal));
+  ASSERT_LE(reused.potLo, reused.potHi);
+  for(int i = 0; i < nx * ny; ++i)
+    if(i < reused.potLo || i > reused.potHi){
+      ASSERT_GE(reused.potarr[i], POT_HIGH);
+    }
+
+  //a second plan only resets that range, and has to match a plan in a fresh workspace
+  ASSERT_TRUE(planScratch(reused, cmap, start2, goal2));
+  NavFn fresh(nx, ny);
+  ASSERT_TRUE(planScratch(fresh, cmap, start2, goal2));
+  for(int i = 0; i < nx * ny; ++i)
+    ASSERT_FLOAT_EQ(fresh.potarr[i], reused.potarr[i]);
+  ASSERT_EQ(fresh.getPathLen(), reused.getPathLen());
+}
+
+TEST(NavFn, setCostmapChangedRows){
+  int nx = 120, ny = 100;
+  std::vector<COSTTYPE> cmap = makeMap(nx, ny, 5);
+  setBox(cmap, nx, ny, 60, 60, 10, 10, COST_UNKNOWN_ROS);
+
+  NavFn diff(nx, ny);
+  diff.setCostmap(&cmap[0], true, true);
+  for(int r = 0; r < 6; ++r){
+    //change a few rows, flip the flags now and then so that the whole map has to be translated
+    for(int c = 0; c < 3; ++c)
+      setBox(cmap, nx, ny, rand() % nx, rand() % ny, 1 + rand() % 20, 1 + rand() % 3, (rand() % 2) ? COST_OBS_ROS : rand() % 20);
+    bool is_ros = r != 3;
+    bool allow_unknown = r % 2 == 0;
+    diff.setCostmap(&cmap[0], is_ros, allow_unknown);
+
+    NavFn full(nx, ny);
+    full.setCostmap(&cmap[0], is_ros, allow_unknown);
+    ASSERT_EQ(full.nobs, diff.nobs);
+    for(int i = 0; i < nx * ny; ++i)
+      ASSERT_EQ(full.costarr[i], diff.costarr[i]);
+  }
+
+  //writing costarr directly needs the cached costmap dropped
+  diff.costarr[nx + 1] = COST_OBS;
+  diff.invalidateCostmap();
+  diff.setCostmap(&cmap[0], true, true);
+  NavFn full(nx, ny);
+  full.setCostmap(&cmap[0], true, true);
+  EXPECT_EQ(full.costarr[nx + 1], diff.costarr[nx + 1]);
+  EXPECT_EQ(full.nobs, diff.nobs);
+}
+
+TEST(NavFn, targetsAndReachedCell){
+  int nx = 150, ny = 150;
+  std::vector<COSTTYPE> cmap = makeMap(nx, ny, 6);
+  int start[2] = {20, 20}, goal[2] = {30, 30};
+  setBox(cmap, nx, ny, 15, 15, 20, 20, 0);
+
+  //the propagation from the goal stops at the start unless it also has targets to reach
+  std::vector<int> targets;
+  for(int i = 0; i < 5; ++i){
+    int x = 100 + rand() % 40, y = 100 + rand() % 40;
+    cmap[y * nx + x] = 0;
+    targets.push_back(y * nx + x);
+  }
+  NavFn nav(nx, ny);
+  nav.setCostmap(&cmap[0], true, true);
+  nav.setStart(start);
+  nav.setGoal(goal);
+  ASSERT_TRUE(nav.calcNavFnDijkstra(false));
+  std::vector<int> reachable;
+  for(unsigned int i = 0; i < targets.size(); ++i)
+    if(nav.potarr[targets[i]] < POT_HIGH)
+      reachable.push_back(targets[i]);
+  ASSERT_FALSE(reachable.empty());
+
+  ASSERT_TRUE(planScratch(nav, cmap, start, goal));
+  EXPECT_GE(nav.potarr[reachable[0]], POT_HIGH);
+
+  nav.setTargets(reachable);
+  ASSERT_TRUE(planScratch(nav, cmap, start, goal));
+  nav.setTargets(std::vector<int>());
+  for(unsigned int i = 0; i < reachable.size(); ++i)
+    EXPECT_LT(nav.potarr[reachable[i]], POT_HIGH);
+
+  //the ring search has to find the closest reached cell, lowest index first on ties, also from off the map
+  for(int q = 0; q < 200; ++q){
+    int x = rand() % (nx + 40) - 20, y = rand() % (ny + 40) - 20;
+    int radius = rand() % 30;
+    int best = -1, best_d = 0;
+    for(int n = 0; n < nx * ny; ++n){
+      if(nav.potarr[n] >= POT_HIGH)
+        continue;
+      int dx = n % nx - x, dy = n / nx - y;
+      if(std::max(abs(dx), abs(dy)) > radius)
+        continue;
+      int d = dx * dx + dy * dy;
+      if(best < 0 || d < best_d){
+        best = n;
+        best_d = d;
+      }
+    }
+    ASSERT_EQ(best, nav.findReachedCell(x, y, radius));
+  }
+}
+
+TEST(NavFn, bidirectionalBufferGrowth){
+  int nx = 800, ny = 800;
+  std::vector<COSTTYPE> cmap(nx * ny, 0);
+  int start[2] = {20, 20}, goal[2] = {400, 400};
+
+  NavFn serial(nx, ny);
+  serial.setCostmap(&cmap[0], true, true);
+  serial.setStart(start);
+  serial.setGoal(goal);
+  ASSERT_TRUE(serial.calcNavFnBidirectional());
+
+  //the first plan allocates the second wavefront, after which both start over from tiny priority buffers, so
+  //that each of them grows its own while the parallel blocks share their scratch space; the wavefront from
+  //the middle of the map spreads in every direction and outgrows the one from the corner
+  NavFn parallel(nx, ny);
+  parallel.setPropagationThreads(2);
+  parallel.setCostmap(&cmap[0], true, true);
+  parallel.setStart(start);
+  parallel.setGoal(goal);
+  ASSERT_TRUE(parallel.calcNavFnBidirectional());
+  for(int r = 0; r < 2; ++r){
+    parallel.pbSize = 16;
+    parallel.waveB.pbSize = 16;
+    parallel.setStart(r == 0 ? start : goal);
+    parallel.setGoal(r == 0 ? goal : start);
+    ASSERT_TRUE(parallel.calcNavFnBidirectional());
+    ASSERT_GE(parallel.statMaxBlock, PROPPARALLELMIN);
+    ASSERT_GT(parallel.pbSize, 16);
+    ASSERT_GT(parallel.waveB.pbSize, 16);
+    EXPECT_FLOAT_EQ(serial.getLastPathCost(), parallel.getLastPathCost());
+  }
+}
+
+int main(int argc, char** argv){
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}